@@ -0,0 +1,164 @@
+#include "immutable_string/algorithm.hpp"
+#include "immutable_string/utf8.hpp"
+#include "string_types.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <unordered_set>
+
+#include <benchmark/benchmark.h>
+
+namespace {
+
+template <class T>
+std::vector<T> make_keys(std::size_t count, std::size_t prefix_size) {
+  std::vector<T> res;
+  for (const auto& key : random_keys(count, prefix_size)) {
+    res.push_back(string_type<T>::make(key));
+  }
+  return res;
+}
+
+// sorting copies of the keys, with a common prefix of the given size
+template <class T>
+void sort(benchmark::State& state) {
+  const auto keys = make_keys<T>(10000, state.range(0));
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto copy = keys;
+    state.ResumeTiming();
+    std::sort(copy.begin(), copy.end(), &string_type<T>::less);
+    benchmark::DoNotOptimize(copy.data());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+// algorithm::sort of immutable strings by the given number of threads
+void algorithm_sort(benchmark::State& state) {
+  const auto keys = make_keys<immutable_string::string>(100000, 16);
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto copy = keys;
+    state.ResumeTiming();
+    immutable_string::algorithm::sort(copy.begin(), copy.end(),
+                                      static_cast<unsigned>(state.range(0)));
+    benchmark::DoNotOptimize(copy.data());
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+// equal strings in separate buffers
+template <class T>
+void compare_equal(benchmark::State& state) {
+  std::mt19937 gen{7};
+  const auto source = random_string(gen, state.range(0));
+  const auto lhs = string_type<T>::make(source);
+  const auto rhs = string_type<T>::make(source);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(!string_type<T>::less(lhs, rhs) &&
+                             !string_type<T>::less(rhs, lhs));
+  }
+}
+
+// the hash of the same string again, immutable strings cache it
+template <class T>
+void hash(benchmark::State& state) {
+  std::mt19937 gen{8};
+  const auto str = string_type<T>::make(random_string(gen, state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(string_type<T>::hash(str));
+  }
+}
+
+// hashes of distinct strings, as an unordered container builds them
+template <class T>
+void hash_all(benchmark::State& state) {
+  const auto keys = make_keys<T>(10000, state.range(0));
+  for (auto _ : state) {
+    std::size_t sum = 0;
+    for (const auto& key : keys) sum += string_type<T>::hash(key);
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+// equal strings of letters in different case, std::string by tolower
+void compare_icase_std(benchmark::State& state) {
+  std::mt19937 gen{9};
+  const auto lhs = random_string(gen, state.range(0));
+  auto rhs = lhs;
+  for (auto& ch : rhs) ch = static_cast<char>(std::toupper(ch));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        lhs.size() == rhs.size() &&
+        std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](char x, char y) {
+          return std::tolower(static_cast<unsigned char>(x)) ==
+                 std::tolower(static_cast<unsigned char>(y));
+        }));
+  }
+}
+
+void compare_icase_immutable(benchmark::State& state) {
+  std::mt19937 gen{9};
+  auto source = random_string(gen, state.range(0));
+  const auto lhs = string_type<immutable_string::string>::make(source);
+  for (auto& ch : source) ch = static_cast<char>(std::toupper(ch));
+  const auto rhs = string_type<immutable_string::string>::make(source);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(immutable_string::utf8::equal_icase(lhs, rhs));
+  }
+}
+
+// UTF-8 validation of a string of mixed ASCII and 2 and 3 byte sequences,
+// fresh strings are scanned and the same string answers from its flags
+void validate_utf8(benchmark::State& state) {
+  std::mt19937 gen{10};
+  std::string source;
+  while (source.size() < static_cast<std::size_t>(state.range(0))) {
+    source += random_string(gen, 8);
+    source += gen() % 2 ? "\xd0\x9f" : "\xe2\x82\xac";
+  }
+  for (auto _ : state) {
+    const immutable_string::string str{source.data(), source.size()};
+    benchmark::DoNotOptimize(immutable_string::utf8::is_valid(str));
+  }
+  state.SetBytesProcessed(state.iterations() * source.size());
+}
+
+void validate_utf8_cached(benchmark::State& state) {
+  std::mt19937 gen{10};
+  const auto str = immutable_string::utf8::validated(
+      random_string(gen, state.range(0)).c_str());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(immutable_string::utf8::is_valid(str));
+  }
+}
+
+#define PREFIX_SIZES Arg(0)->Arg(16)->Arg(64)
+#define COMPARE_SIZES Arg(8)->Arg(64)->Arg(1024)
+
+BENCHMARK_TEMPLATE(sort, std::string)->PREFIX_SIZES;
+BENCHMARK_TEMPLATE(sort, shared_string)->PREFIX_SIZES;
+BENCHMARK_TEMPLATE(sort, immutable_string::string)->PREFIX_SIZES;
+
+BENCHMARK(algorithm_sort)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+BENCHMARK_TEMPLATE(compare_equal, std::string)->COMPARE_SIZES;
+BENCHMARK_TEMPLATE(compare_equal, shared_string)->COMPARE_SIZES;
+BENCHMARK_TEMPLATE(compare_equal, immutable_string::string)->COMPARE_SIZES;
+
+BENCHMARK_TEMPLATE(hash, std::string)->COMPARE_SIZES;
+BENCHMARK_TEMPLATE(hash, shared_string)->COMPARE_SIZES;
+BENCHMARK_TEMPLATE(hash, immutable_string::string)->COMPARE_SIZES;
+
+BENCHMARK_TEMPLATE(hash_all, std::string)->PREFIX_SIZES;
+BENCHMARK_TEMPLATE(hash_all, shared_string)->PREFIX_SIZES;
+BENCHMARK_TEMPLATE(hash_all, immutable_string::string)->PREFIX_SIZES;
+
+BENCHMARK(compare_icase_std)->COMPARE_SIZES;
+BENCHMARK(compare_icase_immutable)->COMPARE_SIZES;
+
+BENCHMARK(validate_utf8)->COMPARE_SIZES;
+BENCHMARK(validate_utf8_cached)->COMPARE_SIZES;
+
+}  // namespace
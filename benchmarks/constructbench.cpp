@@ -0,0 +1,60 @@
+#include "immutable_string/split.hpp"
+#include "string_types.hpp"
+
+#include <benchmark/benchmark.h>
+
+namespace {
+
+template <class T>
+void construct(benchmark::State& state) {
+  std::mt19937 gen{1};
+  const auto source = random_string(gen, state.range(0));
+  for (auto _ : state) {
+    auto str = string_type<T>::make(source);
+    benchmark::DoNotOptimize(str);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// short strings around the inline capacity and long ones
+#define CONSTRUCT_SIZES Arg(8)->Arg(15)->Arg(16)->Arg(64)->Arg(1024)->Arg(65536)
+
+BENCHMARK_TEMPLATE(construct, std::string)->CONSTRUCT_SIZES;
+BENCHMARK_TEMPLATE(construct, shared_string)->CONSTRUCT_SIZES;
+BENCHMARK_TEMPLATE(construct, immutable_string::string)->CONSTRUCT_SIZES;
+
+// lines of a log-like input: a string per line, one by one or in bulk
+std::string random_lines(std::size_t count) {
+  const auto keys = random_keys(count, 0);
+  std::string res;
+  for (const auto& key : keys) res += key + '\n';
+  return res;
+}
+
+void split_one_by_one(benchmark::State& state) {
+  const auto input = random_lines(state.range(0));
+  for (auto _ : state) {
+    std::vector<immutable_string::string> lines;
+    for (std::size_t first = 0; first < input.size();) {
+      const auto last = input.find('\n', first);
+      lines.emplace_back(input.data() + first, last - first);
+      first = last + 1;
+    }
+    benchmark::DoNotOptimize(lines.data());
+  }
+  state.SetBytesProcessed(state.iterations() * input.size());
+}
+
+void split_bulk(benchmark::State& state) {
+  const auto input = random_lines(state.range(0));
+  for (auto _ : state) {
+    auto lines = immutable_string::split(input.data(), input.size(), '\n');
+    benchmark::DoNotOptimize(lines.data());
+  }
+  state.SetBytesProcessed(state.iterations() * input.size());
+}
+
+BENCHMARK(split_one_by_one)->Arg(1000)->Arg(100000);
+BENCHMARK(split_bulk)->Arg(1000)->Arg(100000);
+
+}  // namespace
@@ -0,0 +1,130 @@
+#include "immutable_string/atomic.hpp"
+#include "immutable_string/compressed.hpp"
+#include "string_types.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <mutex>
+
+namespace {
+
+template <class T>
+void copy(benchmark::State& state) {
+  std::mt19937 gen{2};
+  const auto source = string_type<T>::make(random_string(gen, state.range(0)));
+  for (auto _ : state) {
+    T str{source};
+    benchmark::DoNotOptimize(str);
+  }
+}
+
+// all the threads copy and destroy the same string, so shared refcounts
+// are contended
+template <class T>
+void copy_shared(benchmark::State& state) {
+  static const auto source = [] {
+    std::mt19937 gen{3};
+    return string_type<T>::make(random_string(gen, 1024));
+  }();
+  for (auto _ : state) {
+    T str{source};
+    benchmark::DoNotOptimize(str);
+  }
+}
+
+template <class T>
+void copy_vector(benchmark::State& state) {
+  std::vector<T> source;
+  for (const auto& key : random_keys(state.range(0), 0)) {
+    source.push_back(string_type<T>::make(key));
+  }
+  for (auto _ : state) {
+    auto copy = source;
+    benchmark::DoNotOptimize(copy.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// readers of a published value: a shared_ptr copied under a mutex
+// vs atomic_string
+void load_locked(benchmark::State& state) {
+  static std::mutex mutex;
+  static const auto source =
+      string_type<shared_string>::make(std::string(1024, 'x'));
+  for (auto _ : state) {
+    shared_string str;
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      str = source;
+    }
+    benchmark::DoNotOptimize(str);
+  }
+}
+
+void load_atomic(benchmark::State& state) {
+  static const immutable_string::atomic_string source{
+      string_type<immutable_string::string>::make(std::string(1024, 'x'))};
+  for (auto _ : state) {
+    auto str = source.load();
+    benchmark::DoNotOptimize(str);
+  }
+}
+
+// text of the given size for compressed strings: repeated words
+std::string make_text(std::size_t size) {
+  std::mt19937 gen{3};
+  const char* words[] = {"request ", "served ", "status ", "200 ", "in ",
+                         "ms ", "user ", "session ", "error ", "\n"};
+  std::string res;
+  while (res.size() < size) res += words[gen() % 10];
+  return res;
+}
+
+// reads of a compressed string, its bytes and the compression ratio
+void read_compressed(benchmark::State& state) {
+  const auto text = make_text(state.range(0));
+  const immutable_string::compressed_string source{
+      string_type<immutable_string::string>::make(text)};
+  for (auto _ : state) {
+    auto str = source.str();
+    benchmark::DoNotOptimize(str);
+  }
+  state.counters["ratio"] =
+      static_cast<double>(text.size()) / source.stored_bytes();
+}
+
+// reads after the cache is dropped, so each one decompresses
+void read_compressed_cold(benchmark::State& state) {
+  const auto text = make_text(state.range(0));
+  const immutable_string::compressed_string source{
+      string_type<immutable_string::string>::make(text)};
+  for (auto _ : state) {
+    source.drop_cache();
+    auto str = source.str();
+    benchmark::DoNotOptimize(str);
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+#define COPY_SIZES Arg(8)->Arg(64)->Arg(1024)
+#define COPY_THREADS Threads(1)->Threads(2)->Threads(4)->Threads(8)
+
+BENCHMARK_TEMPLATE(copy, std::string)->COPY_SIZES;
+BENCHMARK_TEMPLATE(copy, shared_string)->COPY_SIZES;
+BENCHMARK_TEMPLATE(copy, immutable_string::string)->COPY_SIZES;
+
+BENCHMARK_TEMPLATE(copy_shared, std::string)->COPY_THREADS;
+BENCHMARK_TEMPLATE(copy_shared, shared_string)->COPY_THREADS;
+BENCHMARK_TEMPLATE(copy_shared, immutable_string::string)->COPY_THREADS;
+
+BENCHMARK(load_locked)->COPY_THREADS;
+BENCHMARK(load_atomic)->COPY_THREADS;
+
+BENCHMARK(read_compressed)->Arg(1 << 16);
+BENCHMARK(read_compressed_cold)->Arg(1 << 12)->Arg(1 << 16);
+
+BENCHMARK_TEMPLATE(copy_vector, std::string)->Arg(10000);
+BENCHMARK_TEMPLATE(copy_vector, shared_string)->Arg(10000);
+BENCHMARK_TEMPLATE(copy_vector, immutable_string::string)->Arg(10000);
+
+}  // namespace
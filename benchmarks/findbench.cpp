@@ -0,0 +1,76 @@
+#include "string_types.hpp"
+
+#include <benchmark/benchmark.h>
+
+namespace {
+
+// needle of the given size which doesn't occur in the haystack
+template <class T>
+void find_absent(benchmark::State& state) {
+  std::mt19937 gen{4};
+  const auto hay = string_type<T>::make(random_string(gen, state.range(0)));
+  const auto needle = random_string(gen, state.range(1) - 1) + '!';
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(string_type<T>::find(hay, needle));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// needle taken from the end of the haystack
+template <class T>
+void find_last(benchmark::State& state) {
+  std::mt19937 gen{5};
+  const auto source = random_string(gen, state.range(0));
+  const auto hay = string_type<T>::make(source);
+  const auto needle = source.substr(source.size() - state.range(1));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(string_type<T>::find(hay, needle));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// a haystack of two letters, where partial matches are everywhere
+template <class T>
+void find_repetitive(benchmark::State& state) {
+  std::mt19937 gen{6};
+  const auto hay =
+      string_type<T>::make(random_string(gen, state.range(0), 'b'));
+  const auto needle = std::string(state.range(1) - 1, 'a') + 'c';
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(string_type<T>::find(hay, needle));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// a set of characters none of which occurs in the haystack
+template <class T>
+void find_first_of_absent(benchmark::State& state) {
+  std::mt19937 gen{7};
+  const auto hay = string_type<T>::make(random_string(gen, state.range(0)));
+  const auto set = std::string("!@#$%^&*()").substr(0, state.range(1));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(string_type<T>::find_first_of(hay, set));
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+// haystack size, needle size
+#define FIND_SHAPES \
+  Args({1024, 1})->Args({1024, 4})->Args({65536, 4})->Args({65536, 16}) \
+      ->Args({65536, 64})
+
+BENCHMARK_TEMPLATE(find_absent, std::string)->FIND_SHAPES;
+BENCHMARK_TEMPLATE(find_absent, immutable_string::string)->FIND_SHAPES;
+BENCHMARK_TEMPLATE(find_last, std::string)->FIND_SHAPES;
+BENCHMARK_TEMPLATE(find_last, immutable_string::string)->FIND_SHAPES;
+BENCHMARK_TEMPLATE(find_repetitive, std::string)->FIND_SHAPES;
+BENCHMARK_TEMPLATE(find_repetitive, immutable_string::string)->FIND_SHAPES;
+
+// haystack size, set size
+#define FIND_OF_SHAPES Args({1024, 2})->Args({65536, 2})->Args({65536, 10})
+
+BENCHMARK_TEMPLATE(find_first_of_absent, std::string)->FIND_OF_SHAPES;
+BENCHMARK_TEMPLATE(find_first_of_absent, immutable_string::string)
+    ->FIND_OF_SHAPES;
+
+}  // namespace
@@ -0,0 +1,90 @@
+#include "immutable_string/flat_map.hpp"
+#include "string_types.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <unordered_map>
+
+namespace {
+
+// std::unordered_map with a node per element vs string_map with slots
+template <class Map>
+struct map_type;
+
+template <>
+struct map_type<std::unordered_map<immutable_string::string, int>> {
+  using type = std::unordered_map<immutable_string::string, int>;
+  static int find(const type& map, const immutable_string::string& key) {
+    const auto it = map.find(key);
+    return it != map.end() ? it->second : 0;
+  }
+};
+
+template <>
+struct map_type<immutable_string::string_map<int>> {
+  using type = immutable_string::string_map<int>;
+  static int find(const type& map, const immutable_string::string& key) {
+    const auto it = map.find(key);
+    return it != map.end() ? it->second : 0;
+  }
+};
+
+// lookups of present keys by strings with buffers of their own
+template <class Map>
+void map_find(benchmark::State& state) {
+  const auto keys = random_keys(state.range(0), 0);
+  typename map_type<Map>::type map;
+  std::vector<immutable_string::string> probes;
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    map[immutable_string::string{keys[i].c_str()}] = static_cast<int>(i);
+    probes.emplace_back(keys[i].c_str());
+  }
+  for (auto _ : state) {
+    for (const auto& probe : probes) {
+      benchmark::DoNotOptimize(map_type<Map>::find(map, probe));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * probes.size());
+}
+
+// lookups by C strings, which string_map takes without making strings
+void map_find_chars(benchmark::State& state) {
+  const auto keys = random_keys(state.range(0), 0);
+  immutable_string::string_map<int> map;
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    map[keys[i].c_str()] = static_cast<int>(i);
+  }
+  for (auto _ : state) {
+    for (const auto& key : keys) {
+      benchmark::DoNotOptimize(map.find(key.c_str()));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <class Map>
+void map_insert(benchmark::State& state) {
+  const auto keys = random_keys(state.range(0), 0);
+  std::vector<immutable_string::string> strs;
+  for (const auto& key : keys) strs.emplace_back(key.c_str());
+  for (auto _ : state) {
+    typename map_type<Map>::type map;
+    for (const auto& str : strs) map[str] = 1;
+    benchmark::DoNotOptimize(map.size());
+  }
+  state.SetItemsProcessed(state.iterations() * strs.size());
+}
+
+// number of keys
+#define MAP_SIZES Arg(1000)->Arg(100000)
+
+BENCHMARK_TEMPLATE(map_find, std::unordered_map<immutable_string::string, int>)
+    ->MAP_SIZES;
+BENCHMARK_TEMPLATE(map_find, immutable_string::string_map<int>)->MAP_SIZES;
+BENCHMARK(map_find_chars)->MAP_SIZES;
+BENCHMARK_TEMPLATE(map_insert,
+                   std::unordered_map<immutable_string::string, int>)
+    ->MAP_SIZES;
+BENCHMARK_TEMPLATE(map_insert, immutable_string::string_map<int>)->MAP_SIZES;
+
+}  // namespace
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "immutable_string/string.hpp"
+
+// The compared string types behind one interface, so every benchmark is
+// written once and instantiated for each of them.
+template <class T>
+struct string_type;
+
+template <>
+struct string_type<std::string> {
+  static std::string make(const std::string& s) { return s; }
+  static const std::string& get(const std::string& s) { return s; }
+  static std::size_t find(const std::string& s, const std::string& needle) {
+    return s.find(needle);
+  }
+  static std::size_t find_first_of(const std::string& s,
+                                   const std::string& set) {
+    return s.find_first_of(set);
+  }
+  static std::size_t hash(const std::string& s) {
+    return std::hash<std::string>{}(s);
+  }
+  static bool less(const std::string& lhs, const std::string& rhs) {
+    return lhs < rhs;
+  }
+};
+
+using shared_string = std::shared_ptr<const std::string>;
+
+template <>
+struct string_type<shared_string> {
+  static shared_string make(const std::string& s) {
+    return std::make_shared<const std::string>(s);
+  }
+  static std::size_t find(const shared_string& s, const std::string& needle) {
+    return s->find(needle);
+  }
+  static std::size_t find_first_of(const shared_string& s,
+                                   const std::string& set) {
+    return s->find_first_of(set);
+  }
+  static std::size_t hash(const shared_string& s) {
+    return std::hash<std::string>{}(*s);
+  }
+  static bool less(const shared_string& lhs, const shared_string& rhs) {
+    return *lhs < *rhs;
+  }
+};
+
+template <>
+struct string_type<immutable_string::string> {
+  using type = immutable_string::string;
+
+  static type make(const std::string& s) { return type{s.data(), s.size()}; }
+  static std::size_t find(const type& s, const std::string& needle) {
+    return s.find(needle.data(), 0, needle.size());
+  }
+  static std::size_t find_first_of(const type& s, const std::string& set) {
+    return s.find_first_of(set.data(), 0, set.size());
+  }
+  static std::size_t hash(const type& s) { return s.hash(); }
+  static bool less(const type& lhs, const type& rhs) { return lhs < rhs; }
+};
+
+// lowercase letters from a fixed seed, so every run measures the same data
+inline std::string random_string(std::mt19937& gen, std::size_t size,
+                                 char max_char = 'z') {
+  std::uniform_int_distribution<int> dist{'a', max_char};
+  std::string res(size, ' ');
+  for (auto& ch : res) ch = static_cast<char>(dist(gen));
+  return res;
+}
+
+// keys of a sort: a common prefix, as in paths or urls, then random letters
+inline std::vector<std::string> random_keys(std::size_t count,
+                                            std::size_t prefix_size) {
+  std::mt19937 gen{42};
+  std::uniform_int_distribution<std::size_t> size_dist{4, 40};
+  const std::string prefix(prefix_size, '/');
+  std::vector<std::string> res;
+  for (std::size_t i = 0; i < count; ++i) {
+    res.push_back(prefix + random_string(gen, size_dist(gen)));
+  }
+  return res;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "immutable_string/string.hpp"
+
+namespace immutable_string {
+
+// Algorithms over ranges of basic_string. They are in a namespace of their
+// own, so unqualified std::sort calls aren't made ambiguous by ADL.
+namespace algorithm {
+
+// Sorts the strings ascending with up to threads threads. Byte strings
+// are ordered by 8 bytes after their common prefix, kept next to their
+// indices, so most comparisons don't read the characters.
+template <class RandomIt>
+void sort(RandomIt first, RandomIt last,
+          unsigned threads = std::thread::hardware_concurrency());
+
+// std::unique with the comparison of strings, which is O(1) for strings
+// sharing a buffer and for strings with different cached hashes
+template <class ForwardIt>
+ForwardIt unique(ForwardIt first, ForwardIt last) {
+  return std::unique(first, last);
+}
+
+// sort and unique: the end of the sorted distinct strings is returned
+template <class RandomIt>
+RandomIt sort_unique(RandomIt first, RandomIt last,
+                     unsigned threads = std::thread::hardware_concurrency()) {
+  algorithm::sort(first, last, threads);
+  return algorithm::unique(first, last);
+}
+
+// Equal adjacent strings, e.g. of a sorted range, become copies of the
+// first one of them, so they share its buffer and the others are freed.
+template <class ForwardIt>
+void share_duplicates(ForwardIt first, ForwardIt last) {
+  if (first == last) return;
+  for (auto next = std::next(first); next != last; ++next) {
+    if (*next == *first) {
+      *next = *first;
+    } else {
+      first = next;
+    }
+  }
+}
+
+}  // namespace algorithm
+
+namespace detail {
+
+// smaller parts are sorted by one thread
+const std::size_t parallel_sort_grain = 8192;
+
+template <class RandomIt, class Compare>
+void parallel_sort(RandomIt first, RandomIt last, const Compare& comp,
+                   unsigned threads) {
+  const auto count = static_cast<std::size_t>(last - first);
+  if (threads <= 1 || count < 2 * parallel_sort_grain) {
+    std::sort(first, last, comp);
+    return;
+  }
+  const auto middle = first + count / 2;
+  const auto left_threads = threads / 2;
+  std::thread left;
+  try {
+    left = std::thread{[=, &comp] {
+      parallel_sort(first, middle, comp, left_threads);
+    }};
+  } catch (const std::system_error&) {
+    // no more threads: the left half is sorted by this one
+    parallel_sort(first, middle, comp, 1);
+  }
+  parallel_sort(middle, last, comp, threads - left_threads);
+  if (left.joinable()) left.join();
+  std::inplace_merge(first, middle, last, comp);
+}
+
+struct sort_key {
+  std::uint64_t prefix;  // 8 bytes from the offset, big-endian, zero-padded
+  std::size_t index;
+};
+
+// 8 bytes of the string from offset as the prefix of sort_key; pieces
+// are read, so concatenations aren't flattened
+template <class String>
+std::uint64_t sort_prefix(const String& str, std::size_t offset) {
+  unsigned char bytes[8] = {};
+  std::size_t filled = 0;
+  str.for_each_piece([&](const typename String::value_type* piece,
+                         std::size_t size) {
+    if (offset >= size) {
+      offset -= size;
+      return;
+    }
+    size = std::min(size - offset, sizeof(bytes) - filled);
+    std::memcpy(bytes + filled, piece + offset, size);
+    filled += size;
+    offset = 0;
+  });
+  return load_big_endian(bytes);
+}
+
+// the size of the prefix which all the strings have in common
+template <class RandomIt>
+std::size_t common_prefix_size(RandomIt first, RandomIt last) {
+  using char_type =
+      typename std::iterator_traits<RandomIt>::value_type::value_type;
+  std::vector<char_type> common;
+  first->for_each_piece([&common](const char_type* piece, std::size_t size) {
+    common.insert(common.end(), piece, piece + size);
+  });
+  auto res = common.size();
+  for (auto it = std::next(first); it != last && res != 0; ++it) {
+    std::size_t pos = 0;
+    it->for_each_piece([&](const char_type* piece, std::size_t size) {
+      for (std::size_t i = 0; i < size && pos < res; ++i, ++pos) {
+        if (piece[i] != common[pos]) res = pos;
+      }
+    });
+    res = std::min(res, pos);
+  }
+  return res;
+}
+
+template <class RandomIt>
+void sort_strings(RandomIt first, RandomIt last, unsigned threads,
+                  std::true_type /* byte traits */) {
+  using string_type = typename std::iterator_traits<RandomIt>::value_type;
+  const auto count = static_cast<std::size_t>(last - first);
+  if (count < 2) return;
+  // keys are taken after the common prefix, as in paths and urls,
+  // so they tell the strings apart
+  const auto offset = common_prefix_size(first, last);
+  std::vector<sort_key> keys(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    keys[i] = sort_key{sort_prefix(first[i], offset), i};
+  }
+  parallel_sort(keys.begin(), keys.end(),
+                [first](const sort_key& lhs, const sort_key& rhs) {
+                  if (lhs.prefix != rhs.prefix) return lhs.prefix < rhs.prefix;
+                  return first[lhs.index] < first[rhs.index];
+                },
+                threads);
+
+  std::vector<string_type> sorted;
+  sorted.reserve(count);
+  for (const auto& key : keys) sorted.push_back(std::move(first[key.index]));
+  std::move(sorted.begin(), sorted.end(), first);
+}
+
+template <class RandomIt>
+void sort_strings(RandomIt first, RandomIt last, unsigned threads,
+                  std::false_type /* byte traits */) {
+  using string_type = typename std::iterator_traits<RandomIt>::value_type;
+  parallel_sort(first, last,
+                [](const string_type& lhs, const string_type& rhs) {
+                  return lhs < rhs;
+                },
+                threads);
+}
+
+}  // namespace detail
+
+template <class RandomIt>
+void algorithm::sort(RandomIt first, RandomIt last, unsigned threads) {
+  using string_type = typename std::iterator_traits<RandomIt>::value_type;
+  detail::sort_strings(
+      first, last, threads,
+      detail::is_byte_traits<typename string_type::value_type,
+                             typename string_type::traits_type>{});
+}
+
+}  // namespace immutable_string
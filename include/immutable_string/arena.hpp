@@ -0,0 +1,211 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+
+#if defined(__has_include)
+#if __has_include(<memory_resource>) && __cplusplus >= 201703L
+#define IMMUTABLE_STRING_PMR 1
+#include <memory_resource>
+#endif
+#endif
+
+#include "immutable_string/string.hpp"
+
+namespace immutable_string {
+
+// Monotonic region for strings which die together: memory is bump-allocated
+// from blocks taken from Allocator and is given back only by release() or
+// the destructor. Strings made by the arena don't own their characters, so
+// copying and destroying them never touches a refcount. They and their
+// copies shall not outlive the arena; compact() makes an owning copy.
+template <class Allocator = std::allocator<char>>
+class basic_arena {
+ public:
+  using allocator_type = Allocator;
+
+  static const std::size_t default_block_size = 64 * 1024;
+
+  explicit basic_arena(const Allocator& alloc = Allocator()) noexcept
+      : basic_arena(default_block_size, alloc) {}
+  explicit basic_arena(std::size_t block_size,
+                       const Allocator& alloc = Allocator()) noexcept
+      : m_block_size(block_size), m_alloc(alloc) {}
+
+  basic_arena(const basic_arena&) = delete;
+  basic_arena& operator=(const basic_arena&) = delete;
+  ~basic_arena() { release(); }
+
+  // bytes of memory aligned by align, which shall be a power of 2
+  void* allocate(std::size_t bytes,
+                 std::size_t align = alignof(std::max_align_t));
+  // frees all the blocks
+  void release() noexcept;
+
+  // bytes given out by allocate() since the last release()
+  std::size_t used_bytes() const noexcept { return m_used; }
+
+  // copy of characters in the arena, strings up to inline_capacity
+  // are stored inline and don't use it
+  template <class CharT>
+  basic_string<CharT> make(const CharT* s, std::size_t count) {
+    return make<basic_string<CharT>>(s, count);
+  }
+  template <class CharT>
+  basic_string<CharT> make(const CharT* s) {
+    return make(s, std::char_traits<CharT>::length(s));
+  }
+  // the same for any basic_string type, e.g. make<string_count_alloc>
+  template <class String>
+  String make(const typename String::value_type* s, std::size_t count);
+
+ private:
+  struct block {
+    block* next;
+    std::size_t units;
+  };
+  using unit = typename std::aligned_storage<sizeof(std::max_align_t),
+                                             alignof(std::max_align_t)>::type;
+  using alloc_type = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<unit>;
+  using alloc_traits = std::allocator_traits<alloc_type>;
+
+  static const std::size_t header_units =
+      (sizeof(block) + sizeof(unit) - 1) / sizeof(unit);
+
+  // returns the memory of the new block after its header
+  char* _add_block(std::size_t bytes);
+
+  block* m_blocks = nullptr;
+  char* m_pos = nullptr;
+  char* m_end = nullptr;
+  std::size_t m_used = 0;
+  std::size_t m_block_size;
+  alloc_type m_alloc;
+};
+
+using arena = basic_arena<>;
+
+#if defined(IMMUTABLE_STRING_PMR)
+namespace pmr {
+// blocks come from a std::pmr::memory_resource
+using arena = basic_arena<std::pmr::polymorphic_allocator<char>>;
+}  // namespace pmr
+#endif
+
+// Allocator which takes memory from an arena and never frees it, so
+// basic_string<CharT, Traits, arena_allocator<CharT>> is bump-allocated
+template <class T, class Upstream = std::allocator<char>>
+class arena_allocator {
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  template <class U>
+  struct rebind {
+    using other = arena_allocator<U, Upstream>;
+  };
+
+  arena_allocator(basic_arena<Upstream>& arena) noexcept : m_arena(&arena) {}
+  template <class U>
+  arena_allocator(const arena_allocator<U, Upstream>& other) noexcept
+      : m_arena(other.m_arena) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T*, std::size_t) noexcept {}
+
+  template <class U>
+  bool operator==(const arena_allocator<U, Upstream>& other) const noexcept {
+    return m_arena == other.m_arena;
+  }
+  template <class U>
+  bool operator!=(const arena_allocator<U, Upstream>& other) const noexcept {
+    return m_arena != other.m_arena;
+  }
+
+  basic_arena<Upstream>* m_arena;
+};
+
+template <class Allocator>
+const std::size_t basic_arena<Allocator>::default_block_size;
+template <class Allocator>
+const std::size_t basic_arena<Allocator>::header_units;
+
+template <class Allocator>
+void* basic_arena<Allocator>::allocate(std::size_t bytes, std::size_t align) {
+  const auto pad =
+      (align - reinterpret_cast<std::uintptr_t>(m_pos)) & (align - 1);
+  if (bytes + pad <= static_cast<std::size_t>(m_end - m_pos)) {
+    const auto res = m_pos + pad;
+    m_pos = res + bytes;
+    m_used += bytes;
+    return res;
+  }
+  const auto padded = bytes + align - 1;
+  if (padded > m_block_size / 4) {
+    // large requests get their own block, so the current one stays in use
+    const auto mem = _add_block(padded);
+    m_used += bytes;
+    return mem + ((align - reinterpret_cast<std::uintptr_t>(mem)) &
+                  (align - 1));
+  }
+  m_pos = _add_block(m_block_size);
+  m_end = m_pos + m_block_size;
+  return allocate(bytes, align);
+}
+
+template <class Allocator>
+void basic_arena<Allocator>::release() noexcept {
+  while (m_blocks) {
+    const auto next = m_blocks->next;
+    const auto units = m_blocks->units;
+    m_blocks->~block();
+    alloc_traits::deallocate(m_alloc, reinterpret_cast<unit*>(m_blocks),
+                             units);
+    m_blocks = next;
+  }
+  m_pos = nullptr;
+  m_end = nullptr;
+  m_used = 0;
+}
+
+template <class Allocator>
+char* basic_arena<Allocator>::_add_block(std::size_t bytes) {
+  const auto units = header_units + (bytes + sizeof(unit) - 1) / sizeof(unit);
+  const auto mem = alloc_traits::allocate(m_alloc, units);
+  m_blocks = new (static_cast<void*>(mem)) block{m_blocks, units};
+  return reinterpret_cast<char*>(mem + header_units);
+}
+
+template <class Allocator>
+template <class String>
+String basic_arena<Allocator>::make(const typename String::value_type* s,
+                                    std::size_t count) {
+  using char_type = typename String::value_type;
+  using traits_type = typename String::traits_type;
+  String res;
+  res.m_size = count;
+  if (count <= String::inline_capacity) {
+    res._init_unowned(s);
+    return res;
+  }
+  const auto chars = static_cast<char_type*>(
+      allocate((count + 1) * sizeof(char_type), alignof(char_type)));
+  traits_type::copy(chars, s, count);
+  chars[count] = char_type();
+  res._init_unowned(chars);
+  return res;
+}
+
+}  // namespace immutable_string
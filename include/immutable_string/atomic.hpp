@@ -0,0 +1,283 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "immutable_string/string.hpp"
+
+// Heap pointers may carry a tag in their top byte on AArch64, e.g. on
+// Android or with MTE, and under HWASan. Define
+// IMMUTABLE_STRING_TAGGED_POINTERS to 0 or 1 in every translation unit to
+// override the detection.
+#if !defined(IMMUTABLE_STRING_TAGGED_POINTERS)
+#if defined(__has_feature)
+#if __has_feature(hwaddress_sanitizer)
+#define IMMUTABLE_STRING_TAGGED_POINTERS 1
+#endif
+#endif
+#endif
+#if !defined(IMMUTABLE_STRING_TAGGED_POINTERS)
+#if defined(__aarch64__) || defined(_M_ARM64) || \
+    defined(__SANITIZE_HWADDRESS__)
+#define IMMUTABLE_STRING_TAGGED_POINTERS 1
+#else
+#define IMMUTABLE_STRING_TAGGED_POINTERS 0
+#endif
+#endif
+
+namespace immutable_string {
+
+// Slot holding a string which threads load and replace concurrently, e.g.
+// a published config value. Lock-free if 64-bit atomics are: the value is
+// kept in a box which the slot points to, and the 16 upper bits of the
+// pointer word count readers copying from the box right now (split
+// reference counting, as in implementations of atomic<shared_ptr>).
+// A reader claims the box by one atomic add on the word, copies the string
+// and gives the claim back; a writer swaps the word and converts its
+// claims into references of the old box, whose last user frees it.
+// Up to 65535 threads may be inside load() at once. Where pointers may be
+// tagged, see IMMUTABLE_STRING_TAGGED_POINTERS, the top byte keeps the tag
+// and the claims take the byte below it: loads wait while 255 others are
+// inside load(). The addresses of boxes shall fit in 48 bits, as user
+// space addresses do unless the system opts in to wider ones; storing a
+// value whose box is put higher throws std::bad_alloc.
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class Allocator = std::allocator<CharT>,
+          class RefCount = atomic_refcount>
+class atomic_basic_string {
+  static_assert(RefCount::is_thread_safe,
+                "strings shared by threads need a thread-safe refcount");
+
+ public:
+  using string_type = basic_string<CharT, Traits, Allocator, RefCount>;
+  using allocator_type = Allocator;
+
+  explicit atomic_basic_string(const Allocator& alloc = Allocator()) noexcept
+      : m_word(0), m_alloc(alloc) {}
+  explicit atomic_basic_string(string_type value,
+                               const Allocator& alloc = Allocator())
+      : m_word(0), m_alloc(alloc) {
+    m_word.store(_word(_make(std::move(value))), std::memory_order_relaxed);
+  }
+
+  atomic_basic_string(const atomic_basic_string&) = delete;
+  atomic_basic_string& operator=(const atomic_basic_string&) = delete;
+  ~atomic_basic_string() {
+    _retire(m_word.load(std::memory_order_acquire), 0);
+  }
+
+  bool is_lock_free() const noexcept { return m_word.is_lock_free(); }
+
+  string_type load() const;
+  void store(string_type desired) { exchange(std::move(desired)); }
+  // returns the replaced value
+  string_type exchange(string_type desired);
+  // replaces the value if it is equal to expected, otherwise loads it into
+  // expected; equal strings sharing a buffer are compared in O(1)
+  bool compare_exchange_strong(string_type& expected, string_type desired);
+  bool compare_exchange_weak(string_type& expected, string_type desired) {
+    return compare_exchange_strong(expected, std::move(desired));
+  }
+
+  operator string_type() const { return load(); }
+  atomic_basic_string& operator=(string_type desired) {
+    store(std::move(desired));
+    return *this;
+  }
+
+ private:
+  struct box {
+    explicit box(string_type&& str) noexcept : value(std::move(str)) {}
+
+    // references given by writers for converted claims minus claims given
+    // back after the swap; it may go below 0 until the writer converts
+    std::atomic<std::ptrdiff_t> refs{0};
+    const string_type value;
+  };
+  using alloc_type =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<box>;
+  using alloc_traits = std::allocator_traits<alloc_type>;
+
+  static const int claim_shift = 48;
+  static const std::uint64_t one_claim = std::uint64_t(1) << claim_shift;
+#if IMMUTABLE_STRING_TAGGED_POINTERS
+  static const std::uint64_t claim_mask = std::uint64_t(0xff) << claim_shift;
+#else
+  static const std::uint64_t claim_mask = ~(one_claim - 1);
+#endif
+
+  static box* _box(std::uint64_t word) noexcept {
+    return reinterpret_cast<box*>(
+        static_cast<std::uintptr_t>(word & ~claim_mask));
+  }
+  static std::uint64_t _word(box* b) noexcept {
+    return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(b));
+  }
+  static std::ptrdiff_t _claims(std::uint64_t word) noexcept {
+    return static_cast<std::ptrdiff_t>((word & claim_mask) >> claim_shift);
+  }
+
+  // empty strings need no box
+  box* _make(string_type&& value);
+  void _destroy(box* b) const noexcept;
+  box* _claim() const noexcept;
+  void _unclaim(box* b) const noexcept;
+  // word was swapped out of the slot and its claims but own are converted
+  void _retire(std::uint64_t word, std::ptrdiff_t own) const noexcept;
+  string_type _value(const box* b) const noexcept {
+    return b ? b->value : string_type{Allocator{m_alloc}};
+  }
+
+  mutable std::atomic<std::uint64_t> m_word;
+  mutable alloc_type m_alloc;
+};
+
+using atomic_string = atomic_basic_string<char>;
+using atomic_wstring = atomic_basic_string<wchar_t>;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+const int atomic_basic_string<CharT, Traits, Allocator, RefCount>::claim_shift;
+template <class CharT, class Traits, class Allocator, class RefCount>
+const std::uint64_t
+    atomic_basic_string<CharT, Traits, Allocator, RefCount>::one_claim;
+template <class CharT, class Traits, class Allocator, class RefCount>
+const std::uint64_t
+    atomic_basic_string<CharT, Traits, Allocator, RefCount>::claim_mask;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename atomic_basic_string<CharT, Traits, Allocator, RefCount>::string_type
+atomic_basic_string<CharT, Traits, Allocator, RefCount>::load() const {
+  const auto b = _claim();
+  auto res = _value(b);
+  _unclaim(b);
+  return res;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename atomic_basic_string<CharT, Traits, Allocator, RefCount>::string_type
+atomic_basic_string<CharT, Traits, Allocator, RefCount>::exchange(
+    string_type desired) {
+  const auto old = m_word.exchange(_word(_make(std::move(desired))),
+                                   std::memory_order_acq_rel);
+  // the old box lives until its claims are converted
+  auto res = _value(_box(old));
+  _retire(old, 0);
+  return res;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+bool atomic_basic_string<CharT, Traits, Allocator, RefCount>::
+    compare_exchange_strong(string_type& expected, string_type desired) {
+  const auto fresh = _make(std::move(desired));
+  for (;;) {
+    // the claim keeps the box alive and its address unique while it is
+    // compared, so the word still holds the same value if it holds the box
+    const auto b = _claim();
+    if (!(b ? b->value == expected : expected.empty())) {
+      expected = _value(b);
+      _unclaim(b);
+      _destroy(fresh);
+      return false;
+    }
+    auto word = m_word.load(std::memory_order_relaxed);
+    while (_box(word) == b) {
+      if (m_word.compare_exchange_weak(word, _word(fresh),
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_relaxed)) {
+        _retire(word, 1);
+        return true;
+      }
+    }
+    // replaced meanwhile: the claim is converted already, compare again
+    _unclaim(b);
+  }
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename atomic_basic_string<CharT, Traits, Allocator, RefCount>::box*
+atomic_basic_string<CharT, Traits, Allocator, RefCount>::_make(
+    string_type&& value) {
+  if (value.empty()) return nullptr;
+  const auto mem = alloc_traits::allocate(m_alloc, 1);
+  const auto b = new (static_cast<void*>(mem)) box(std::move(value));
+  if ((_word(b) & claim_mask) != 0) {
+    // the bits are taken for claims, e.g. on hosts with 5-level paging
+    _destroy(b);
+    throw std::bad_alloc();
+  }
+  return b;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void atomic_basic_string<CharT, Traits, Allocator, RefCount>::_destroy(
+    box* b) const noexcept {
+  if (!b) return;
+  b->~box();
+  alloc_traits::deallocate(m_alloc, b, 1);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename atomic_basic_string<CharT, Traits, Allocator, RefCount>::box*
+atomic_basic_string<CharT, Traits, Allocator, RefCount>::_claim() const
+    noexcept {
+#if IMMUTABLE_STRING_TAGGED_POINTERS
+  // claims shall not carry into the tag: the empty value isn't claimed,
+  // and a full claim byte is waited out
+  auto word = m_word.load(std::memory_order_relaxed);
+  for (;;) {
+    if (!_box(word)) return nullptr;
+    if ((word & claim_mask) == claim_mask) {
+      std::this_thread::yield();
+      word = m_word.load(std::memory_order_relaxed);
+      continue;
+    }
+    if (m_word.compare_exchange_weak(word, word + one_claim,
+                                     std::memory_order_acquire,
+                                     std::memory_order_relaxed)) {
+      return _box(word);
+    }
+  }
+#else
+  return _box(m_word.fetch_add(one_claim, std::memory_order_acquire));
+#endif
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void atomic_basic_string<CharT, Traits, Allocator, RefCount>::_unclaim(
+    box* b) const noexcept {
+  // claims of the empty value are never given back: it has no box to free
+  // and may be stored again, so its claim bits are meaningless and
+  // overflow out of the word harmlessly (with tagged pointers they aren't
+  // taken at all)
+  if (!b) return;
+  auto word = m_word.load(std::memory_order_relaxed);
+  while (_box(word) == b) {
+    if (m_word.compare_exchange_weak(word, word - one_claim,
+                                     std::memory_order_release,
+                                     std::memory_order_relaxed)) {
+      return;
+    }
+  }
+  // the box is swapped out, the writer converts or converted the claim
+  if (b->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) _destroy(b);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void atomic_basic_string<CharT, Traits, Allocator, RefCount>::_retire(
+    std::uint64_t word, std::ptrdiff_t own) const noexcept {
+  const auto b = _box(word);
+  if (!b) return;
+  const auto converted = _claims(word) - own;
+  if (b->refs.fetch_add(converted, std::memory_order_acq_rel) + converted ==
+      0) {
+    _destroy(b);
+  }
+}
+
+}  // namespace immutable_string
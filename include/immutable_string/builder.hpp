@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "immutable_string/string.hpp"
+
+namespace immutable_string {
+
+// Mutable buffer in the layout of a long basic_string. freeze() turns it
+// into a string without copying: the buffer itself becomes shared.
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class Allocator = std::allocator<CharT>,
+          class RefCount = atomic_refcount>
+class basic_string_builder {
+ public:
+  using string_type = basic_string<CharT, Traits, Allocator, RefCount>;
+  using traits_type = Traits;
+  using value_type = CharT;
+  using allocator_type = Allocator;
+  using size_type = typename string_type::size_type;
+
+  explicit basic_string_builder(const Allocator& alloc = Allocator()) noexcept
+      : m_alloc(alloc) {}
+  // reserves room for capacity characters
+  explicit basic_string_builder(size_type capacity,
+                                const Allocator& alloc = Allocator())
+      : m_alloc(alloc) {
+    reserve(capacity);
+  }
+
+  basic_string_builder(const basic_string_builder&) = delete;
+  basic_string_builder& operator=(const basic_string_builder&) = delete;
+  basic_string_builder(basic_string_builder&& other) noexcept
+      : m_rep(other.m_rep), m_size(other.m_size), m_alloc(other.m_alloc) {
+    other.m_rep = nullptr;
+    other.m_size = 0;
+  }
+  ~basic_string_builder() {
+    if (m_rep) detail::release<RefCount>(m_rep);
+  }
+
+  bool empty() const noexcept { return m_size == 0; }
+  size_type size() const noexcept { return m_size; }
+  size_type capacity() const noexcept {
+    return m_rep ? m_rep->m_capacity : 0;
+  }
+  // characters written so far, not null-terminated
+  CharT* data() noexcept { return m_rep ? m_rep->chars() : nullptr; }
+  const CharT* data() const noexcept {
+    return m_rep ? m_rep->chars() : nullptr;
+  }
+
+  void reserve(size_type capacity);
+  void clear() noexcept { m_size = 0; }
+
+  // appends count characters and returns them to be written by the caller
+  CharT* extend(size_type count);
+
+  basic_string_builder& append(const CharT* s, size_type count) {
+    Traits::copy(extend(count), s, count);
+    return *this;
+  }
+  basic_string_builder& append(const CharT* s) {
+    return append(s, Traits::length(s));
+  }
+  basic_string_builder& append(size_type count, CharT ch) {
+    Traits::assign(extend(count), count, ch);
+    return *this;
+  }
+  template <class A, class R>
+  basic_string_builder& append(const basic_string<CharT, Traits, A, R>& str) {
+    auto dest = extend(str.size());
+    str.for_each_piece([&dest](const CharT* piece, size_type count) {
+      Traits::copy(dest, piece, count);
+      dest += count;
+    });
+    return *this;
+  }
+  basic_string_builder& push_back(CharT ch) { return append(1, ch); }
+
+  template <class T>
+  basic_string_builder& operator+=(const T& value) {
+    return append(value);
+  }
+  basic_string_builder& operator+=(CharT ch) { return push_back(ch); }
+
+  // The characters as a string; the builder is left empty. Long results
+  // take over the buffer, unless more than a quarter of it is unused:
+  // then they are copied into a buffer of the exact size and the builder
+  // keeps its buffer for the next string.
+  string_type freeze();
+
+ private:
+  using rep_type = detail::growable_rep<CharT, Allocator, RefCount>;
+
+  void _grow(size_type capacity);
+
+  rep_type* m_rep = nullptr;
+  size_type m_size = 0;
+  typename rep_type::alloc_type m_alloc;
+};
+
+using string_builder = basic_string_builder<char>;
+using wstring_builder = basic_string_builder<wchar_t>;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string_builder<CharT, Traits, Allocator, RefCount>::reserve(
+    size_type capacity) {
+  if (capacity > this->capacity()) _grow(capacity);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+CharT* basic_string_builder<CharT, Traits, Allocator, RefCount>::extend(
+    size_type count) {
+  if (count > capacity() - m_size) {
+    // geometric growth keeps appends amortized O(1);
+    // shorter strings than min_capacity are inline anyway
+    const auto min_capacity = 2 * (string_type::inline_capacity + 1);
+    _grow(std::max({m_size + count, 2 * capacity(), min_capacity}));
+  }
+  const auto res = m_rep ? m_rep->chars() + m_size : nullptr;
+  m_size += count;
+  return res;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string_builder<CharT, Traits, Allocator, RefCount>::_grow(
+    size_type capacity) {
+  const auto rep = rep_type::create(m_alloc, capacity);
+  if (m_rep) {
+    Traits::copy(rep->chars(), m_rep->chars(), m_size);
+    detail::release<RefCount>(m_rep);
+  }
+  m_rep = rep;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string_builder<CharT, Traits, Allocator, RefCount>::string_type
+basic_string_builder<CharT, Traits, Allocator, RefCount>::freeze() {
+  const auto size = m_size;
+  m_size = 0;
+  if (size <= string_type::inline_capacity ||
+      capacity() - size > capacity() / 4) {
+    return string_type{data(), size, Allocator{m_alloc}};
+  }
+  detail::stats_created(size);
+  string_type res;
+  res.m_size = size;
+  res.m_storage.heap.data = m_rep->chars();
+  res.m_storage.heap.rep = m_rep;
+  m_rep->m_size = size;
+  m_rep->chars()[size] = CharT();
+  m_rep = nullptr;
+  return res;
+}
+
+}  // namespace immutable_string
@@ -0,0 +1,428 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "immutable_string/atomic.hpp"
+#include "immutable_string/builder.hpp"
+#include "immutable_string/string.hpp"
+
+namespace immutable_string {
+
+// LZ77 byte codec in the spirit of LZ4: each sequence is a token with the
+// literal length and the match length in its nibbles, the literals, and a
+// 16-bit offset of the match, with lengths over 15 continued in bytes.
+// Fast rather than tight; codecs of real libraries fit the same interface:
+//   struct lz4_codec {
+//     static std::size_t bound(std::size_t n) { return LZ4_compressBound(n); }
+//     static std::size_t compress(const char* src, std::size_t n, char* dest)
+//     { return LZ4_compress_default(src, dest, n, bound(n)); }
+//     static void decompress(const char* src, std::size_t n, char* dest,
+//                            std::size_t size)
+//     { LZ4_decompress_safe(src, dest, n, size); }
+//   };
+struct lz_codec {
+  // compressed size of n bytes is at most that
+  static std::size_t bound(std::size_t n) noexcept {
+    return n + n / 255 + 16;
+  }
+  // compresses n bytes at src into dest with room for bound(n) bytes,
+  // returns the compressed size
+  static std::size_t compress(const char* src, std::size_t n,
+                              char* dest) noexcept;
+  // decompresses n bytes made by compress into size bytes at dest
+  static void decompress(const char* src, std::size_t n, char* dest,
+                         std::size_t size) noexcept;
+
+ private:
+  static const unsigned hash_bits = 12;
+  static const std::size_t min_match = 4;
+  static const std::size_t max_offset = 65535;
+
+  static std::uint32_t _load(const unsigned char* s) noexcept {
+    std::uint32_t res;
+    std::memcpy(&res, s, 4);
+    return res;
+  }
+  static unsigned char* _length(unsigned char* out,
+                                std::size_t len) noexcept {
+    for (; len >= 255; len -= 255) *out++ = 255;
+    *out++ = static_cast<unsigned char>(len);
+    return out;
+  }
+  static std::size_t _read_length(const unsigned char*& in) noexcept {
+    std::size_t res = 0;
+    unsigned char byte;
+    do {
+      byte = *in++;
+      res += byte;
+    } while (byte == 255);
+    return res;
+  }
+  // the sequence of count literals at s, then the match of len bytes at
+  // offset unless len is 0
+  static unsigned char* _sequence(unsigned char* out, const unsigned char* s,
+                                  std::size_t count, std::size_t offset,
+                                  std::size_t len) noexcept;
+};
+
+inline std::size_t lz_codec::compress(const char* src, std::size_t n,
+                                      char* dest) noexcept {
+  const auto s = reinterpret_cast<const unsigned char*>(src);
+  const auto out_begin = reinterpret_cast<unsigned char*>(dest);
+  auto out = out_begin;
+  // positions + 1 of the last 4 bytes of each hash, 0 for none
+  std::uint32_t table[1u << hash_bits] = {};
+  std::size_t anchor = 0;
+  for (std::size_t i = 0; i + min_match <= n;) {
+    const auto word = _load(s + i);
+    auto& slot = table[(word * 2654435761u) >> (32 - hash_bits)];
+    const std::size_t candidate = slot;
+    slot = static_cast<std::uint32_t>(i + 1);
+    if (candidate == 0 || i - (candidate - 1) > max_offset ||
+        _load(s + candidate - 1) != word) {
+      // incompressible input is skipped faster and faster
+      i += 1 + ((i - anchor) >> 6);
+      continue;
+    }
+    const auto match = candidate - 1;
+    auto len = min_match;
+    while (i + len < n && s[match + len] == s[i + len]) ++len;
+    out = _sequence(out, s + anchor, i - anchor, i - match, len);
+    i += len;
+    anchor = i;
+  }
+  out = _sequence(out, s + anchor, n - anchor, 0, 0);
+  return static_cast<std::size_t>(out - out_begin);
+}
+
+inline unsigned char* lz_codec::_sequence(unsigned char* out,
+                                          const unsigned char* s,
+                                          std::size_t count,
+                                          std::size_t offset,
+                                          std::size_t len) noexcept {
+  const auto extra = len == 0 ? 0 : len - min_match;
+  auto& token = *out++;
+  token = static_cast<unsigned char>(((count < 15 ? count : 15) << 4) |
+                                     (extra < 15 ? extra : 15));
+  if (count >= 15) out = _length(out, count - 15);
+  std::memcpy(out, s, count);
+  out += count;
+  if (len == 0) return out;
+  *out++ = static_cast<unsigned char>(offset);
+  *out++ = static_cast<unsigned char>(offset >> 8);
+  if (extra >= 15) out = _length(out, extra - 15);
+  return out;
+}
+
+inline void lz_codec::decompress(const char* src, std::size_t n, char* dest,
+                                 std::size_t size) noexcept {
+  auto in = reinterpret_cast<const unsigned char*>(src);
+  const auto in_end = in + n;
+  auto out = reinterpret_cast<unsigned char*>(dest);
+  const auto out_end = out + size;
+  // the last sequence is literals only, maybe none
+  while (in != in_end) {
+    const unsigned token = *in++;
+    auto count = static_cast<std::size_t>(token >> 4);
+    if (count == 15) count += _read_length(in);
+    std::memcpy(out, in, count);
+    in += count;
+    out += count;
+    if (out == out_end) return;
+    const std::size_t offset = in[0] | (in[1] << 8);
+    in += 2;
+    auto len = static_cast<std::size_t>(token & 15) + min_match;
+    if ((token & 15) == 15) len += _read_length(in);
+    // a match may overlap its own output, repeating a pattern
+    const auto from = out - offset;
+    if (offset >= len) {
+      std::memcpy(out, from, len);
+    } else {
+      for (std::size_t i = 0; i < len; ++i) out[i] = from[i];
+    }
+    out += len;
+  }
+}
+
+namespace detail {
+
+// Compressed strings with a decompressed copy, which may be dropped under
+// memory pressure. Linking, filling and dropping the copies are guarded by
+// the mutex of the registry; readers of a copy never take it.
+struct cache_node {
+  using drop_fn = void (*)(cache_node*);
+
+  explicit cache_node(drop_fn drop) noexcept : m_drop(drop) {}
+
+  drop_fn m_drop;
+  // nullptr unless linked
+  cache_node* m_prev = nullptr;
+  cache_node* m_next = nullptr;
+  std::size_t m_bytes = 0;
+};
+
+class cache_registry {
+ public:
+  // never destroyed: compressed strings of static storage duration may
+  // outlive any other static object
+  static cache_registry& instance() {
+    static const auto registry = new cache_registry;
+    return *registry;
+  }
+
+  std::mutex& mutex() noexcept { return m_mutex; }
+
+  // the rest is called with the mutex locked
+  void link(cache_node* node, std::size_t bytes) noexcept {
+    node->m_bytes = bytes;
+    node->m_prev = &m_head;
+    node->m_next = m_head.m_next;
+    m_head.m_next->m_prev = node;
+    m_head.m_next = node;
+    m_bytes += bytes;
+  }
+  void unlink(cache_node* node) noexcept {
+    if (!node->m_prev) return;
+    node->m_prev->m_next = node->m_next;
+    node->m_next->m_prev = node->m_prev;
+    node->m_prev = node->m_next = nullptr;
+    m_bytes -= node->m_bytes;
+  }
+  // drops the copy of node, returns its bytes
+  std::size_t drop(cache_node* node) {
+    if (!node->m_prev) return 0;
+    const auto res = node->m_bytes;
+    unlink(node);
+    node->m_drop(node);
+    return res;
+  }
+  std::size_t trim() {
+    std::size_t res = 0;
+    while (m_head.m_next != &m_head) res += drop(m_head.m_next);
+    return res;
+  }
+  std::size_t bytes() const noexcept { return m_bytes; }
+
+ private:
+  cache_registry() noexcept : m_head(nullptr) {
+    m_head.m_prev = m_head.m_next = &m_head;
+  }
+
+  std::mutex m_mutex;
+  cache_node m_head;
+  std::size_t m_bytes = 0;
+};
+
+// the compressed bytes follow the header in one allocation, which is
+// shared by the copies of a compressed string as a string's buffer is
+template <class String, class Codec>
+struct compressed_rep : rep_base<typename String::refcount_type>, cache_node {
+  using base = rep_base<typename String::refcount_type>;
+  using char_type = typename String::value_type;
+  using allocator_type = typename String::allocator_type;
+  using unit = typename std::aligned_storage<sizeof(base*),
+                                             alignof(base)>::type;
+  using alloc_type = typename std::allocator_traits<
+      allocator_type>::template rebind_alloc<unit>;
+  using alloc_traits = std::allocator_traits<alloc_type>;
+  using cache_type =
+      atomic_basic_string<char_type, typename String::traits_type,
+                          allocator_type, typename String::refcount_type>;
+
+  compressed_rep(const alloc_type& alloc, std::size_t size,
+                 std::size_t bytes) noexcept
+      : base(&compressed_rep::_release, size),
+        cache_node(&compressed_rep::_drop),
+        m_bytes(bytes),
+        m_cache(allocator_type{alloc}),
+        m_alloc(alloc) {}
+
+  char* bytes() noexcept { return reinterpret_cast<char*>(this + 1); }
+
+  static compressed_rep* create(const allocator_type& alloc, std::size_t size,
+                                const char* bytes, std::size_t count);
+  // the decompressed characters, the cached copy if there is one
+  String load();
+
+  std::size_t m_bytes;
+  cache_type m_cache;
+  alloc_type m_alloc;
+
+ private:
+  static std::size_t _units(std::size_t bytes) noexcept {
+    return (sizeof(compressed_rep) + bytes + sizeof(unit) - 1) / sizeof(unit);
+  }
+  static void _drop(cache_node* node) {
+    static_cast<compressed_rep*>(node)->m_cache.store(
+        String{allocator_type{static_cast<compressed_rep*>(node)->m_alloc}});
+  }
+  static void _release(base* rep_base) noexcept;
+};
+
+template <class String, class Codec>
+compressed_rep<String, Codec>* compressed_rep<String, Codec>::create(
+    const allocator_type& alloc, std::size_t size, const char* bytes,
+    std::size_t count) {
+  alloc_type unit_alloc{alloc};
+  void* mem = alloc_traits::allocate(unit_alloc, _units(count));
+  stats_allocated(_units(count) * sizeof(unit));
+  const auto rep = new (mem) compressed_rep(unit_alloc, size, count);
+  std::memcpy(rep->bytes(), bytes, count);
+  return rep;
+}
+
+template <class String, class Codec>
+String compressed_rep<String, Codec>::load() {
+  auto res = m_cache.load();
+  if (!res.empty()) return res;
+  const auto size = this->m_size;
+  basic_string_builder<char_type, typename String::traits_type,
+                       allocator_type, typename String::refcount_type>
+      builder{size, allocator_type{m_alloc}};
+  Codec::decompress(bytes(), m_bytes,
+                    reinterpret_cast<char*>(builder.extend(size)),
+                    size * sizeof(char_type));
+  auto fresh = builder.freeze();
+  auto& registry = cache_registry::instance();
+  std::lock_guard<std::mutex> lock{registry.mutex()};
+  // another thread may have filled the cache meanwhile
+  if (!m_cache.compare_exchange_strong(res, fresh)) return res;
+  registry.link(this, size * sizeof(char_type));
+  return fresh;
+}
+
+template <class String, class Codec>
+void compressed_rep<String, Codec>::_release(base* rep_base) noexcept {
+  const auto rep = static_cast<compressed_rep*>(rep_base);
+  {
+    auto& registry = cache_registry::instance();
+    std::lock_guard<std::mutex> lock{registry.mutex()};
+    registry.unlink(rep);
+  }
+  alloc_type unit_alloc{std::move(rep->m_alloc)};
+  const auto units = _units(rep->m_bytes);
+  stats_freed(units * sizeof(unit));
+  rep->~compressed_rep();
+  alloc_traits::deallocate(unit_alloc, reinterpret_cast<unit*>(rep), units);
+}
+
+}  // namespace detail
+
+// Large, rarely read string kept compressed by Codec. str() decompresses
+// it on the first call into a plain string, which stays cached for the
+// next calls until trim_compressed_caches() or drop_cache() drops it;
+// strings returned before keep their characters as long as they live,
+// so dropping is safe at any time. Copies share the compressed bytes and
+// the cache. Short strings and strings which compress poorly are kept
+// as they are. String shall have a thread-safe refcount.
+template <class String = string, class Codec = lz_codec>
+class basic_compressed_string {
+ public:
+  using string_type = String;
+  using char_type = typename String::value_type;
+  using allocator_type = typename String::allocator_type;
+  using size_type = typename String::size_type;
+
+  // shorter strings aren't compressed
+  static const size_type min_bytes = 256;
+
+  basic_compressed_string() noexcept = default;
+  // alloc makes the compressed buffer and the decompressed copies
+  explicit basic_compressed_string(
+      const String& str, const allocator_type& alloc = allocator_type());
+
+  basic_compressed_string(const basic_compressed_string& other) noexcept
+      : m_rep(other.m_rep), m_raw(other.m_raw) {
+    if (m_rep) detail::acquire(m_rep);
+  }
+  basic_compressed_string(basic_compressed_string&& other) noexcept
+      : m_rep(other.m_rep), m_raw(std::move(other.m_raw)) {
+    other.m_rep = nullptr;
+  }
+  basic_compressed_string& operator=(basic_compressed_string other) noexcept {
+    swap(other);
+    return *this;
+  }
+  ~basic_compressed_string() {
+    if (m_rep) detail::release<refcount_type>(m_rep);
+  }
+
+  void swap(basic_compressed_string& other) noexcept {
+    std::swap(m_rep, other.m_rep);
+    m_raw.swap(other.m_raw);
+  }
+
+  size_type size() const noexcept {
+    return m_rep ? m_rep->m_size : m_raw.size();
+  }
+  bool empty() const noexcept { return size() == 0; }
+  bool is_compressed() const noexcept { return m_rep != nullptr; }
+  // bytes kept for the characters besides the cache
+  std::size_t stored_bytes() const noexcept {
+    return m_rep ? m_rep->m_bytes : m_raw.size() * sizeof(char_type);
+  }
+
+  // the characters, decompressed if they aren't cached
+  String str() const { return m_rep ? m_rep->load() : m_raw; }
+  // releases the cached copy; returns its bytes
+  std::size_t drop_cache() const;
+
+ private:
+  using refcount_type = typename String::refcount_type;
+  using rep_type = detail::compressed_rep<String, Codec>;
+
+  rep_type* m_rep = nullptr;
+  String m_raw;
+};
+
+using compressed_string = basic_compressed_string<>;
+using compressed_wstring = basic_compressed_string<wstring>;
+
+template <class String, class Codec>
+const typename basic_compressed_string<String, Codec>::size_type
+    basic_compressed_string<String, Codec>::min_bytes;
+
+template <class String, class Codec>
+basic_compressed_string<String, Codec>::basic_compressed_string(
+    const String& str, const allocator_type& alloc)
+    : m_raw(str) {
+  const auto bytes = str.size() * sizeof(char_type);
+  if (bytes < min_bytes) return;
+  const std::unique_ptr<char[]> compressed{new char[Codec::bound(bytes)]};
+  const auto count = Codec::compress(
+      reinterpret_cast<const char*>(str.data()), bytes, compressed.get());
+  // saving less than an eighth isn't worth decompressing
+  if (count > bytes - bytes / 8) return;
+  m_rep = rep_type::create(alloc, str.size(), compressed.get(), count);
+  m_raw = String{alloc};
+}
+
+template <class String, class Codec>
+std::size_t basic_compressed_string<String, Codec>::drop_cache() const {
+  if (!m_rep) return 0;
+  auto& registry = detail::cache_registry::instance();
+  std::lock_guard<std::mutex> lock{registry.mutex()};
+  return registry.drop(m_rep);
+}
+
+// Hooks for memory pressure: the bytes of the decompressed copies of all
+// compressed strings, and dropping them all; returns the bytes dropped.
+inline std::size_t compressed_cache_bytes() {
+  auto& registry = detail::cache_registry::instance();
+  std::lock_guard<std::mutex> lock{registry.mutex()};
+  return registry.bytes();
+}
+inline std::size_t trim_compressed_caches() {
+  auto& registry = detail::cache_registry::instance();
+  std::lock_guard<std::mutex> lock{registry.mutex()};
+  return registry.trim();
+}
+
+}  // namespace immutable_string
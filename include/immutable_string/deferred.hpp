@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+
+#include "immutable_string/string.hpp"
+
+namespace immutable_string {
+
+namespace detail {
+
+// Blocks of Upstream which are freed by the thread which allocated them.
+// Another thread freeing a block pushes it onto a lock-free list of the
+// owner, which frees the whole list at its next allocation or flush(),
+// so the allocator never sees cross-thread frees and the cache lines of
+// the blocks stay with their thread. Blocks outliving their thread are
+// freed by whoever drops them.
+template <class Upstream>
+class deferred_heap {
+ public:
+  static void* allocate(std::size_t bytes);
+  static void deallocate(void* p) noexcept;
+  // frees the blocks given back by other threads, returns their number
+  static std::size_t flush() noexcept;
+
+ private:
+  struct owner;
+  struct block {
+    owner* from;  // nullptr if freed by any thread directly
+    block* next;
+    std::size_t units;
+  };
+  struct owner {
+    std::atomic<block*> returned{nullptr};
+    // blocks dropped after the thread is gone minus the blocks left at
+    // its exit; the last one frees the owner, see _close
+    std::atomic<std::ptrdiff_t> orphans{0};
+    // allocated and not freed yet, changed by the owner thread only
+    std::size_t blocks = 0;
+  };
+  // closes the owner of the thread at exit
+  struct closer {
+    ~closer() { _close(); }
+  };
+  enum thread_state { no_owner, active, finished };
+
+  using unit = typename std::aligned_storage<sizeof(std::max_align_t),
+                                             alignof(std::max_align_t)>::type;
+  using alloc_type =
+      typename std::allocator_traits<Upstream>::template rebind_alloc<unit>;
+  using alloc_traits = std::allocator_traits<alloc_type>;
+
+  static const std::size_t header_units =
+      (sizeof(block) + sizeof(unit) - 1) / sizeof(unit);
+
+  // marks the list of a finished thread
+  static block* _closed() noexcept {
+    static block sentinel;
+    return &sentinel;
+  }
+  static owner* _local();
+  static void _close() noexcept;
+  static void _free(block* b) noexcept {
+    // Upstream is stateless, any instance frees the blocks of others
+    alloc_type upstream;
+    alloc_traits::deallocate(upstream, reinterpret_cast<unit*>(b), b->units);
+  }
+  static void _drop_orphan(owner* from) noexcept {
+    if (from->orphans.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete from;
+    }
+  }
+
+  static thread_local owner* t_owner;
+  static thread_local thread_state t_state;
+};
+
+template <class Upstream>
+thread_local typename deferred_heap<Upstream>::owner*
+    deferred_heap<Upstream>::t_owner = nullptr;
+template <class Upstream>
+thread_local typename deferred_heap<Upstream>::thread_state
+    deferred_heap<Upstream>::t_state = deferred_heap<Upstream>::no_owner;
+template <class Upstream>
+const std::size_t deferred_heap<Upstream>::header_units;
+
+template <class Upstream>
+void* deferred_heap<Upstream>::allocate(std::size_t bytes) {
+  const auto from = _local();
+  if (from && from->returned.load(std::memory_order_relaxed)) flush();
+  const auto units = header_units + (bytes + sizeof(unit) - 1) / sizeof(unit);
+  alloc_type upstream;
+  const auto mem = alloc_traits::allocate(upstream, units);
+  new (static_cast<void*>(mem)) block{from, nullptr, units};
+  if (from) ++from->blocks;
+  return mem + header_units;
+}
+
+template <class Upstream>
+void deferred_heap<Upstream>::deallocate(void* p) noexcept {
+  const auto b =
+      reinterpret_cast<block*>(static_cast<unit*>(p) - header_units);
+  const auto from = b->from;
+  if (!from) return _free(b);
+  if (from == t_owner) {
+    --from->blocks;
+    return _free(b);
+  }
+  auto head = from->returned.load(std::memory_order_relaxed);
+  do {
+    if (head == _closed()) {
+      _free(b);
+      return _drop_orphan(from);
+    }
+    b->next = head;
+  } while (!from->returned.compare_exchange_weak(
+      head, b, std::memory_order_release, std::memory_order_relaxed));
+}
+
+template <class Upstream>
+std::size_t deferred_heap<Upstream>::flush() noexcept {
+  const auto from = t_owner;
+  if (!from) return 0;
+  auto list = from->returned.exchange(nullptr, std::memory_order_acquire);
+  std::size_t res = 0;
+  while (list) {
+    const auto next = list->next;
+    _free(list);
+    list = next;
+    ++res;
+  }
+  from->blocks -= res;
+  return res;
+}
+
+template <class Upstream>
+typename deferred_heap<Upstream>::owner* deferred_heap<Upstream>::_local() {
+  // a thread which is finishing gets no new owner, its blocks are plain
+  if (t_state != no_owner) return t_owner;
+  t_state = active;
+  t_owner = new owner;
+  static thread_local closer close_at_exit;
+  (void)close_at_exit;
+  return t_owner;
+}
+
+template <class Upstream>
+void deferred_heap<Upstream>::_close() noexcept {
+  const auto from = t_owner;
+  auto list = from->returned.exchange(_closed(), std::memory_order_acquire);
+  while (list) {
+    const auto next = list->next;
+    _free(list);
+    list = next;
+    --from->blocks;
+  }
+  t_owner = nullptr;
+  t_state = finished;
+  // the blocks still alive are freed by other threads, which count down
+  // the orphans: whoever brings them to 0 frees the owner
+  const auto left = static_cast<std::ptrdiff_t>(from->blocks);
+  if (from->orphans.fetch_add(left, std::memory_order_acq_rel) + left == 0) {
+    delete from;
+  }
+}
+
+}  // namespace detail
+
+// Allocator whose blocks are freed by the thread which allocated them,
+// for strings made by one thread and dropped by others, e.g. passed
+// through a queue: see detail::deferred_heap. Upstream shall be stateless.
+template <class T, class Upstream = std::allocator<char>>
+class deferred_allocator {
+  static_assert(std::is_empty<Upstream>::value,
+                "deferred_allocator takes a stateless upstream allocator");
+
+ public:
+  using value_type = T;
+  using pointer = T*;
+  using const_pointer = const T*;
+  using reference = T&;
+  using const_reference = const T&;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  template <class U>
+  struct rebind {
+    using other = deferred_allocator<U, Upstream>;
+  };
+
+  deferred_allocator() noexcept = default;
+  template <class U>
+  deferred_allocator(const deferred_allocator<U, Upstream>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "blocks are aligned as std::max_align_t");
+    return static_cast<T*>(detail::deferred_heap<Upstream>::allocate(
+        n * sizeof(T)));
+  }
+  void deallocate(T* p, std::size_t) noexcept {
+    detail::deferred_heap<Upstream>::deallocate(p);
+  }
+
+  // frees the blocks of this thread which other threads have dropped;
+  // allocations do it too, so only threads which stop allocating need it
+  static std::size_t flush() noexcept {
+    return detail::deferred_heap<Upstream>::flush();
+  }
+
+  template <class U>
+  bool operator==(const deferred_allocator<U, Upstream>&) const noexcept {
+    return true;
+  }
+  template <class U>
+  bool operator!=(const deferred_allocator<U, Upstream>&) const noexcept {
+    return false;
+  }
+};
+
+using deferred_string =
+    basic_string<char, std::char_traits<char>, deferred_allocator<char>>;
+using deferred_wstring =
+    basic_string<wchar_t, std::char_traits<wchar_t>,
+                 deferred_allocator<wchar_t>>;
+
+}  // namespace immutable_string
@@ -0,0 +1,429 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMMUTABLE_STRING_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define IMMUTABLE_STRING_AVX2 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define IMMUTABLE_STRING_NEON 1
+#include <arm_neon.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Inline functions of the kernels differ with the instruction set, so
+// they live in an inline namespace named after it: translation units
+// built with and without -mavx2 may be linked together, each calling
+// its own kernels
+#if defined(IMMUTABLE_STRING_AVX2)
+#define IMMUTABLE_STRING_ISA avx2
+#else
+#define IMMUTABLE_STRING_ISA baseline
+#endif
+
+namespace immutable_string {
+namespace detail {
+inline namespace IMMUTABLE_STRING_ISA {
+
+const std::size_t not_found = static_cast<std::size_t>(-1);
+
+// characters of std::char_traits<char>-like types are compared as bytes,
+// so they can be searched by SIMD kernels and memchr/memcmp
+template <class CharT, class Traits>
+struct is_byte_traits
+    : std::integral_constant<
+          bool, sizeof(CharT) == 1 &&
+                    std::is_same<Traits, std::char_traits<CharT>>::value> {};
+
+inline unsigned count_trailing_zeros(std::uint64_t x) noexcept {
+#if defined(_MSC_VER) && defined(_M_X64)
+  unsigned long res;
+  _BitScanForward64(&res, x);
+  return res;
+#elif defined(_MSC_VER)
+  unsigned long res;
+  if (_BitScanForward(&res, static_cast<unsigned long>(x))) return res;
+  _BitScanForward(&res, static_cast<unsigned long>(x >> 32));
+  return res + 32;
+#else
+  return __builtin_ctzll(x);
+#endif
+}
+
+inline unsigned last_set_bit(std::uint32_t x) noexcept {
+#if defined(_MSC_VER)
+  unsigned long res;
+  _BitScanReverse(&res, x);
+  return res;
+#else
+  return 31 - __builtin_clz(x);
+#endif
+}
+
+// needles longer than this are searched by Boyer-Moore-Horspool,
+// shorter ones by SIMD filtering of their first and last characters
+const std::size_t horspool_threshold = 32;
+
+// Boyer-Moore-Horspool shift table for byte strings
+struct horspool_table {
+  void init(const unsigned char* needle, std::size_t m) noexcept {
+    for (auto& shift : shifts) shift = m;
+    for (std::size_t i = 0; i + 1 < m; ++i) shifts[needle[i]] = m - 1 - i;
+  }
+
+  std::size_t shifts[UCHAR_MAX + 1];
+};
+
+inline std::size_t horspool_search(const unsigned char* hay, std::size_t n,
+                                   const unsigned char* needle, std::size_t m,
+                                   const horspool_table& table) noexcept {
+  const auto last = needle[m - 1];
+  for (std::size_t i = 0; i + m <= n;) {
+    const auto ch = hay[i + m - 1];
+    if (ch == last && std::memcmp(hay + i, needle, m - 1) == 0) return i;
+    i += table.shifts[ch];
+  }
+  return not_found;
+}
+
+// Checks candidate positions given by bits of mask, 1 << shift bits per byte
+// (NEON masks have 4 bits per byte, so shift is 2 there).
+// Returns the first position where the needle matches or not_found.
+inline std::size_t verify_candidates(std::uint64_t mask, unsigned shift,
+                                     const unsigned char* block,
+                                     const unsigned char* needle,
+                                     std::size_t m) noexcept {
+  while (mask != 0) {
+    const auto pos = count_trailing_zeros(mask) >> shift;
+    // first and last characters are known to match already
+    if (m <= 2 || std::memcmp(block + pos + 1, needle + 1, m - 2) == 0) {
+      return pos;
+    }
+    // clear all bits of the checked byte
+    const auto byte_bits = (std::uint64_t(1) << (1u << shift)) - 1;
+    mask &= ~(byte_bits << (pos << shift));
+  }
+  return not_found;
+}
+
+// Filters positions by the first and the last characters of the needle
+// a whole SIMD register at once. Returns the match position or not_found;
+// i is set to the position from which the scalar search shall continue.
+inline std::size_t simd_search(const unsigned char* hay, std::size_t n,
+                               const unsigned char* needle, std::size_t m,
+                               std::size_t& i) noexcept {
+  i = 0;
+#if defined(IMMUTABLE_STRING_AVX2)
+  {
+    const auto first = _mm256_set1_epi8(static_cast<char>(needle[0]));
+    const auto last = _mm256_set1_epi8(static_cast<char>(needle[m - 1]));
+    for (; i + m - 1 + 32 <= n; i += 32) {
+      const auto block_first = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(hay + i));
+      const auto block_last = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(hay + i + m - 1));
+      const auto eq = _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first),
+                                       _mm256_cmpeq_epi8(last, block_last));
+      const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(eq));
+      const auto pos = verify_candidates(mask, 0, hay + i, needle, m);
+      if (pos != not_found) return i + pos;
+    }
+  }
+#endif
+#if defined(IMMUTABLE_STRING_SSE2)
+  {
+    const auto first = _mm_set1_epi8(static_cast<char>(needle[0]));
+    const auto last = _mm_set1_epi8(static_cast<char>(needle[m - 1]));
+    for (; i + m - 1 + 16 <= n; i += 16) {
+      const auto block_first =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i));
+      const auto block_last =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i + m - 1));
+      const auto eq = _mm_and_si128(_mm_cmpeq_epi8(first, block_first),
+                                    _mm_cmpeq_epi8(last, block_last));
+      const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(eq));
+      const auto pos = verify_candidates(mask, 0, hay + i, needle, m);
+      if (pos != not_found) return i + pos;
+    }
+  }
+#elif defined(IMMUTABLE_STRING_NEON)
+  {
+    const auto first = vdupq_n_u8(needle[0]);
+    const auto last = vdupq_n_u8(needle[m - 1]);
+    for (; i + m - 1 + 16 <= n; i += 16) {
+      const auto eq = vandq_u8(vceqq_u8(first, vld1q_u8(hay + i)),
+                               vceqq_u8(last, vld1q_u8(hay + i + m - 1)));
+      // narrowing shift leaves 4 bits per byte in a 64-bit mask
+      const auto nibbles = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+      const auto mask = vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+      const auto pos = verify_candidates(mask, 2, hay + i, needle, m);
+      if (pos != not_found) return i + pos;
+    }
+  }
+#endif
+  return not_found;
+}
+
+// Preprocessed needle of bytes: the search engine is chosen by its length.
+// The needle itself isn't stored, so the searcher can be copied freely.
+class byte_searcher {
+ public:
+  byte_searcher(const unsigned char* needle, std::size_t m) noexcept
+      : m_size(m) {
+    // the table is used (and filled) for long needles only
+    if (m > horspool_threshold) m_table.init(needle, m);
+  }
+
+  // returns the position of the first occurrence of needle or not_found
+  std::size_t find(const unsigned char* hay, std::size_t n,
+                   const unsigned char* needle) const noexcept {
+    const auto m = m_size;
+    if (m == 0) return 0;
+    if (m > n) return not_found;
+    if (m == 1) {
+      const auto res = std::memchr(hay, needle[0], n);
+      return res ? static_cast<const unsigned char*>(res) - hay : not_found;
+    }
+    if (m > horspool_threshold) {
+      return horspool_search(hay, n, needle, m, m_table);
+    }
+
+    std::size_t i;
+    const auto res = simd_search(hay, n, needle, m, i);
+    if (res != not_found) return res;
+    // the tail which is shorter than a SIMD block
+    for (; i + m <= n; ++i) {
+      const auto first = std::memchr(hay + i, needle[0], n - m + 1 - i);
+      if (!first) break;
+      i = static_cast<const unsigned char*>(first) - hay;
+      if (std::memcmp(hay + i + 1, needle + 1, m - 1) == 0) return i;
+    }
+    return not_found;
+  }
+
+ private:
+  std::size_t m_size;
+  horspool_table m_table;
+};
+
+// Returns the position of the first occurrence of needle in haystack
+// or not_found.
+template <class CharT, class Traits>
+std::size_t search(const CharT* hay, std::size_t n, const CharT* needle,
+                   std::size_t m, std::true_type /* byte traits */) noexcept {
+  const auto nd = reinterpret_cast<const unsigned char*>(needle);
+  return byte_searcher{nd, m}.find(
+      reinterpret_cast<const unsigned char*>(hay), n, nd);
+}
+
+template <class CharT, class Traits>
+std::size_t search(const CharT* hay, std::size_t n, const CharT* needle,
+                   std::size_t m, std::false_type /* byte traits */) {
+  for (std::size_t i = 0; i + m <= n; ++i) {
+    const auto first = Traits::find(hay + i, n - m + 1 - i, needle[0]);
+    if (!first) break;
+    i = first - hay;
+    if (Traits::compare(hay + i + 1, needle + 1, m - 1) == 0) return i;
+  }
+  return not_found;
+}
+
+template <class CharT, class Traits>
+std::size_t search(const CharT* hay, std::size_t n, const CharT* needle,
+                   std::size_t m) {
+  if (m == 0) return 0;
+  if (m > n) return not_found;
+  return search<CharT, Traits>(hay, n, needle, m,
+                               is_byte_traits<CharT, Traits>{});
+}
+
+// Returns the position of the last occurrence of needle which starts
+// at or before pos or not_found; m shall be at most n.
+template <class CharT, class Traits>
+std::size_t rsearch(const CharT* hay, std::size_t n, const CharT* needle,
+                    std::size_t m, std::size_t pos) noexcept {
+  if (m == 0) return std::min(pos, n);
+  for (auto i = std::min(pos, n - m) + 1; i-- > 0;) {
+    // the last characters are checked first, they differ more often
+    // in strings with common prefixes
+    if (Traits::eq(hay[i + m - 1], needle[m - 1]) &&
+        Traits::compare(hay + i, needle, m - 1) == 0) {
+      return i;
+    }
+  }
+  return not_found;
+}
+
+// Set of bytes for find_first_of and the like: a bit per byte value.
+// AVX2 classifies 32 bytes at once by nibble lookups: the low nibble of a
+// byte selects a mask of the high nibbles which are in the set with it.
+class byte_set {
+ public:
+  byte_set(const unsigned char* s, std::size_t count) noexcept {
+    for (std::size_t i = 0; i < count; ++i) {
+      const auto ch = s[i];
+      m_bits[ch >> 3] |= static_cast<unsigned char>(1u << (ch & 7));
+      m_nibbles[ch >> 7][ch & 15] |=
+          static_cast<unsigned char>(1u << ((ch >> 4) & 7));
+    }
+  }
+
+  bool contains(unsigned char ch) const noexcept {
+    return (m_bits[ch >> 3] >> (ch & 7)) & 1;
+  }
+
+  // position of the first byte which is in the set (or isn't, if !in)
+  std::size_t find(const unsigned char* hay, std::size_t n,
+                   bool in) const noexcept;
+  // position of the last such byte
+  std::size_t rfind(const unsigned char* hay, std::size_t n,
+                    bool in) const noexcept;
+
+ private:
+#if defined(IMMUTABLE_STRING_AVX2)
+  struct simd_tables {
+    __m256i low[2];
+    __m256i high_bit;
+  };
+
+  simd_tables _tables() const noexcept;
+  // bit per byte of the block which is in the set
+  static std::uint32_t _mask(const simd_tables& tables,
+                             const unsigned char* block) noexcept;
+#endif
+
+  // kept without AVX2 too, so the layout doesn't depend on it;
+  // low nibble -> bits of the high nibbles 0-7 and 8-15 in the set
+  unsigned char m_nibbles[2][16] = {};
+  unsigned char m_bits[32] = {};
+};
+
+#if defined(IMMUTABLE_STRING_AVX2)
+inline byte_set::simd_tables byte_set::_tables() const noexcept {
+  const auto load = [](const unsigned char* table) {
+    return _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(table)));
+  };
+  return {{load(m_nibbles[0]), load(m_nibbles[1])},
+          _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32,
+                           64, -128, 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8,
+                           16, 32, 64, -128)};
+}
+
+inline std::uint32_t byte_set::_mask(const simd_tables& tables,
+                                     const unsigned char* block) noexcept {
+  const auto nibble = _mm256_set1_epi8(0x0f);
+  const auto bytes =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+  const auto low = _mm256_and_si256(bytes, nibble);
+  const auto high = _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble);
+  const auto upper_half = _mm256_cmpgt_epi8(high, _mm256_set1_epi8(7));
+  const auto row = _mm256_blendv_epi8(_mm256_shuffle_epi8(tables.low[0], low),
+                                      _mm256_shuffle_epi8(tables.low[1], low),
+                                      upper_half);
+  const auto bit = _mm256_shuffle_epi8(tables.high_bit, high);
+  const auto absent = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit),
+                                        _mm256_setzero_si256());
+  return ~static_cast<std::uint32_t>(_mm256_movemask_epi8(absent));
+}
+#endif
+
+inline std::size_t byte_set::find(const unsigned char* hay, std::size_t n,
+                                  bool in) const noexcept {
+  std::size_t i = 0;
+#if defined(IMMUTABLE_STRING_AVX2)
+  if (n >= 32) {
+    const auto tables = _tables();
+    for (; i + 32 <= n; i += 32) {
+      auto mask = _mask(tables, hay + i);
+      if (!in) mask = ~mask;
+      if (mask != 0) return i + count_trailing_zeros(mask);
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    if (contains(hay[i]) == in) return i;
+  }
+  return not_found;
+}
+
+inline std::size_t byte_set::rfind(const unsigned char* hay, std::size_t n,
+                                   bool in) const noexcept {
+  auto i = n;
+#if defined(IMMUTABLE_STRING_AVX2)
+  if (n >= 32) {
+    const auto tables = _tables();
+    for (; i >= 32; i -= 32) {
+      auto mask = _mask(tables, hay + i - 32);
+      if (!in) mask = ~mask;
+      if (mask != 0) return i - 32 + last_set_bit(mask);
+    }
+  }
+#endif
+  while (i-- > 0) {
+    if (contains(hay[i]) == in) return i;
+  }
+  return not_found;
+}
+
+// Returns the position of the first character of hay which is in the set
+// of m characters (or isn't, if !in) or not_found.
+template <class CharT, class Traits>
+std::size_t find_of(const CharT* hay, std::size_t n, const CharT* set,
+                    std::size_t m, bool in,
+                    std::true_type /* byte traits */) noexcept {
+  const auto bytes = reinterpret_cast<const unsigned char*>(hay);
+  if (in && m == 1) {
+    const auto res = std::memchr(bytes, set[0], n);
+    return res ? static_cast<const unsigned char*>(res) - bytes : not_found;
+  }
+  return byte_set{reinterpret_cast<const unsigned char*>(set), m}.find(
+      bytes, n, in);
+}
+
+template <class CharT, class Traits>
+std::size_t find_of(const CharT* hay, std::size_t n, const CharT* set,
+                    std::size_t m, bool in,
+                    std::false_type /* byte traits */) noexcept {
+  for (std::size_t i = 0; i < n; ++i) {
+    if ((Traits::find(set, m, hay[i]) != nullptr) == in) return i;
+  }
+  return not_found;
+}
+
+// the same for the last such character
+template <class CharT, class Traits>
+std::size_t rfind_of(const CharT* hay, std::size_t n, const CharT* set,
+                     std::size_t m, bool in,
+                     std::true_type /* byte traits */) noexcept {
+  return byte_set{reinterpret_cast<const unsigned char*>(set), m}.rfind(
+      reinterpret_cast<const unsigned char*>(hay), n, in);
+}
+
+template <class CharT, class Traits>
+std::size_t rfind_of(const CharT* hay, std::size_t n, const CharT* set,
+                     std::size_t m, bool in,
+                     std::false_type /* byte traits */) noexcept {
+  for (auto i = n; i-- > 0;) {
+    if ((Traits::find(set, m, hay[i]) != nullptr) == in) return i;
+  }
+  return not_found;
+}
+
+}  // namespace IMMUTABLE_STRING_ISA
+}  // namespace detail
+}  // namespace immutable_string
@@ -0,0 +1,586 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "immutable_string/string.hpp"
+
+namespace immutable_string {
+
+namespace detail {
+
+// Open addressing table with linear probing for basic_string keys. Slots
+// hold the hash of the key next to the element, so probes compare hashes
+// without touching the elements; keys are handles, whose size and short
+// characters are right in the slot as well. Erasure shifts the following
+// elements back, so there are no tombstones.
+template <class String, class Value, class KeyOf, class Allocator>
+class flat_table {
+ public:
+  using key_type = String;
+  using value_type = Value;
+  using size_type = std::size_t;
+  using char_type = typename String::value_type;
+  using traits_type = typename String::traits_type;
+
+  static const size_type npos = static_cast<size_type>(-1);
+
+  struct slot {
+    std::size_t hash;  // 0 for empty slots
+    typename std::aligned_storage<sizeof(Value), alignof(Value)>::type mem;
+
+    bool empty() const noexcept { return hash == 0; }
+    Value& value() noexcept { return *reinterpret_cast<Value*>(&mem); }
+    const Value& value() const noexcept {
+      return *reinterpret_cast<const Value*>(&mem);
+    }
+  };
+
+  // ways to look a key up: by a string or by characters
+  struct string_probe {
+    bool equals(const String& key) const noexcept { return key == str; }
+    const String& str;
+    std::size_t hash;
+  };
+  struct chars_probe {
+    bool equals(const String& key) const noexcept {
+      return key.size() == count && key.compare(0, count, s, count) == 0;
+    }
+    const char_type* s;
+    size_type count;
+    std::size_t hash;
+  };
+
+  static string_probe probe(const String& str) noexcept {
+    return {str, _tag(str.hash())};
+  }
+  static chars_probe probe(const char_type* s) noexcept {
+    return probe(s, traits_type::length(s));
+  }
+  static chars_probe probe(const char_type* s, size_type count) noexcept {
+    return {s, count, _tag(static_cast<std::size_t>(hash_chars(s, count)))};
+  }
+#if defined(IMMUTABLE_STRING_STRING_VIEW)
+  static chars_probe probe(
+      std::basic_string_view<char_type, traits_type> sv) noexcept {
+    return probe(sv.data(), sv.size());
+  }
+#endif
+
+  explicit flat_table(const Allocator& alloc) noexcept : m_alloc(alloc) {}
+  flat_table(const flat_table& other);
+  flat_table(flat_table&& other) noexcept
+      : m_slots(other.m_slots),
+        m_capacity(other.m_capacity),
+        m_size(other.m_size),
+        m_alloc(std::move(other.m_alloc)) {
+    other.m_slots = nullptr;
+    other.m_capacity = 0;
+    other.m_size = 0;
+  }
+  ~flat_table() { _free(); }
+
+  void swap(flat_table& other) noexcept {
+    using std::swap;
+    swap(m_slots, other.m_slots);
+    swap(m_capacity, other.m_capacity);
+    swap(m_size, other.m_size);
+    swap(m_alloc, other.m_alloc);
+  }
+
+  slot* slots() const noexcept { return m_slots; }
+  size_type size() const noexcept { return m_size; }
+  size_type capacity() const noexcept { return m_capacity; }
+
+  void reserve(size_type count);
+  void clear() noexcept;
+
+  template <class Probe>
+  size_type find(const Probe& probe) const noexcept;
+  // make(void* mem) constructs the element if the key isn't found;
+  // returns its index and whether it was inserted
+  template <class Probe, class Make>
+  std::pair<size_type, bool> insert(const Probe& probe, const Make& make);
+  void erase(size_type index) noexcept;
+
+ private:
+  using alloc_type =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<slot>;
+  using alloc_traits = std::allocator_traits<alloc_type>;
+
+  // hashes are never 0, but truncated to 32 bits they may be
+  static std::size_t _tag(std::size_t hash) noexcept {
+    return hash != 0 ? hash : 1;
+  }
+  // up to 3/4 of the slots are used
+  static bool _fits(size_type count, size_type capacity) noexcept {
+    return count <= capacity / 4 * 3;
+  }
+  void _rehash(size_type capacity);
+  void _free() noexcept;
+
+  slot* m_slots = nullptr;
+  size_type m_capacity = 0;  // 0 or a power of 2
+  size_type m_size = 0;
+  alloc_type m_alloc;
+};
+
+template <class String, class Value, class KeyOf, class Allocator>
+const typename flat_table<String, Value, KeyOf, Allocator>::size_type
+    flat_table<String, Value, KeyOf, Allocator>::npos;
+
+template <class String, class Value, class KeyOf, class Allocator>
+flat_table<String, Value, KeyOf, Allocator>::flat_table(
+    const flat_table& other)
+    : m_alloc(alloc_traits::select_on_container_copy_construction(
+          other.m_alloc)) {
+  if (other.m_size == 0) return;
+  m_slots = alloc_traits::allocate(m_alloc, other.m_capacity);
+  m_capacity = other.m_capacity;
+  for (size_type i = 0; i < m_capacity; ++i) m_slots[i].hash = 0;
+  try {
+    for (size_type i = 0; i < m_capacity; ++i) {
+      if (other.m_slots[i].empty()) continue;
+      new (&m_slots[i].mem) Value(other.m_slots[i].value());
+      m_slots[i].hash = other.m_slots[i].hash;
+      ++m_size;
+    }
+  } catch (...) {
+    _free();
+    throw;
+  }
+}
+
+template <class String, class Value, class KeyOf, class Allocator>
+void flat_table<String, Value, KeyOf, Allocator>::reserve(size_type count) {
+  if (_fits(count, m_capacity)) return;
+  size_type capacity = 16;
+  while (!_fits(count, capacity)) capacity *= 2;
+  _rehash(capacity);
+}
+
+template <class String, class Value, class KeyOf, class Allocator>
+void flat_table<String, Value, KeyOf, Allocator>::clear() noexcept {
+  for (size_type i = 0; i < m_capacity; ++i) {
+    if (m_slots[i].empty()) continue;
+    m_slots[i].value().~Value();
+    m_slots[i].hash = 0;
+  }
+  m_size = 0;
+}
+
+template <class String, class Value, class KeyOf, class Allocator>
+template <class Probe>
+typename flat_table<String, Value, KeyOf, Allocator>::size_type
+flat_table<String, Value, KeyOf, Allocator>::find(
+    const Probe& probe) const noexcept {
+  if (m_size == 0) return npos;
+  const auto mask = m_capacity - 1;
+  for (auto i = probe.hash & mask;; i = (i + 1) & mask) {
+    const auto& slot = m_slots[i];
+    if (slot.empty()) return npos;
+    if (slot.hash == probe.hash && probe.equals(KeyOf::get(slot.value()))) {
+      return i;
+    }
+  }
+}
+
+template <class String, class Value, class KeyOf, class Allocator>
+template <class Probe, class Make>
+std::pair<typename flat_table<String, Value, KeyOf, Allocator>::size_type,
+          bool>
+flat_table<String, Value, KeyOf, Allocator>::insert(const Probe& probe,
+                                                    const Make& make) {
+  const auto found = find(probe);
+  if (found != npos) return {found, false};
+  if (!_fits(m_size + 1, m_capacity)) reserve(m_size + 1);
+  const auto mask = m_capacity - 1;
+  auto i = probe.hash & mask;
+  while (!m_slots[i].empty()) i = (i + 1) & mask;
+  make(static_cast<void*>(&m_slots[i].mem));
+  m_slots[i].hash = probe.hash;
+  ++m_size;
+  return {i, true};
+}
+
+template <class String, class Value, class KeyOf, class Allocator>
+void flat_table<String, Value, KeyOf, Allocator>::erase(
+    size_type index) noexcept {
+  const auto mask = m_capacity - 1;
+  m_slots[index].value().~Value();
+  m_slots[index].hash = 0;
+  --m_size;
+  // elements after the hole move back if their home is not between
+  // the hole and them
+  auto hole = index;
+  for (auto i = (index + 1) & mask; !m_slots[i].empty(); i = (i + 1) & mask) {
+    const auto home = m_slots[i].hash & mask;
+    if (((i - home) & mask) < ((i - hole) & mask)) continue;
+    new (&m_slots[hole].mem) Value(std::move(m_slots[i].value()));
+    m_slots[hole].hash = m_slots[i].hash;
+    m_slots[i].value().~Value();
+    m_slots[i].hash = 0;
+    hole = i;
+  }
+}
+
+template <class String, class Value, class KeyOf, class Allocator>
+void flat_table<String, Value, KeyOf, Allocator>::_rehash(size_type capacity) {
+  const auto slots = alloc_traits::allocate(m_alloc, capacity);
+  for (size_type i = 0; i < capacity; ++i) slots[i].hash = 0;
+  const auto mask = capacity - 1;
+  for (size_type i = 0; i < m_capacity; ++i) {
+    auto& old = m_slots[i];
+    if (old.empty()) continue;
+    auto j = old.hash & mask;
+    while (!slots[j].empty()) j = (j + 1) & mask;
+    new (&slots[j].mem) Value(std::move(old.value()));
+    slots[j].hash = old.hash;
+    old.value().~Value();
+  }
+  if (m_slots) alloc_traits::deallocate(m_alloc, m_slots, m_capacity);
+  m_slots = slots;
+  m_capacity = capacity;
+}
+
+template <class String, class Value, class KeyOf, class Allocator>
+void flat_table<String, Value, KeyOf, Allocator>::_free() noexcept {
+  if (!m_slots) return;
+  clear();
+  alloc_traits::deallocate(m_alloc, m_slots, m_capacity);
+  m_slots = nullptr;
+  m_capacity = 0;
+}
+
+// forward iterator over the used slots
+template <class Slot, class Value>
+class flat_iterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = typename std::remove_const<Value>::type;
+  using difference_type = std::ptrdiff_t;
+  using pointer = Value*;
+  using reference = Value&;
+
+  flat_iterator() noexcept = default;
+  flat_iterator(Slot* pos, Slot* end) noexcept : m_pos(pos), m_end(end) {
+    _skip_empty();
+  }
+  // iterator converts to const_iterator
+  template <class OtherSlot, class OtherValue,
+            class = typename std::enable_if<
+                std::is_convertible<OtherSlot*, Slot*>::value>::type>
+  flat_iterator(const flat_iterator<OtherSlot, OtherValue>& other) noexcept
+      : m_pos(other.m_pos), m_end(other.m_end) {}
+
+  reference operator*() const noexcept { return m_pos->value(); }
+  pointer operator->() const noexcept { return &m_pos->value(); }
+
+  flat_iterator& operator++() noexcept {
+    ++m_pos;
+    _skip_empty();
+    return *this;
+  }
+  flat_iterator operator++(int) noexcept {
+    auto res = *this;
+    ++*this;
+    return res;
+  }
+
+  Slot* slot() const noexcept { return m_pos; }
+
+  bool operator==(const flat_iterator& other) const noexcept {
+    return m_pos == other.m_pos;
+  }
+  bool operator!=(const flat_iterator& other) const noexcept {
+    return m_pos != other.m_pos;
+  }
+
+ private:
+  template <class, class>
+  friend class flat_iterator;
+
+  void _skip_empty() noexcept {
+    while (m_pos != m_end && m_pos->empty()) ++m_pos;
+  }
+
+  Slot* m_pos = nullptr;
+  Slot* m_end = nullptr;
+};
+
+}  // namespace detail
+
+// Hash map with basic_string keys, stored in one array of slots instead of
+// a node per element. Keys are looked up as strings, null-terminated
+// strings or string_views; no string is made for them. Insertion and
+// erasure invalidate iterators and references.
+template <class T, class String = string,
+          class Allocator = std::allocator<std::pair<const String, T>>>
+class string_map {
+ public:
+  using key_type = String;
+  using mapped_type = T;
+  using value_type = std::pair<const String, T>;
+  using size_type = std::size_t;
+  using allocator_type = Allocator;
+  using char_type = typename String::value_type;
+
+ private:
+  struct key_of {
+    static const String& get(const value_type& value) noexcept {
+      return value.first;
+    }
+  };
+  using table_type = detail::flat_table<String, value_type, key_of, Allocator>;
+  using slot = typename table_type::slot;
+
+ public:
+  using iterator = detail::flat_iterator<slot, value_type>;
+  using const_iterator = detail::flat_iterator<const slot, const value_type>;
+
+  explicit string_map(const Allocator& alloc = Allocator()) noexcept
+      : m_table(alloc) {}
+  string_map(std::initializer_list<value_type> init,
+             const Allocator& alloc = Allocator())
+      : m_table(alloc) {
+    reserve(init.size());
+    for (const auto& value : init) insert(value);
+  }
+
+  string_map(const string_map&) = default;
+  string_map(string_map&&) noexcept = default;
+  string_map& operator=(string_map other) noexcept {
+    swap(other);
+    return *this;
+  }
+  void swap(string_map& other) noexcept { m_table.swap(other.m_table); }
+
+  iterator begin() noexcept { return _iter(0); }
+  iterator end() noexcept { return _iter(m_table.capacity()); }
+  const_iterator begin() const noexcept { return _iter(0); }
+  const_iterator end() const noexcept { return _iter(m_table.capacity()); }
+  const_iterator cbegin() const noexcept { return begin(); }
+  const_iterator cend() const noexcept { return end(); }
+
+  bool empty() const noexcept { return size() == 0; }
+  size_type size() const noexcept { return m_table.size(); }
+  // number of slots, up to 3/4 of them are used
+  size_type capacity() const noexcept { return m_table.capacity(); }
+  // makes room for count elements without rehashing
+  void reserve(size_type count) { m_table.reserve(count); }
+  void clear() noexcept { m_table.clear(); }
+
+  // key is a String, const CharT* or string_view; a String is made of it
+  // only if it is inserted
+  template <class K, class... Args>
+  std::pair<iterator, bool> try_emplace(K&& key, Args&&... args);
+  std::pair<iterator, bool> insert(const value_type& value) {
+    return try_emplace(value.first, value.second);
+  }
+  std::pair<iterator, bool> insert(value_type&& value) {
+    return try_emplace(value.first, std::move(value.second));
+  }
+  template <class K, class M>
+  std::pair<iterator, bool> insert_or_assign(K&& key, M&& obj) {
+    auto res = try_emplace(std::forward<K>(key), std::forward<M>(obj));
+    if (!res.second) res.first->second = std::forward<M>(obj);
+    return res;
+  }
+  template <class K>
+  T& operator[](K&& key) {
+    return try_emplace(std::forward<K>(key)).first->second;
+  }
+
+  template <class K>
+  iterator find(const K& key) noexcept {
+    return _iter(_find(key));
+  }
+  template <class K>
+  const_iterator find(const K& key) const noexcept {
+    return _iter(_find(key));
+  }
+  template <class K>
+  size_type count(const K& key) const noexcept {
+    return _find(key) != table_type::npos ? 1 : 0;
+  }
+  template <class K>
+  T& at(const K& key) {
+    return const_cast<T&>(static_cast<const string_map&>(*this).at(key));
+  }
+  template <class K>
+  const T& at(const K& key) const;
+
+  template <class K>
+  size_type erase(const K& key) noexcept;
+  void erase(const_iterator pos) noexcept {
+    m_table.erase(static_cast<size_type>(pos.slot() - m_table.slots()));
+  }
+  void erase(iterator pos) noexcept { erase(const_iterator{pos}); }
+
+ private:
+  template <class K>
+  size_type _find(const K& key) const noexcept {
+    return m_table.find(table_type::probe(key));
+  }
+  iterator _iter(size_type index) noexcept {
+    return {m_table.slots() + std::min(index, m_table.capacity()),
+            m_table.slots() + m_table.capacity()};
+  }
+  const_iterator _iter(size_type index) const noexcept {
+    return {m_table.slots() + std::min(index, m_table.capacity()),
+            m_table.slots() + m_table.capacity()};
+  }
+
+  table_type m_table;
+};
+
+// Hash set of basic_strings in one array of slots, for hash-consing:
+// intern() returns the string stored for equal characters, so equal
+// strings share one buffer. Unlike basic_intern_pool it is a plain
+// container, not synchronized and not weak: it keeps its strings alive.
+template <class String = string, class Allocator = std::allocator<String>>
+class string_set {
+ public:
+  using key_type = String;
+  using value_type = String;
+  using size_type = std::size_t;
+  using allocator_type = Allocator;
+  using char_type = typename String::value_type;
+
+ private:
+  struct key_of {
+    static const String& get(const String& value) noexcept { return value; }
+  };
+  using table_type = detail::flat_table<String, String, key_of, Allocator>;
+  using slot = typename table_type::slot;
+
+ public:
+  using iterator = detail::flat_iterator<const slot, const String>;
+  using const_iterator = iterator;
+
+  explicit string_set(const Allocator& alloc = Allocator()) noexcept
+      : m_table(alloc) {}
+  string_set(std::initializer_list<String> init,
+             const Allocator& alloc = Allocator())
+      : m_table(alloc) {
+    reserve(init.size());
+    for (const auto& str : init) insert(str);
+  }
+
+  string_set(const string_set&) = default;
+  string_set(string_set&&) noexcept = default;
+  string_set& operator=(string_set other) noexcept {
+    swap(other);
+    return *this;
+  }
+  void swap(string_set& other) noexcept { m_table.swap(other.m_table); }
+
+  iterator begin() const noexcept { return _iter(0); }
+  iterator end() const noexcept { return _iter(m_table.capacity()); }
+  iterator cbegin() const noexcept { return begin(); }
+  iterator cend() const noexcept { return end(); }
+
+  bool empty() const noexcept { return size() == 0; }
+  size_type size() const noexcept { return m_table.size(); }
+  // number of slots, up to 3/4 of them are used
+  size_type capacity() const noexcept { return m_table.capacity(); }
+  // makes room for count strings without rehashing
+  void reserve(size_type count) { m_table.reserve(count); }
+  void clear() noexcept { m_table.clear(); }
+
+  // key is a String, const CharT* or string_view; a String is made of it
+  // only if it is inserted
+  template <class K>
+  std::pair<iterator, bool> insert(K&& key);
+  // the stored string equal to key, inserted if there is none
+  template <class K>
+  const String& intern(K&& key) {
+    return *insert(std::forward<K>(key)).first;
+  }
+
+  template <class K>
+  iterator find(const K& key) const noexcept {
+    return _iter(m_table.find(table_type::probe(key)));
+  }
+  template <class K>
+  size_type count(const K& key) const noexcept {
+    return m_table.find(table_type::probe(key)) != table_type::npos ? 1 : 0;
+  }
+
+  template <class K>
+  size_type erase(const K& key) noexcept;
+  void erase(iterator pos) noexcept {
+    m_table.erase(static_cast<size_type>(pos.slot() - m_table.slots()));
+  }
+
+ private:
+  iterator _iter(size_type index) const noexcept {
+    return {m_table.slots() + std::min(index, m_table.capacity()),
+            m_table.slots() + m_table.capacity()};
+  }
+
+  table_type m_table;
+};
+
+template <class T, class String, class Allocator>
+template <class K, class... Args>
+std::pair<typename string_map<T, String, Allocator>::iterator, bool>
+string_map<T, String, Allocator>::try_emplace(K&& key, Args&&... args) {
+  // the probe refers to key, which is moved only after the lookup
+  const auto res =
+      m_table.insert(table_type::probe(key), [&](void* mem) {
+        new (mem) value_type(std::piecewise_construct,
+                             std::forward_as_tuple(std::forward<K>(key)),
+                             std::forward_as_tuple(std::forward<Args>(args)...));
+      });
+  return {_iter(res.first), res.second};
+}
+
+template <class T, class String, class Allocator>
+template <class K>
+const T& string_map<T, String, Allocator>::at(const K& key) const {
+  const auto index = _find(key);
+  if (index == table_type::npos) throw std::out_of_range("string_map::at");
+  return m_table.slots()[index].value().second;
+}
+
+template <class T, class String, class Allocator>
+template <class K>
+typename string_map<T, String, Allocator>::size_type
+string_map<T, String, Allocator>::erase(const K& key) noexcept {
+  const auto index = _find(key);
+  if (index == table_type::npos) return 0;
+  m_table.erase(index);
+  return 1;
+}
+
+template <class String, class Allocator>
+template <class K>
+std::pair<typename string_set<String, Allocator>::iterator, bool>
+string_set<String, Allocator>::insert(K&& key) {
+  // the probe refers to key, which is moved only after the lookup
+  const auto res = m_table.insert(table_type::probe(key), [&](void* mem) {
+    new (mem) String(std::forward<K>(key));
+  });
+  return {_iter(res.first), res.second};
+}
+
+template <class String, class Allocator>
+template <class K>
+typename string_set<String, Allocator>::size_type
+string_set<String, Allocator>::erase(const K& key) noexcept {
+  const auto index = m_table.find(table_type::probe(key));
+  if (index == table_type::npos) return 0;
+  m_table.erase(index);
+  return 1;
+}
+
+}  // namespace immutable_string
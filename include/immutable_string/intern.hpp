@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include "immutable_string/string.hpp"
+
+namespace immutable_string {
+
+// Process-wide set of canonical strings: interning equal strings returns
+// copies of one buffer, so they take memory once and compare in O(1).
+// Strings with a thread-unsafe refcount policy get a pool per thread.
+// Short strings are stored inline and are returned as is.
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class Allocator = std::allocator<CharT>,
+          class RefCount = atomic_refcount>
+class basic_intern_pool {
+ public:
+  using string_type = basic_string<CharT, Traits, Allocator, RefCount>;
+  using size_type = typename string_type::size_type;
+
+  static_assert(std::is_same<Traits, std::char_traits<CharT>>::value,
+                "interned strings are hashed and compared bitwise");
+
+  basic_intern_pool(const basic_intern_pool&) = delete;
+  basic_intern_pool& operator=(const basic_intern_pool&) = delete;
+
+  static basic_intern_pool& global() {
+    return _global(std::integral_constant<bool, RefCount::is_thread_safe>{});
+  }
+
+  // a whole (not sliced) str becomes canonical itself if not interned yet,
+  // otherwise characters of a new canonical string are copied using alloc
+  string_type intern(const string_type& str,
+                     const Allocator& alloc = Allocator());
+  string_type intern(const CharT* s, size_type count,
+                     const Allocator& alloc = Allocator());
+
+  // number of interned strings
+  size_type size() const;
+
+ private:
+  static const std::size_t shard_count = 64;
+
+  struct entry {
+    std::size_t hash;
+    string_type str;  // empty for free slots
+  };
+
+  struct shard {
+    template <class Make>
+    string_type find_or_insert(std::size_t hash, const CharT* s,
+                               size_type len, const Make& make);
+    void grow();
+
+    mutable std::mutex mutex;
+    std::vector<entry> slots;
+    size_type used = 0;
+  };
+
+  basic_intern_pool() = default;
+
+  static basic_intern_pool& _global(std::true_type) {
+    static basic_intern_pool pool;
+    return pool;
+  }
+  static basic_intern_pool& _global(std::false_type) {
+    static thread_local basic_intern_pool pool;
+    return pool;
+  }
+
+  shard& _shard(std::size_t hash) noexcept {
+    // slots are chosen by low bits, so shards take high ones
+    return m_shards[(hash >> (8 * sizeof(hash) - 6)) % shard_count];
+  }
+
+  static string_type _make_canonical(string_type str) noexcept {
+    using rep_type = detail::rep_base<RefCount>;
+    str.m_storage.heap.rep->set_flag(rep_type::interned_flag);
+    return str;
+  }
+
+  shard m_shards[shard_count];
+};
+
+using intern_pool = basic_intern_pool<char>;
+using wintern_pool = basic_intern_pool<wchar_t>;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount> intern(
+    const basic_string<CharT, Traits, Allocator, RefCount>& str,
+    const Allocator& alloc = Allocator()) {
+  using pool_type = basic_intern_pool<CharT, Traits, Allocator, RefCount>;
+  return pool_type::global().intern(str, alloc);
+}
+
+template <class CharT>
+basic_string<CharT> intern(const CharT* s, std::size_t count) {
+  return basic_intern_pool<CharT>::global().intern(s, count);
+}
+
+template <class CharT>
+basic_string<CharT> intern(const CharT* s) {
+  return intern(s, std::char_traits<CharT>::length(s));
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+const std::size_t
+    basic_intern_pool<CharT, Traits, Allocator, RefCount>::shard_count;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_intern_pool<CharT, Traits, Allocator, RefCount>::string_type
+basic_intern_pool<CharT, Traits, Allocator, RefCount>::intern(
+    const string_type& str, const Allocator& alloc) {
+  if (str.size() <= string_type::inline_capacity || str.is_interned()) {
+    return str;
+  }
+  const auto hash = str.hash();
+  const auto make = [&str, &alloc] {
+    // a concatenation isn't adopted: its node keeps both pieces alive
+    if (str._is_whole() && !str._is_lazy()) return _make_canonical(str);
+    return _make_canonical(string_type{str.data(), str.size(), alloc});
+  };
+  return _shard(hash).find_or_insert(hash, str.data(), str.size(), make);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_intern_pool<CharT, Traits, Allocator, RefCount>::string_type
+basic_intern_pool<CharT, Traits, Allocator, RefCount>::intern(
+    const CharT* s, size_type count, const Allocator& alloc) {
+  if (count <= string_type::inline_capacity) return string_type{s, count};
+  const auto hash = static_cast<std::size_t>(detail::hash_chars(s, count));
+  return _shard(hash).find_or_insert(hash, s, count, [s, count, &alloc] {
+    return _make_canonical(string_type{s, count, alloc});
+  });
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_intern_pool<CharT, Traits, Allocator, RefCount>::size_type
+basic_intern_pool<CharT, Traits, Allocator, RefCount>::size() const {
+  size_type res = 0;
+  for (const auto& shard : m_shards) {
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    res += shard.used;
+  }
+  return res;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class Make>
+typename basic_intern_pool<CharT, Traits, Allocator, RefCount>::string_type
+basic_intern_pool<CharT, Traits, Allocator, RefCount>::shard::find_or_insert(
+    std::size_t hash, const CharT* s, size_type len, const Make& make) {
+  std::lock_guard<std::mutex> lock{mutex};
+  // keep load factor under 1/2, so probe sequences stay short
+  if (2 * (used + 1) > slots.size()) grow();
+
+  const auto mask = slots.size() - 1;
+  for (auto i = hash & mask;; i = (i + 1) & mask) {
+    auto& slot = slots[i];
+    if (slot.str.empty()) {
+      slot.str = make();
+      slot.hash = hash;
+      ++used;
+      return slot.str;
+    }
+    if (slot.hash == hash && slot.str.size() == len &&
+        Traits::compare(slot.str.data(), s, len) == 0) {
+      return slot.str;
+    }
+  }
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_intern_pool<CharT, Traits, Allocator, RefCount>::shard::grow() {
+  std::vector<entry> old(slots.empty() ? 16 : 2 * slots.size());
+  old.swap(slots);
+
+  const auto mask = slots.size() - 1;
+  for (auto& slot : old) {
+    if (slot.str.empty()) continue;
+    auto i = slot.hash & mask;
+    while (!slots[i].str.empty()) i = (i + 1) & mask;
+    slots[i] = std::move(slot);
+  }
+}
+
+}  // namespace immutable_string
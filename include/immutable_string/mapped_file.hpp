@@ -0,0 +1,207 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <new>
+#include <system_error>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "immutable_string/string.hpp"
+
+namespace immutable_string {
+
+namespace detail {
+
+// read-only mapping of a whole file, unmapped with the last string which
+// refers to it. The characters have no terminating zero: c_str() copies
+// them, and so do compact() and interning, see unterminated_rep
+template <class String>
+struct mapped_rep : unterminated_rep<typename String::value_type,
+                                     typename String::refcount_type> {
+  using char_type = typename String::value_type;
+  using base = unterminated_rep<char_type, typename String::refcount_type>;
+
+  mapped_rep(void* addr, std::size_t bytes) noexcept
+      : base(&mapped_rep::_release, &mapped_rep::_materialize,
+             static_cast<const char_type*>(addr), bytes / sizeof(char_type)),
+        m_addr(addr),
+        m_bytes(bytes) {}
+
+  template <class Path>
+  static String map(const Path* path);
+
+  void* m_addr;
+  std::size_t m_bytes;
+
+ private:
+  // adopts the mapping, it is unmapped on failure
+  static String _make(void* addr, std::size_t bytes);
+  static void _unmap(void* addr, std::size_t bytes) noexcept;
+  // the terminated copy is made by the allocator of String, like short
+  // files are
+  static const char_type* _materialize(
+      lazy_rep<char_type, typename String::refcount_type>* lazy) {
+    return make_terminated_copy(static_cast<mapped_rep*>(lazy),
+                                typename String::allocator_type());
+  }
+  static void _release(
+      rep_base<typename String::refcount_type>* rep_base) noexcept {
+    auto rep = static_cast<mapped_rep*>(rep_base);
+    free_terminated_copy<char_type, typename String::allocator_type>(rep);
+    _unmap(rep->m_addr, rep->m_bytes);
+    delete rep;
+  }
+
+#if defined(_WIN32)
+  static HANDLE _open(const char* path) noexcept {
+    return ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  }
+  static HANDLE _open(const wchar_t* path) noexcept {
+    return ::CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  }
+  [[noreturn]] static void _throw_error() {
+    throw std::system_error(static_cast<int>(::GetLastError()),
+                            std::system_category(), "map_file");
+  }
+#else
+  [[noreturn]] static void _throw_error() {
+    throw std::system_error(errno, std::generic_category(), "map_file");
+  }
+#endif
+};
+
+#if defined(_WIN32)
+
+template <class String>
+template <class Path>
+String mapped_rep<String>::map(const Path* path) {
+  const auto file = _open(path);
+  if (file == INVALID_HANDLE_VALUE) _throw_error();
+  LARGE_INTEGER size;
+  if (!::GetFileSizeEx(file, &size)) {
+    const auto error = ::GetLastError();
+    ::CloseHandle(file);
+    ::SetLastError(error);
+    _throw_error();
+  }
+  const auto bytes = static_cast<std::size_t>(size.QuadPart);
+  if (bytes < sizeof(char_type)) {
+    ::CloseHandle(file);
+    return String{};
+  }
+  // the view keeps the file and the mapping object open
+  const auto mapping =
+      ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  const auto mapping_error = ::GetLastError();
+  ::CloseHandle(file);
+  if (!mapping) {
+    ::SetLastError(mapping_error);
+    _throw_error();
+  }
+  const auto addr = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  const auto view_error = ::GetLastError();
+  ::CloseHandle(mapping);
+  if (!addr) {
+    ::SetLastError(view_error);
+    _throw_error();
+  }
+  return _make(addr, bytes);
+}
+
+template <class String>
+void mapped_rep<String>::_unmap(void* addr, std::size_t) noexcept {
+  ::UnmapViewOfFile(addr);
+}
+
+#else
+
+template <class String>
+template <class Path>
+String mapped_rep<String>::map(const Path* path) {
+  const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) _throw_error();
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    const auto error = errno;
+    ::close(fd);
+    errno = error;
+    _throw_error();
+  }
+  const auto bytes = static_cast<std::size_t>(st.st_size);
+  if (bytes < sizeof(char_type)) {
+    ::close(fd);
+    return String{};
+  }
+  // the mapping keeps the file open
+  const auto addr = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  const auto error = errno;
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    errno = error;
+    _throw_error();
+  }
+  return _make(addr, bytes);
+}
+
+template <class String>
+void mapped_rep<String>::_unmap(void* addr, std::size_t bytes) noexcept {
+  ::munmap(addr, bytes);
+}
+
+#endif
+
+template <class String>
+String mapped_rep<String>::_make(void* addr, std::size_t bytes) {
+  const auto chars = static_cast<const char_type*>(addr);
+  const auto count = bytes / sizeof(char_type);
+  if (count <= String::inline_capacity) {
+    // short files are copied, so they don't hold a mapping
+    const String res{chars, count};
+    _unmap(addr, bytes);
+    return res;
+  }
+  const auto rep = new (std::nothrow) mapped_rep(addr, bytes);
+  if (!rep) {
+    _unmap(addr, bytes);
+    throw std::bad_alloc();
+  }
+  String res;
+  res.m_size = count;
+  res.m_storage.heap.data = chars;
+  res.m_storage.heap.rep = rep;
+  return res;
+}
+
+}  // namespace detail
+
+// Maps the file read-only and returns its content as a string without
+// copying it; substr() slices share the mapping, which is unmapped when
+// the last of them is destroyed. The characters aren't null-terminated,
+// so the first c_str() call copies them. Trailing bytes of a file which
+// don't make a whole CharT are ignored. Throws std::system_error on failure.
+// The file shall not be modified while it is mapped.
+template <class String = string>
+String map_file(const char* path) {
+  return detail::mapped_rep<String>::map(path);
+}
+#if defined(_WIN32)
+template <class String = string>
+String map_file(const wchar_t* path) {
+  return detail::mapped_rep<String>::map(path);
+}
+#endif
+
+}  // namespace immutable_string
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+#include "immutable_string/detail/search.hpp"
+#include "immutable_string/string.hpp"
+
+namespace immutable_string {
+
+// Set of patterns compiled once and searched in one pass over a string.
+// Large sets use an Aho-Corasick automaton over the bytes which occur in
+// patterns. Small sets with few distinct first bytes use SIMD filtering of
+// the first byte instead. Empty patterns never match.
+template <class CharT, class Traits = std::char_traits<CharT>>
+class basic_multi_searcher {
+ public:
+  using pattern_type = basic_string<CharT, Traits>;
+  using size_type = std::size_t;
+
+  static_assert(detail::is_byte_traits<CharT, Traits>::value,
+                "patterns are matched bytewise");
+
+  static const size_type npos = static_cast<size_type>(-1);
+
+  struct match {
+    size_type pattern;  // index of the pattern, npos if there is no match
+    size_type pos;      // position of the first matched character
+  };
+
+  basic_multi_searcher(std::initializer_list<pattern_type> patterns)
+      : basic_multi_searcher(patterns.begin(), patterns.end()) {}
+  // elements of the range are const CharT* or have data() and size()
+  template <class InputIt>
+  basic_multi_searcher(InputIt first, InputIt last) {
+    for (; first != last; ++first) m_patterns.push_back(_make_pattern(*first));
+    _build();
+  }
+
+  size_type pattern_count() const noexcept { return m_patterns.size(); }
+  const pattern_type& pattern(size_type i) const { return m_patterns[i]; }
+  // true if the SIMD first byte filter is used instead of the automaton
+  bool is_small_set() const noexcept { return !m_first_bytes.empty(); }
+
+  // calls f(match) for every occurrence of every pattern in [s, s + count),
+  // matches are reported in unspecified order
+  template <class F>
+  void for_each_match(const CharT* s, size_type count, F f) const;
+  template <class String, class F>
+  void for_each_match(const String& str, F f) const {
+    for_each_match(str.data(), str.size(), f);
+  }
+
+  // all matches ordered by position, then by pattern index
+  std::vector<match> find_all(const CharT* s, size_type count) const;
+  template <class String>
+  std::vector<match> find_all(const String& str) const {
+    return find_all(str.data(), str.size());
+  }
+
+  // the leftmost match, the lowest pattern index among those at one position
+  match find_first(const CharT* s, size_type count) const;
+  template <class String>
+  match find_first(const String& str) const {
+    return find_first(str.data(), str.size());
+  }
+
+  // the same matcher over many strings: f(string index, match)
+  template <class InputIt, class F>
+  void batch_for_each_match(InputIt first, InputIt last, F f) const {
+    for (size_type i = 0; first != last; ++first, ++i) {
+      for_each_match(*first, [&f, i](const match& m) { f(i, m); });
+    }
+  }
+  // find_first for every string of the range
+  template <class InputIt>
+  std::vector<match> batch_find_first(InputIt first, InputIt last) const {
+    std::vector<match> res;
+    for (; first != last; ++first) res.push_back(find_first(*first));
+    return res;
+  }
+
+ private:
+  // sets of up to small_set_size patterns with up to small_set_first_bytes
+  // distinct first bytes are verified directly after SIMD filtering
+  static const size_type small_set_size = 8;
+  static const size_type small_set_first_bytes = 4;
+  static const std::int32_t no_state = -1;
+
+  static pattern_type _make_pattern(const CharT* s) { return pattern_type{s}; }
+  template <class String>
+  static pattern_type _make_pattern(const String& str) {
+    return pattern_type{str.data(), str.size()};
+  }
+
+  static unsigned char _byte(CharT ch) noexcept {
+    return static_cast<unsigned char>(ch);
+  }
+
+  void _build();
+  void _build_automaton();
+
+  // f(pattern, pos) returns false to stop the search
+  template <class F>
+  void _scan_small(const CharT* s, size_type count, F f) const;
+  // f may also lower end to stop after the given position
+  template <class F>
+  void _scan_automaton(const CharT* s, const size_type& end, F f) const;
+
+  std::vector<pattern_type> m_patterns;
+  size_type m_max_size = 0;
+
+  // small set mode
+  std::vector<unsigned char> m_first_bytes;
+
+  // automaton: bytes are mapped to classes, class 0 is for bytes which
+  // don't occur in patterns, so rows of transitions stay short
+  unsigned char m_classes[UCHAR_MAX + 1] = {};
+  size_type m_class_count = 1;
+  std::vector<std::int32_t> m_transitions;  // state * m_class_count + class
+  std::vector<std::int32_t> m_fail;
+  // the nearest state (itself or by fail links) where a pattern ends
+  std::vector<std::int32_t> m_report;
+  std::vector<std::int32_t> m_output;  // pattern ending at the state
+  std::vector<std::int32_t> m_same;    // next pattern equal to the pattern
+};
+
+using multi_searcher = basic_multi_searcher<char>;
+
+template <class CharT, class Traits>
+const typename basic_multi_searcher<CharT, Traits>::size_type
+    basic_multi_searcher<CharT, Traits>::npos;
+template <class CharT, class Traits>
+const typename basic_multi_searcher<CharT, Traits>::size_type
+    basic_multi_searcher<CharT, Traits>::small_set_size;
+template <class CharT, class Traits>
+const typename basic_multi_searcher<CharT, Traits>::size_type
+    basic_multi_searcher<CharT, Traits>::small_set_first_bytes;
+template <class CharT, class Traits>
+const std::int32_t basic_multi_searcher<CharT, Traits>::no_state;
+
+template <class CharT, class Traits>
+void basic_multi_searcher<CharT, Traits>::_build() {
+  std::vector<unsigned char> first_bytes;
+  for (const auto& pattern : m_patterns) {
+    m_max_size = std::max<size_type>(m_max_size, pattern.size());
+    if (pattern.empty()) continue;
+    const auto first = _byte(pattern[0]);
+    if (std::find(first_bytes.begin(), first_bytes.end(), first) ==
+        first_bytes.end()) {
+      first_bytes.push_back(first);
+    }
+  }
+  if (m_patterns.size() <= small_set_size &&
+      first_bytes.size() <= small_set_first_bytes && !first_bytes.empty()) {
+    m_first_bytes = std::move(first_bytes);
+  } else {
+    _build_automaton();
+  }
+}
+
+template <class CharT, class Traits>
+void basic_multi_searcher<CharT, Traits>::_build_automaton() {
+  for (const auto& pattern : m_patterns) {
+    for (const auto ch : pattern) {
+      auto& cls = m_classes[_byte(ch)];
+      if (cls == 0) cls = static_cast<unsigned char>(m_class_count++);
+    }
+  }
+  const auto row = m_class_count;
+  const auto add_state = [this, row] {
+    m_transitions.resize(m_transitions.size() + row, no_state);
+    m_output.push_back(no_state);
+    return static_cast<std::int32_t>(m_output.size() - 1);
+  };
+
+  // trie of patterns
+  add_state();
+  m_same.assign(m_patterns.size(), no_state);
+  for (size_type i = 0; i < m_patterns.size(); ++i) {
+    const auto& pattern = m_patterns[i];
+    if (pattern.empty()) continue;
+    std::int32_t state = 0;
+    for (const auto ch : pattern) {
+      const auto cls = m_classes[_byte(ch)];
+      if (m_transitions[state * row + cls] == no_state) {
+        const auto next = add_state();
+        m_transitions[state * row + cls] = next;
+      }
+      state = m_transitions[state * row + cls];
+    }
+    // equal patterns end at the same state and are chained
+    auto* out = &m_output[state];
+    while (*out != no_state) out = &m_same[*out];
+    *out = static_cast<std::int32_t>(i);
+  }
+
+  // fail links by BFS, missing transitions are replaced by the ones of
+  // the fail state, so the search makes exactly one step per byte
+  const auto state_count = m_output.size();
+  m_fail.assign(state_count, 0);
+  m_report.assign(state_count, no_state);
+  std::vector<std::int32_t> queue;
+  queue.reserve(state_count);
+  for (size_type cls = 0; cls < row; ++cls) {
+    auto& next = m_transitions[cls];
+    if (next == no_state) {
+      next = 0;
+    } else {
+      queue.push_back(next);
+    }
+  }
+  for (size_type head = 0; head < queue.size(); ++head) {
+    const auto state = queue[head];
+    const auto fail = m_fail[state];
+    m_report[state] = m_output[state] != no_state ? state : m_report[fail];
+    for (size_type cls = 0; cls < row; ++cls) {
+      auto& next = m_transitions[state * row + cls];
+      if (next == no_state) {
+        next = m_transitions[fail * row + cls];
+      } else {
+        m_fail[next] = m_transitions[fail * row + cls];
+        queue.push_back(next);
+      }
+    }
+  }
+}
+
+template <class CharT, class Traits>
+template <class F>
+void basic_multi_searcher<CharT, Traits>::_scan_automaton(
+    const CharT* s, const size_type& end, F f) const {
+  const auto row = m_class_count;
+  std::int32_t state = 0;
+  for (size_type i = 0; i < end; ++i) {
+    state = m_transitions[state * row + m_classes[_byte(s[i])]];
+    for (auto r = m_report[state]; r != no_state; r = m_report[m_fail[r]]) {
+      for (auto p = m_output[r]; p != no_state; p = m_same[p]) {
+        const auto pos = i + 1 - m_patterns[p].size();
+        if (!f(static_cast<size_type>(p), pos)) return;
+      }
+    }
+  }
+}
+
+template <class CharT, class Traits>
+template <class F>
+void basic_multi_searcher<CharT, Traits>::_scan_small(const CharT* s,
+                                                      size_type count,
+                                                      F f) const {
+  const auto bytes = reinterpret_cast<const unsigned char*>(s);
+  // returns false if the search shall stop
+  const auto verify = [&](size_type pos) {
+    for (size_type p = 0; p < m_patterns.size(); ++p) {
+      const auto& pattern = m_patterns[p];
+      if (pattern.empty() || pattern.size() > count - pos) continue;
+      if (_byte(pattern[0]) != bytes[pos]) continue;
+      if (std::memcmp(bytes + pos, pattern.data(), pattern.size()) != 0) {
+        continue;
+      }
+      if (!f(p, pos)) return false;
+    }
+    return true;
+  };
+
+  size_type i = 0;
+#if defined(IMMUTABLE_STRING_SSE2)
+  __m128i firsts[small_set_first_bytes];
+  for (size_type j = 0; j < m_first_bytes.size(); ++j) {
+    firsts[j] = _mm_set1_epi8(static_cast<char>(m_first_bytes[j]));
+  }
+  for (; i + 16 <= count; i += 16) {
+    const auto block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+    auto eq = _mm_setzero_si128();
+    for (size_type j = 0; j < m_first_bytes.size(); ++j) {
+      eq = _mm_or_si128(eq, _mm_cmpeq_epi8(block, firsts[j]));
+    }
+    auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(eq));
+    while (mask != 0) {
+      if (!verify(i + detail::count_trailing_zeros(mask))) return;
+      mask &= mask - 1;
+    }
+  }
+#elif defined(IMMUTABLE_STRING_NEON)
+  uint8x16_t firsts[small_set_first_bytes];
+  for (size_type j = 0; j < m_first_bytes.size(); ++j) {
+    firsts[j] = vdupq_n_u8(m_first_bytes[j]);
+  }
+  for (; i + 16 <= count; i += 16) {
+    const auto block = vld1q_u8(bytes + i);
+    auto eq = vdupq_n_u8(0);
+    for (size_type j = 0; j < m_first_bytes.size(); ++j) {
+      eq = vorrq_u8(eq, vceqq_u8(block, firsts[j]));
+    }
+    const auto nibbles = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+    auto mask = vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+    while (mask != 0) {
+      const auto pos = detail::count_trailing_zeros(mask) >> 2;
+      if (!verify(i + pos)) return;
+      mask &= ~(std::uint64_t(0xf) << (pos << 2));
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    if (std::find(m_first_bytes.begin(), m_first_bytes.end(), bytes[i]) ==
+        m_first_bytes.end()) {
+      continue;
+    }
+    if (!verify(i)) return;
+  }
+}
+
+template <class CharT, class Traits>
+template <class F>
+void basic_multi_searcher<CharT, Traits>::for_each_match(const CharT* s,
+                                                         size_type count,
+                                                         F f) const {
+  const auto report = [&f](size_type pattern, size_type pos) {
+    f(match{pattern, pos});
+    return true;
+  };
+  if (is_small_set()) {
+    _scan_small(s, count, report);
+  } else {
+    _scan_automaton(s, count, report);
+  }
+}
+
+template <class CharT, class Traits>
+std::vector<typename basic_multi_searcher<CharT, Traits>::match>
+basic_multi_searcher<CharT, Traits>::find_all(const CharT* s,
+                                              size_type count) const {
+  std::vector<match> res;
+  for_each_match(s, count, [&res](const match& m) { res.push_back(m); });
+  std::sort(res.begin(), res.end(), [](const match& lhs, const match& rhs) {
+    return lhs.pos != rhs.pos ? lhs.pos < rhs.pos : lhs.pattern < rhs.pattern;
+  });
+  return res;
+}
+
+template <class CharT, class Traits>
+typename basic_multi_searcher<CharT, Traits>::match
+basic_multi_searcher<CharT, Traits>::find_first(const CharT* s,
+                                                size_type count) const {
+  match res{npos, npos};
+  const auto better = [&res](size_type pattern, size_type pos) {
+    return pos < res.pos || (pos == res.pos && pattern < res.pattern);
+  };
+  if (is_small_set()) {
+    // candidates are checked by position, so the first one wins,
+    // but patterns at the same position are still compared by index
+    _scan_small(s, count, [&](size_type pattern, size_type pos) {
+      if (res.pos != npos && pos != res.pos) return false;
+      if (better(pattern, pos)) res = match{pattern, pos};
+      return true;
+    });
+    return res;
+  }
+  // matches are found by their end, a match which starts earlier than
+  // the found one may end up to m_max_size characters later
+  auto end = count;
+  _scan_automaton(s, end, [&](size_type pattern, size_type pos) {
+    if (better(pattern, pos)) {
+      res = match{pattern, pos};
+      end = std::min(count, pos + m_max_size);
+    }
+    return true;
+  });
+  return res;
+}
+
+}  // namespace immutable_string
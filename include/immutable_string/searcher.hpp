@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+#include "immutable_string/detail/search.hpp"
+#include "immutable_string/string.hpp"
+
+namespace immutable_string {
+
+namespace detail {
+
+template <class CharT, class Traits,
+          bool = is_byte_traits<CharT, Traits>::value>
+class pattern_searcher {
+ public:
+  pattern_searcher(const CharT*, std::size_t) noexcept {}
+
+  std::size_t find(const CharT* hay, std::size_t n, const CharT* needle,
+                   std::size_t m) const {
+    if (m == 0) return 0;
+    if (m > n) return not_found;
+    return search<CharT, Traits>(hay, n, needle, m, std::false_type{});
+  }
+};
+
+template <class CharT, class Traits>
+class pattern_searcher<CharT, Traits, true> {
+ public:
+  pattern_searcher(const CharT* needle, std::size_t m) noexcept
+      : m_impl(_bytes(needle), m) {}
+
+  std::size_t find(const CharT* hay, std::size_t n, const CharT* needle,
+                   std::size_t) const noexcept {
+    return m_impl.find(_bytes(hay), n, _bytes(needle));
+  }
+
+ private:
+  static const unsigned char* _bytes(const CharT* s) noexcept {
+    return reinterpret_cast<const unsigned char*>(s);
+  }
+
+  byte_searcher m_impl;
+};
+
+}  // namespace detail
+
+// Pattern preprocessed once (skip table for long patterns) and searched
+// in any number of strings. Can be used with std::search since C++17
+// for contiguous ranges of CharT, and with basic_string::find.
+template <class CharT, class Traits = std::char_traits<CharT>>
+class basic_searcher {
+ public:
+  using pattern_type = basic_string<CharT, Traits>;
+  using size_type = typename pattern_type::size_type;
+
+  static const size_type npos = pattern_type::npos;
+
+  basic_searcher(const CharT* s, size_type count)
+      : basic_searcher(pattern_type{s, count}) {}
+  explicit basic_searcher(const CharT* s) : basic_searcher(pattern_type{s}) {}
+  template <class Alloc, class RefCount>
+  explicit basic_searcher(
+      const basic_string<CharT, Traits, Alloc, RefCount>& pattern)
+      : basic_searcher(pattern_type{pattern.data(), pattern.size()}) {}
+  // data() of a concatenation makes its flat copy, so this may throw
+  explicit basic_searcher(pattern_type pattern)
+      : m_pattern(std::move(pattern)),
+        m_impl(m_pattern.data(), m_pattern.size()) {}
+
+  const pattern_type& pattern() const noexcept { return m_pattern; }
+
+  // position of the first occurrence of the pattern in [s, s + count)
+  // or npos
+  size_type search(const CharT* s, size_type count) const {
+    const auto res =
+        m_impl.find(s, count, m_pattern.data(), m_pattern.size());
+    return res == detail::not_found ? npos : res;
+  }
+
+  // std::search interface; [first, last) shall be contiguous
+  template <class ContiguousIt>
+  std::pair<ContiguousIt, ContiguousIt> operator()(ContiguousIt first,
+                                                   ContiguousIt last) const {
+    const auto count = static_cast<size_type>(std::distance(first, last));
+    const auto pos = count == 0 ? search(nullptr, 0) : search(&*first, count);
+    if (pos == npos) return {last, last};
+    const auto match = std::next(first, pos);
+    return {match, std::next(match, m_pattern.size())};
+  }
+
+ private:
+  pattern_type m_pattern;
+  detail::pattern_searcher<CharT, Traits> m_impl;
+};
+
+using searcher = basic_searcher<char>;
+using wsearcher = basic_searcher<wchar_t>;
+
+template <class CharT, class Traits>
+const typename basic_searcher<CharT, Traits>::size_type
+    basic_searcher<CharT, Traits>::npos;
+
+}  // namespace immutable_string
@@ -0,0 +1,347 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "immutable_string/builder.hpp"
+#include "immutable_string/string.hpp"
+
+// Binary format of a sequence of strings:
+//
+//   header, 16 bytes:
+//     "ISTR"       magic
+//     u8  1        version
+//     u8  size     sizeof of the character type
+//     u8  flags    1 if characters are big-endian, 0 if little-endian
+//     u8  0        reserved
+//     u64 count    number of strings, little-endian
+//   count records, each starts with a LEB128 varint tag:
+//     tag = length << 1       a new string: zero bytes up to a multiple of
+//                             size from the start of the buffer, length
+//                             characters and a zero character
+//     tag = index << 1 | 1    the same string as the index-th new string
+//
+// Characters are stored as they are in memory and the buffer is expected
+// to be aligned as the character type, so a reader makes strings which
+// refer to the buffer instead of copying them.
+
+namespace immutable_string {
+
+namespace detail {
+
+const std::size_t serial_header_size = 16;
+const unsigned char serial_version = 1;
+
+inline bool is_big_endian() noexcept {
+  const std::uint16_t one = 1;
+  unsigned char first;
+  std::memcpy(&first, &one, 1);
+  return first == 0;
+}
+
+template <class String>
+struct deserializer {
+  using char_type = typename String::value_type;
+  using size_type = typename String::size_type;
+
+  template <class Buffer>
+  static std::vector<String> read(const Buffer& buffer);
+
+ private:
+  [[noreturn]] static void _throw_malformed() {
+    throw std::invalid_argument("deserialize");
+  }
+  static std::uint64_t _read_varint(const unsigned char*& pos,
+                                    const unsigned char* end);
+  // the string refers to the characters and shares the buffer
+  template <class Buffer>
+  static String _make(const Buffer& buffer, const char_type* chars,
+                      size_type count);
+};
+
+}  // namespace detail
+
+// Writes strings in the format above into one buffer. With dedup, strings
+// equal to an earlier one are written as references to it.
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class Allocator = std::allocator<char>,
+          class RefCount = atomic_refcount>
+class basic_serializer {
+ public:
+  using buffer_type =
+      basic_string<char, std::char_traits<char>, Allocator, RefCount>;
+  using size_type = std::size_t;
+
+  explicit basic_serializer(bool dedup = false,
+                            const Allocator& alloc = Allocator());
+
+  void write(const CharT* s, size_type count);
+  void write(const CharT* s) { write(s, Traits::length(s)); }
+  template <class A, class R>
+  void write(const basic_string<CharT, Traits, A, R>& str);
+
+  // number of strings written so far
+  size_type count() const noexcept { return m_count; }
+
+  // the buffer of the written strings; the serializer shall not be used
+  // afterwards
+  buffer_type finish();
+
+ private:
+  using builder_type =
+      basic_string_builder<char, std::char_traits<char>, Allocator, RefCount>;
+
+  static const size_type npos = static_cast<size_type>(-1);
+
+  // index of the new string equal to the one of the given hash and size
+  // for which equal(const CharT* chars) is true, npos if there is none
+  template <class Equal>
+  size_type _find(std::uint64_t hash, size_type count,
+                  const Equal& equal) const;
+  void _write_varint(std::uint64_t value);
+  // returns the characters of a new string to be written by the caller
+  CharT* _write_new(std::uint64_t hash, size_type count);
+
+  builder_type m_builder;
+  size_type m_count = 0;
+  bool m_dedup;
+  // dedup: offsets and sizes of new strings, their indices by hash
+  std::vector<size_type> m_offsets;
+  std::vector<size_type> m_sizes;
+  std::unordered_multimap<std::uint64_t, size_type> m_seen;
+};
+
+using serializer = basic_serializer<char>;
+using wserializer = basic_serializer<wchar_t>;
+
+// serializes the range of const CharT* or basic_string<CharT>
+template <class CharT, class InputIt>
+string serialize(InputIt first, InputIt last, bool dedup = false) {
+  basic_serializer<CharT> writer{dedup};
+  for (; first != last; ++first) writer.write(*first);
+  return writer.finish();
+}
+template <class InputIt>
+string serialize(InputIt first, InputIt last, bool dedup = false) {
+  return serialize<char>(first, last, dedup);
+}
+
+// Strings of the buffer in O(number of strings): long ones refer to the
+// characters in the buffer and keep it alive, short ones are inline.
+// Throws std::invalid_argument if the buffer isn't in the format, was
+// written for another character type or isn't aligned as CharT.
+template <class String = string, class Alloc, class RefCount>
+std::vector<String> deserialize(
+    const basic_string<char, std::char_traits<char>, Alloc, RefCount>&
+        buffer) {
+  static_assert(std::is_same<typename String::refcount_type, RefCount>::value,
+                "strings share the buffer, so they shall count it the same");
+  return detail::deserializer<String>::read(buffer);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+const typename basic_serializer<CharT, Traits, Allocator, RefCount>::size_type
+    basic_serializer<CharT, Traits, Allocator, RefCount>::npos;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_serializer<CharT, Traits, Allocator, RefCount>::basic_serializer(
+    bool dedup, const Allocator& alloc)
+    : m_builder(alloc), m_dedup(dedup) {
+  const char header[detail::serial_header_size] = {
+      'I', 'S', 'T', 'R', static_cast<char>(detail::serial_version),
+      static_cast<char>(sizeof(CharT)),
+      static_cast<char>(detail::is_big_endian() ? 1 : 0)};
+  m_builder.append(header, sizeof(header));
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_serializer<CharT, Traits, Allocator, RefCount>::write(
+    const CharT* s, size_type count) {
+  ++m_count;
+  std::uint64_t hash = 0;
+  if (m_dedup) {
+    hash = detail::hash_chars(s, count);
+    const auto index = _find(hash, count, [s, count](const CharT* chars) {
+      return Traits::compare(chars, s, count) == 0;
+    });
+    if (index != npos) return _write_varint((index << 1) | 1);
+  }
+  Traits::copy(_write_new(hash, count), s, count);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class A, class R>
+void basic_serializer<CharT, Traits, Allocator, RefCount>::write(
+    const basic_string<CharT, Traits, A, R>& str) {
+  ++m_count;
+  std::uint64_t hash = 0;
+  if (m_dedup) {
+    hash = str.hash();
+    const auto index = _find(hash, str.size(), [&str](const CharT* chars) {
+      return str.compare(0, str.size(), chars, str.size()) == 0;
+    });
+    if (index != npos) return _write_varint((index << 1) | 1);
+  }
+  auto dest = _write_new(hash, str.size());
+  str.for_each_piece([&dest](const CharT* piece, size_type count) {
+    Traits::copy(dest, piece, count);
+    dest += count;
+  });
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_serializer<CharT, Traits, Allocator, RefCount>::buffer_type
+basic_serializer<CharT, Traits, Allocator, RefCount>::finish() {
+  auto count = static_cast<std::uint64_t>(m_count);
+  for (size_type i = 8; i < detail::serial_header_size; ++i) {
+    m_builder.data()[i] = static_cast<char>(count & 0xff);
+    count >>= 8;
+  }
+  return m_builder.freeze();
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class Equal>
+typename basic_serializer<CharT, Traits, Allocator, RefCount>::size_type
+basic_serializer<CharT, Traits, Allocator, RefCount>::_find(
+    std::uint64_t hash, size_type count, const Equal& equal) const {
+  const auto range = m_seen.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    const auto index = it->second;
+    if (m_sizes[index] == count &&
+        equal(reinterpret_cast<const CharT*>(m_builder.data() +
+                                             m_offsets[index]))) {
+      return index;
+    }
+  }
+  return npos;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_serializer<CharT, Traits, Allocator, RefCount>::_write_varint(
+    std::uint64_t value) {
+  while (value >= 0x80) {
+    m_builder.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  m_builder.push_back(static_cast<char>(value));
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+CharT* basic_serializer<CharT, Traits, Allocator, RefCount>::_write_new(
+    std::uint64_t hash, size_type count) {
+  _write_varint(static_cast<std::uint64_t>(count) << 1);
+  const auto pad =
+      (sizeof(CharT) - m_builder.size() % sizeof(CharT)) % sizeof(CharT);
+  m_builder.append(pad, '\0');
+  if (m_dedup) {
+    m_seen.emplace(hash, m_offsets.size());
+    m_offsets.push_back(m_builder.size());
+    m_sizes.push_back(count);
+  }
+  // chars of the builder are aligned as its buffer header, which is
+  // enough for character types
+  const auto res =
+      reinterpret_cast<CharT*>(m_builder.extend((count + 1) * sizeof(CharT)));
+  res[count] = CharT();
+  return res;
+}
+
+namespace detail {
+
+template <class String>
+template <class Buffer>
+std::vector<String> deserializer<String>::read(const Buffer& lazy_buffer) {
+  // the strings share the buffer of the characters: a concatenation is
+  // replaced by the flat copy which its data() call makes
+  lazy_buffer.data();
+  const auto buffer = concat_rep<Buffer>::_flat_or_self(lazy_buffer);
+  const auto begin = reinterpret_cast<const unsigned char*>(buffer.data());
+  const auto end = begin + buffer.size();
+  const unsigned char magic[] = {'I', 'S', 'T', 'R', serial_version,
+                                 sizeof(char_type),
+                                 static_cast<unsigned char>(
+                                     is_big_endian() ? 1 : 0)};
+  if (buffer.size() < serial_header_size ||
+      std::memcmp(begin, magic, sizeof(magic)) != 0 ||
+      reinterpret_cast<std::uintptr_t>(begin) % alignof(char_type) != 0) {
+    _throw_malformed();
+  }
+  std::uint64_t count = 0;
+  for (size_type i = serial_header_size; i-- > 8;) {
+    count = count << 8 | begin[i];
+  }
+
+  auto pos = begin + serial_header_size;
+  // every record takes a byte at least
+  if (count > static_cast<std::uint64_t>(end - pos)) _throw_malformed();
+  std::vector<String> res;
+  res.reserve(static_cast<size_type>(count));
+  std::vector<size_type> new_strings;
+  for (std::uint64_t i = 0; i < count; ++i) {
+    const auto tag = _read_varint(pos, end);
+    if (tag & 1) {
+      if ((tag >> 1) >= new_strings.size()) _throw_malformed();
+      res.push_back(res[new_strings[static_cast<size_type>(tag >> 1)]]);
+      continue;
+    }
+    const auto offset = static_cast<size_type>(pos - begin);
+    const auto pad =
+        (sizeof(char_type) - offset % sizeof(char_type)) % sizeof(char_type);
+    if (pad > static_cast<size_type>(end - pos)) _throw_malformed();
+    pos += pad;
+    const auto length = tag >> 1;
+    if (length >= static_cast<size_type>(end - pos) / sizeof(char_type)) {
+      _throw_malformed();
+    }
+    const auto chars = reinterpret_cast<const char_type*>(pos);
+    const auto size = static_cast<size_type>(length);
+    if (chars[size] != char_type()) _throw_malformed();
+    new_strings.push_back(res.size());
+    res.push_back(_make(buffer, chars, size));
+    pos += (size + 1) * sizeof(char_type);
+  }
+  if (pos != end) _throw_malformed();
+  return res;
+}
+
+template <class String>
+std::uint64_t deserializer<String>::_read_varint(const unsigned char*& pos,
+                                                 const unsigned char* end) {
+  std::uint64_t res = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (pos == end) _throw_malformed();
+    const auto byte = *pos++;
+    res |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return res;
+  }
+  _throw_malformed();
+}
+
+template <class String>
+template <class Buffer>
+String deserializer<String>::_make(const Buffer& buffer,
+                                   const char_type* chars, size_type count) {
+  String res;
+  res.m_size = count;
+  if (res._is_inline()) {
+    res._init_unowned(chars);
+    return res;
+  }
+  // the buffer of a long string isn't inline
+  res.m_storage.heap.data = chars;
+  res.m_storage.heap.rep = buffer.m_storage.heap.rep;
+  if (res.m_storage.heap.rep) acquire(res.m_storage.heap.rep);
+  return res;
+}
+
+}  // namespace detail
+
+}  // namespace immutable_string
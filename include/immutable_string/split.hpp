@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "immutable_string/builder.hpp"
+#include "immutable_string/string.hpp"
+
+namespace immutable_string {
+
+// Bulk construction of strings from records of a parsed buffer. Instead of
+// a buffer per string the records are copied once into one buffer, which
+// all the long strings share; each record is followed by a zero there, so
+// c_str() of every string works. Short records are stored inline.
+
+namespace detail {
+
+template <class String>
+using builder_for =
+    basic_string_builder<typename String::value_type,
+                         typename String::traits_type,
+                         typename String::allocator_type,
+                         typename String::refcount_type>;
+
+}  // namespace detail
+
+// strings for count records, i-th of lengths[i] characters at s + offsets[i]
+template <class String = string>
+std::vector<String> make_strings(
+    const typename String::value_type* s, const std::size_t* offsets,
+    const std::size_t* lengths, std::size_t count,
+    const typename String::allocator_type& alloc =
+        typename String::allocator_type());
+
+// records of count characters at s separated by delim, e.g. lines; there
+// is one record more than delimiters, an empty one if s ends with delim
+template <class String = string>
+std::vector<String> split(const typename String::value_type* s,
+                          std::size_t count,
+                          typename String::value_type delim,
+                          const typename String::allocator_type& alloc =
+                              typename String::allocator_type());
+
+// records of str separated by delim; they share the buffer of str,
+// so c_str() of a record copies it, see basic_string::substr
+template <class CharT, class Traits, class Allocator, class RefCount>
+std::vector<basic_string<CharT, Traits, Allocator, RefCount>> split(
+    const basic_string<CharT, Traits, Allocator, RefCount>& str,
+    CharT delim) {
+  using size_type = std::size_t;
+  const auto chars = str.data();
+  const auto end = chars + str.size();
+  std::vector<basic_string<CharT, Traits, Allocator, RefCount>> res;
+  for (auto first = chars;;) {
+    const auto found = Traits::find(first, end - first, delim);
+    const auto last = found ? found : end;
+    res.push_back(str.substr(static_cast<size_type>(first - chars),
+                             static_cast<size_type>(last - first)));
+    if (!found) return res;
+    first = found + 1;
+  }
+}
+
+template <class String>
+std::vector<String> make_strings(const typename String::value_type* s,
+                                 const std::size_t* offsets,
+                                 const std::size_t* lengths,
+                                 std::size_t count,
+                                 const typename String::allocator_type& alloc) {
+  using traits_type = typename String::traits_type;
+  using char_type = typename String::value_type;
+  auto is_long = [lengths](std::size_t i) {
+    return lengths[i] > String::inline_capacity;
+  };
+
+  std::size_t buffer_size = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    if (is_long(i)) buffer_size += lengths[i] + 1;
+  }
+  detail::builder_for<String> builder{buffer_size, alloc};
+  for (std::size_t i = 0; i < count; ++i) {
+    if (!is_long(i)) continue;
+    const auto dest = builder.extend(lengths[i] + 1);
+    traits_type::copy(dest, s + offsets[i], lengths[i]);
+    dest[lengths[i]] = char_type();
+  }
+  const auto buffer = builder.freeze();
+
+  std::vector<String> res;
+  res.reserve(count);
+  std::size_t pos = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    if (is_long(i)) {
+      res.push_back(buffer.substr(pos, lengths[i]));
+      pos += lengths[i] + 1;
+    } else {
+      res.push_back(String{s + offsets[i], lengths[i], alloc});
+    }
+  }
+  return res;
+}
+
+template <class String>
+std::vector<String> split(const typename String::value_type* s,
+                          std::size_t count,
+                          typename String::value_type delim,
+                          const typename String::allocator_type& alloc) {
+  using traits_type = typename String::traits_type;
+  using char_type = typename String::value_type;
+  if (count <= String::inline_capacity) {
+    return split(String{s, count, alloc}, delim);
+  }
+
+  // the delimiters of the copy become the terminating zeros of the records
+  std::size_t records = 1;
+  detail::builder_for<String> builder{count, alloc};
+  const auto chars = builder.extend(count);
+  traits_type::copy(chars, s, count);
+  const auto end = chars + count;
+  for (auto found = traits_type::find(chars, count, delim); found;
+       found = traits_type::find(found + 1, end - found - 1, delim)) {
+    chars[found - chars] = char_type();
+    ++records;
+  }
+  const auto buffer = builder.freeze();
+
+  std::vector<String> res;
+  res.reserve(records);
+  for (std::size_t first = 0;;) {
+    const auto found = traits_type::find(s + first, count - first, delim);
+    const auto last = found ? static_cast<std::size_t>(found - s) : count;
+    res.push_back(buffer.substr(first, last - first));
+    if (!found) return res;
+    first = last + 1;
+  }
+}
+
+}  // namespace immutable_string
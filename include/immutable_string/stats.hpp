@@ -0,0 +1,228 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(IMMUTABLE_STRING_STATS) && IMMUTABLE_STRING_STATS
+#include <atomic>
+#include <new>
+#include <thread>
+#include <type_traits>
+#endif
+
+// Opt-in counters of string buffers for profiling: define
+// IMMUTABLE_STRING_STATS to 1 in every translation unit to collect them.
+// Otherwise the hooks are empty and collect() returns zeros.
+//
+// Every thread counts its own events without synchronization, collect()
+// sums the counters of all the threads, including finished ones.
+
+namespace immutable_string {
+
+namespace stats {
+
+#if defined(IMMUTABLE_STRING_STATS) && IMMUTABLE_STRING_STATS
+const bool enabled = true;
+#else
+const bool enabled = false;
+#endif
+
+// lengths[i] counts strings of length in [2^(i-1), 2^i), lengths[0]
+// counts empty ones and the last bucket all the longer ones
+const std::size_t length_buckets = 33;
+
+struct snapshot {
+  // heap buffers of strings, builders and concatenations
+  std::uint64_t buffers_allocated = 0;
+  std::uint64_t buffers_freed = 0;
+  std::uint64_t bytes_allocated = 0;
+  std::uint64_t bytes_freed = 0;
+  // refcount increments: copies and slices sharing a buffer
+  std::uint64_t copies = 0;
+  // strings made of characters by constructors, builders and arenas,
+  // inline ones included
+  std::uint64_t lengths[length_buckets] = {};
+
+  std::uint64_t live_buffers() const noexcept {
+    return buffers_allocated - buffers_freed;
+  }
+  std::uint64_t live_bytes() const noexcept {
+    return bytes_allocated - bytes_freed;
+  }
+};
+
+snapshot collect();
+
+}  // namespace stats
+
+namespace detail {
+
+inline std::size_t length_bucket(std::size_t length) noexcept {
+  std::size_t res = 0;
+  while (length != 0 && res + 1 < stats::length_buckets) {
+    length >>= 1;
+    ++res;
+  }
+  return res;
+}
+
+#if defined(IMMUTABLE_STRING_STATS) && IMMUTABLE_STRING_STATS
+
+enum stats_counter : std::size_t {
+  buffers_allocated_counter,
+  buffers_freed_counter,
+  bytes_allocated_counter,
+  bytes_freed_counter,
+  copies_counter,
+  lengths_counter,
+  counter_count = lengths_counter + stats::length_buckets
+};
+
+struct thread_stats;
+
+// counters of the running threads and the sums of the finished ones.
+// The noexcept hooks register their thread on the first call, so
+// registering neither allocates nor throws: the registry lives in static
+// storage, threads are linked into a list and a spinlock guards them
+struct stats_registry {
+  // never destroyed, threads may finish after static destructors
+  static stats_registry& instance() noexcept {
+    static typename std::aligned_storage<sizeof(stats_registry),
+                                         alignof(stats_registry)>::type
+        storage;
+    static const auto registry = new (&storage) stats_registry;
+    return *registry;
+  }
+
+  std::atomic_flag locked = ATOMIC_FLAG_INIT;
+  thread_stats* threads = nullptr;
+  std::uint64_t finished[counter_count] = {};
+};
+
+// holds the spinlock of the registry, only for short walks of its list
+class stats_lock {
+ public:
+  explicit stats_lock(stats_registry& registry) noexcept
+      : m_registry(registry) {
+    while (m_registry.locked.test_and_set(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+  stats_lock(const stats_lock&) = delete;
+  stats_lock& operator=(const stats_lock&) = delete;
+  ~stats_lock() { m_registry.locked.clear(std::memory_order_release); }
+
+ private:
+  stats_registry& m_registry;
+};
+
+struct thread_stats {
+  explicit thread_stats(bool& destroyed) noexcept : destroyed(destroyed) {
+    for (auto& counter : counters) counter.store(0, std::memory_order_relaxed);
+    auto& registry = stats_registry::instance();
+    stats_lock lock{registry};
+    next = registry.threads;
+    if (next) next->prev = this;
+    registry.threads = this;
+  }
+  ~thread_stats() {
+    auto& registry = stats_registry::instance();
+    stats_lock lock{registry};
+    for (std::size_t i = 0; i < counter_count; ++i) {
+      registry.finished[i] += counters[i].load(std::memory_order_relaxed);
+    }
+    (prev ? prev->next : registry.threads) = next;
+    if (next) next->prev = prev;
+    destroyed = true;
+  }
+
+  // only the owner thread writes: counters are atomic to be read by others
+  void add(std::size_t counter, std::uint64_t value) noexcept {
+    auto& dest = counters[counter];
+    dest.store(dest.load(std::memory_order_relaxed) + value,
+               std::memory_order_relaxed);
+  }
+
+  // counts an event of the calling thread. Thread locals are destroyed
+  // before static objects, whose destructors may still free buffers: the
+  // events after the stats of the thread are gone go to the registry
+  static void count(std::size_t counter, std::uint64_t value) noexcept {
+    // trivially destructible, so it is valid until the thread ends
+    thread_local bool destroyed = false;
+    if (!destroyed) {
+      thread_local thread_stats stats{destroyed};
+      stats.add(counter, value);
+      return;
+    }
+    auto& registry = stats_registry::instance();
+    stats_lock lock{registry};
+    registry.finished[counter] += value;
+  }
+
+  std::atomic<std::uint64_t> counters[counter_count];
+  // set by the destructor
+  bool& destroyed;
+  // the list of the running threads of the registry
+  thread_stats* prev = nullptr;
+  thread_stats* next = nullptr;
+};
+
+inline void stats_allocated(std::size_t bytes) noexcept {
+  thread_stats::count(buffers_allocated_counter, 1);
+  thread_stats::count(bytes_allocated_counter, bytes);
+}
+inline void stats_freed(std::size_t bytes) noexcept {
+  thread_stats::count(buffers_freed_counter, 1);
+  thread_stats::count(bytes_freed_counter, bytes);
+}
+inline void stats_copied() noexcept {
+  thread_stats::count(copies_counter, 1);
+}
+inline void stats_created(std::size_t length) noexcept {
+  thread_stats::count(lengths_counter + length_bucket(length), 1);
+}
+
+#else
+
+inline void stats_allocated(std::size_t) noexcept {}
+inline void stats_freed(std::size_t) noexcept {}
+inline void stats_copied() noexcept {}
+inline void stats_created(std::size_t) noexcept {}
+
+#endif
+
+}  // namespace detail
+
+#if defined(IMMUTABLE_STRING_STATS) && IMMUTABLE_STRING_STATS
+
+inline stats::snapshot stats::collect() {
+  std::uint64_t sums[detail::counter_count];
+  auto& registry = detail::stats_registry::instance();
+  {
+    detail::stats_lock lock{registry};
+    for (std::size_t i = 0; i < detail::counter_count; ++i) {
+      sums[i] = registry.finished[i];
+      for (auto thread = registry.threads; thread; thread = thread->next) {
+        sums[i] += thread->counters[i].load(std::memory_order_relaxed);
+      }
+    }
+  }
+  snapshot res;
+  res.buffers_allocated = sums[detail::buffers_allocated_counter];
+  res.buffers_freed = sums[detail::buffers_freed_counter];
+  res.bytes_allocated = sums[detail::bytes_allocated_counter];
+  res.bytes_freed = sums[detail::bytes_freed_counter];
+  res.copies = sums[detail::copies_counter];
+  for (std::size_t i = 0; i < length_buckets; ++i) {
+    res.lengths[i] = sums[detail::lengths_counter + i];
+  }
+  return res;
+}
+
+#else
+
+inline stats::snapshot stats::collect() { return snapshot{}; }
+
+#endif
+
+}  // namespace immutable_string
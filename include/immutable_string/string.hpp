@@ -1,316 +1,2018 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__has_include)
+#if __has_include(<string_view>) && \
+    (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L))
+#define IMMUTABLE_STRING_STRING_VIEW 1
+#include <string_view>
+#endif
+#endif
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
 
-#include <boost/smart_ptr/allocate_shared_array.hpp>
-#include <boost/smart_ptr/shared_ptr.hpp>
+#include "immutable_string/detail/search.hpp"
+#include "immutable_string/stats.hpp"
 
 namespace immutable_string {
 
+// reference counting policies for the shared buffers of basic_string
+
+// thread-safe: strings may be copied and destroyed from any thread
+struct atomic_refcount {
+  using counter_type = std::atomic<std::size_t>;
+  static constexpr bool is_thread_safe = true;
+
+  static void increment(counter_type& refs) noexcept {
+    refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  // returns true if the last reference is gone
+  static bool decrement(counter_type& refs) noexcept {
+    return refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+};
+
+// plain integer: all copies of a string shall stay within one thread
+struct plain_refcount {
+  using counter_type = std::size_t;
+  static constexpr bool is_thread_safe = false;
+
+  static void increment(counter_type& refs) noexcept { ++refs; }
+  static bool decrement(counter_type& refs) noexcept { return --refs == 0; }
+};
+
+namespace detail {
+
+// header of a shared buffer; the buffer owner decides where characters
+// are and how to free them, so the string itself only needs the pointer
+template <class RefCount>
+struct rep_base {
+  using release_fn = void (*)(rep_base*);
+
+  // properties of the buffer content, set once and never cleared
+  enum flags : unsigned {
+    interned_flag = 1,  // the canonical buffer of the global intern pool
+    concat_flag = 2,    // concat_rep: characters are in its two strings
+    // cached results of the scans of utf8.hpp, valid if checked is set
+    ascii_checked_flag = 4,
+    ascii_flag = 8,
+    utf8_checked_flag = 16,
+    utf8_flag = 32,
+    unterminated_flag = 64,  // unterminated_rep: a copy makes c_str()
+    slice_flag = 128,        // slice_rep
+  };
+
+  rep_base(release_fn release, std::size_t size) noexcept
+      : m_refs(1), m_release(release), m_size(size), m_flags(0), m_hash(0) {}
+
+  bool has_flag(flags flag) const noexcept {
+    return (m_flags.load(std::memory_order_relaxed) & flag) != 0;
+  }
+  // flags set together are seen together
+  void set_flag(unsigned flag) noexcept {
+    m_flags.fetch_or(flag, std::memory_order_relaxed);
+  }
+  // one load, so related flags are tested consistently
+  unsigned load_flags() const noexcept {
+    return m_flags.load(std::memory_order_relaxed);
+  }
+
+  typename RefCount::counter_type m_refs;
+  release_fn m_release;
+  // number of characters in the buffer: a string of that size is not a slice
+  std::size_t m_size;
+  std::atomic<unsigned> m_flags;
+  // hash of the whole buffer, 0 until computed
+  std::atomic<std::uint64_t> m_hash;
+};
+
+template <class RefCount>
+void acquire(rep_base<RefCount>* rep) noexcept {
+  stats_copied();
+  RefCount::increment(rep->m_refs);
+}
+
+template <class RefCount>
+void release(rep_base<RefCount>* rep) noexcept {
+  if (RefCount::decrement(rep->m_refs)) rep->m_release(rep);
+}
+
+// MurmurHash64A, reads the input by 8 bytes. The total length is known
+// in advance, so the input may come in pieces of any size
+class hash_stream {
+ public:
+  explicit hash_stream(std::size_t len) noexcept
+      : m_hash(0x8445d61a4e774912ULL ^ (len * m)) {}
+
+  void update(const void* data, std::size_t len) noexcept {
+    auto bytes = static_cast<const unsigned char*>(data);
+    if (m_tail_size != 0) {
+      const auto count = std::min(len, 8 - m_tail_size);
+      std::memcpy(m_tail + m_tail_size, bytes, count);
+      m_tail_size += count;
+      bytes += count;
+      len -= count;
+      if (m_tail_size < 8) return;
+      _mix(m_tail);
+      m_tail_size = 0;
+    }
+    const auto tail = bytes + (len & ~std::size_t(7));
+    for (; bytes != tail; bytes += 8) _mix(bytes);
+    m_tail_size = len & 7;
+    std::memcpy(m_tail, bytes, m_tail_size);
+  }
+
+  std::uint64_t finish() const noexcept {
+    auto h = m_hash;
+    switch (m_tail_size) {
+      case 7: h ^= std::uint64_t(m_tail[6]) << 48;  // fall through
+      case 6: h ^= std::uint64_t(m_tail[5]) << 40;  // fall through
+      case 5: h ^= std::uint64_t(m_tail[4]) << 32;  // fall through
+      case 4: h ^= std::uint64_t(m_tail[3]) << 24;  // fall through
+      case 3: h ^= std::uint64_t(m_tail[2]) << 16;  // fall through
+      case 2: h ^= std::uint64_t(m_tail[1]) << 8;   // fall through
+      case 1:
+        h ^= std::uint64_t(m_tail[0]);
+        h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+  }
+
+ private:
+  static const std::uint64_t m = 0xc6a4a7935bd1e995ULL;
+  static const int r = 47;
+
+  void _mix(const unsigned char* block) noexcept {
+    std::uint64_t k;
+    std::memcpy(&k, block, 8);
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    m_hash ^= k;
+    m_hash *= m;
+  }
+
+  std::uint64_t m_hash;
+  unsigned char m_tail[8];
+  std::size_t m_tail_size = 0;
+};
+
+inline std::uint64_t hash_bytes(const void* data, std::size_t len) noexcept {
+  hash_stream stream{len};
+  stream.update(data, len);
+  return stream.finish();
+}
+
+// 8 bytes as a big-endian number: words compare as their bytes do
+inline std::uint64_t load_big_endian(const void* p) noexcept {
+  std::uint64_t res;
+  std::memcpy(&res, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  return res;
+#elif defined(_MSC_VER)
+  return _byteswap_uint64(res);
+#else
+  return __builtin_bswap64(res);
+#endif
+}
+
+// Traits::compare; byte strings which differ within the first 8 bytes,
+// as most of the sorted keys do, are ordered by one word comparison
+template <class CharT, class Traits>
+int compare_chars(const CharT* s1, const CharT* s2, std::size_t count,
+                  std::true_type /* byte traits */) noexcept {
+  if (count < 8) return Traits::compare(s1, s2, count);
+  const auto word1 = load_big_endian(s1);
+  const auto word2 = load_big_endian(s2);
+  if (word1 != word2) return word1 < word2 ? -1 : 1;
+  return Traits::compare(s1 + 8, s2 + 8, count - 8);
+}
+
+template <class CharT, class Traits>
+int compare_chars(const CharT* s1, const CharT* s2, std::size_t count,
+                  std::false_type /* byte traits */) noexcept {
+  return Traits::compare(s1, s2, count);
+}
+
+// length of s if it is less than max, max otherwise: s isn't scanned
+// further than a string compared with it may need
+template <class Traits>
+std::size_t bounded_length(const typename Traits::char_type* s,
+                           std::size_t max) noexcept {
+  const auto end = Traits::find(s, max, typename Traits::char_type());
+  return end ? static_cast<std::size_t>(end - s) : max;
+}
+
+// hash of a character sequence as basic_string::hash() computes it;
+// never 0, so 0 can mark a hash which isn't computed yet
+inline std::uint64_t nonzero_hash(std::uint64_t hash) noexcept {
+  return hash != 0 ? hash : 1;
+}
+
+template <class CharT>
+std::uint64_t hash_chars(const CharT* s, std::size_t count) noexcept {
+  return nonzero_hash(hash_bytes(s, count * sizeof(CharT)));
+}
+
+// buffer which makes its characters on the first data() call;
+// strings of such buffers have null data pointer
+template <class CharT, class RefCount>
+struct lazy_rep : rep_base<RefCount> {
+  using base = rep_base<RefCount>;
+  using materialize_fn = const CharT* (*)(lazy_rep*);
+
+  lazy_rep(typename base::release_fn release, materialize_fn materialize,
+           std::size_t size) noexcept
+      : base(release, size), m_materialize(materialize), m_data(nullptr) {}
+
+  const CharT* data() {
+    const auto res = m_data.load(std::memory_order_acquire);
+    return res ? res : m_materialize(this);
+  }
+  // characters if they are made already or nullptr
+  const CharT* made_data() const noexcept {
+    return m_data.load(std::memory_order_acquire);
+  }
+  // makes chars the characters of the buffer unless another thread did it
+  // first; returns the characters which stay
+  const CharT* publish(const CharT* chars) noexcept {
+    const CharT* expected = nullptr;
+    if (m_data.compare_exchange_strong(expected, chars,
+                                       std::memory_order_acq_rel,
+                                       std::memory_order_acquire)) {
+      return chars;
+    }
+    return expected;
+  }
+
+  materialize_fn m_materialize;
+  std::atomic<const CharT*> m_data;
+};
+
+// Characters which aren't followed by a terminating zero, e.g. a slice or
+// a mapped file. Strings sharing them have non-null data pointers, but the
+// first c_str() call of the string of exactly m_chars and m_count makes
+// a terminated copy, which lives as long as the buffer. Other strings of
+// such buffers shall be null-terminated. The size is 0, so no string is
+// the whole buffer. The derived buffer makes the copy and frees it, see
+// make_terminated_copy.
+template <class CharT, class RefCount>
+struct unterminated_rep : lazy_rep<CharT, RefCount> {
+  using base = lazy_rep<CharT, RefCount>;
+
+  unterminated_rep(typename base::release_fn release,
+                   typename base::materialize_fn materialize,
+                   const CharT* chars, std::size_t count) noexcept
+      : base(release, materialize, 0), m_chars(chars), m_count(count) {
+    this->set_flag(base::unterminated_flag);
+  }
+
+  const CharT* m_chars;
+  std::size_t m_count;
+};
+
+// slice which doesn't end with a zero; it refers to the buffer it is cut
+// from, never to another slice, so slices of slices don't make chains.
+// slice_node allocates it
+template <class CharT, class RefCount>
+struct slice_rep : unterminated_rep<CharT, RefCount> {
+  using base = unterminated_rep<CharT, RefCount>;
+
+  // owner is nullptr for unowned characters
+  slice_rep(typename base::release_fn release,
+            typename base::materialize_fn materialize,
+            rep_base<RefCount>* owner, const CharT* chars,
+            std::size_t count) noexcept
+      : base(release, materialize, chars, count), m_owner(owner) {
+    this->set_flag(base::slice_flag);
+    if (!owner) return;
+    acquire(owner);
+    // a part of ASCII characters is ASCII, see utf8.hpp
+    if (owner->has_flag(base::ascii_flag)) this->set_flag(base::ascii_flag);
+  }
+
+  rep_base<RefCount>* m_owner;
+};
+
+// header, refcount and characters in one allocation made by Allocator
+template <class CharT, class Allocator, class RefCount>
+struct heap_rep : rep_base<RefCount> {
+  using base = rep_base<RefCount>;
+  using unit = typename std::aligned_storage<sizeof(base*),
+                                             alignof(base)>::type;
+  using alloc_type = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<unit>;
+  using alloc_traits = std::allocator_traits<alloc_type>;
+
+  heap_rep(const alloc_type& alloc, std::size_t count) noexcept
+      : base(&heap_rep::_release, count), m_alloc(alloc) {}
+
+  // rep is a heap_rep, so it keeps the allocator of its strings
+  static bool is_heap(const base* rep) noexcept {
+    return rep->m_release == &heap_rep::_release;
+  }
+
+  CharT* chars() noexcept { return reinterpret_cast<CharT*>(this + 1); }
+  static heap_rep* from_chars(const CharT* chars) noexcept {
+    return reinterpret_cast<heap_rep*>(const_cast<CharT*>(chars)) - 1;
+  }
+
+  // allocates a buffer for count characters and terminating zero
+  static heap_rep* create(const Allocator& alloc, std::size_t count) {
+    alloc_type unit_alloc{alloc};
+    void* mem = alloc_traits::allocate(unit_alloc, _units(count));
+    stats_allocated(_units(count) * sizeof(unit));
+    auto rep = new (mem) heap_rep(unit_alloc, count);
+    rep->chars()[count] = CharT();
+    return rep;
+  }
+
+  alloc_type m_alloc;
+
+ private:
+  static std::size_t _units(std::size_t count) noexcept {
+    const auto bytes = sizeof(heap_rep) + (count + 1) * sizeof(CharT);
+    return (bytes + sizeof(unit) - 1) / sizeof(unit);
+  }
+
+  static void _release(base* rep_base) noexcept {
+    auto rep = static_cast<heap_rep*>(rep_base);
+    alloc_type unit_alloc{std::move(rep->m_alloc)};
+    const auto units = _units(rep->m_size);
+    stats_freed(units * sizeof(unit));
+    rep->~heap_rep();
+    alloc_traits::deallocate(unit_alloc, reinterpret_cast<unit*>(rep), units);
+  }
+};
+
+// heap buffer which may have more room than characters: the layout of
+// heap_rep plus the capacity, so the buffer can become a string as is
+template <class CharT, class Allocator, class RefCount>
+struct growable_rep : rep_base<RefCount> {
+  using base = rep_base<RefCount>;
+  using unit = typename std::aligned_storage<sizeof(base*),
+                                             alignof(base)>::type;
+  using alloc_type = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<unit>;
+  using alloc_traits = std::allocator_traits<alloc_type>;
+
+  growable_rep(const alloc_type& alloc, std::size_t capacity) noexcept
+      : base(&growable_rep::_release, 0),
+        m_capacity(capacity),
+        m_alloc(alloc) {}
+
+  // rep is a growable_rep, e.g. a frozen basic_string_builder
+  static bool is_growable(const base* rep) noexcept {
+    return rep->m_release == &growable_rep::_release;
+  }
+
+  CharT* chars() noexcept { return reinterpret_cast<CharT*>(this + 1); }
+
+  // allocates a buffer for capacity characters and terminating zero
+  static growable_rep* create(const alloc_type& alloc, std::size_t capacity) {
+    alloc_type unit_alloc{alloc};
+    void* mem = alloc_traits::allocate(unit_alloc, _units(capacity));
+    stats_allocated(_units(capacity) * sizeof(unit));
+    return new (mem) growable_rep(unit_alloc, capacity);
+  }
+
+  std::size_t m_capacity;
+  alloc_type m_alloc;
+
+ private:
+  static std::size_t _units(std::size_t capacity) noexcept {
+    const auto bytes = sizeof(growable_rep) + (capacity + 1) * sizeof(CharT);
+    return (bytes + sizeof(unit) - 1) / sizeof(unit);
+  }
+
+  static void _release(base* rep_base) noexcept {
+    auto rep = static_cast<growable_rep*>(rep_base);
+    alloc_type unit_alloc{std::move(rep->m_alloc)};
+    const auto units = _units(rep->m_capacity);
+    stats_freed(units * sizeof(unit));
+    rep->~growable_rep();
+    alloc_traits::deallocate(unit_alloc, reinterpret_cast<unit*>(rep), units);
+  }
+};
+
+// makes the terminated copy of the characters of rep in a heap_rep of
+// alloc unless another thread did it first; returns the copy which stays
+template <class CharT, class Allocator, class RefCount>
+const CharT* make_terminated_copy(unterminated_rep<CharT, RefCount>* rep,
+                                  const Allocator& alloc) {
+  using copy_type = heap_rep<CharT, Allocator, RefCount>;
+  const auto copy = copy_type::create(alloc, rep->m_count);
+  std::copy(rep->m_chars, rep->m_chars + rep->m_count, copy->chars());
+  const auto res = rep->publish(copy->chars());
+  if (res != copy->chars()) release<RefCount>(copy);
+  return res;
+}
+// frees the copy made by make_terminated_copy with the same Allocator
+template <class CharT, class Allocator, class RefCount>
+void free_terminated_copy(unterminated_rep<CharT, RefCount>* rep) noexcept {
+  using copy_type = heap_rep<CharT, Allocator, RefCount>;
+  if (const auto chars = rep->made_data()) {
+    release<RefCount>(copy_type::from_chars(chars));
+  }
+}
+
+// allocator of strings which have no buffer keeping one, e.g. slices of
+// unowned characters: Allocator if it can be default-constructed
+template <class Allocator,
+          bool = std::is_default_constructible<Allocator>::value>
+struct default_allocator {
+  using type = Allocator;
+};
+template <class Allocator>
+struct default_allocator<Allocator, false> {
+  using type = std::allocator<
+      typename std::allocator_traits<Allocator>::value_type>;
+};
+
+// slice_rep and its terminated copy allocated by Allocator
+template <class CharT, class Allocator, class RefCount>
+struct slice_node : slice_rep<CharT, RefCount> {
+  using base = slice_rep<CharT, RefCount>;
+  using alloc_type = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<slice_node>;
+  using alloc_traits = std::allocator_traits<alloc_type>;
+
+  slice_node(const alloc_type& alloc, rep_base<RefCount>* owner,
+             const CharT* chars, std::size_t count) noexcept
+      : base(&slice_node::_release, &slice_node::_materialize, owner, chars,
+             count),
+        m_alloc(alloc) {}
+
+  static slice_node* create(const Allocator& alloc, rep_base<RefCount>* owner,
+                            const CharT* chars, std::size_t count) {
+    alloc_type node_alloc{alloc};
+    const auto mem = alloc_traits::allocate(node_alloc, 1);
+    stats_allocated(sizeof(slice_node));
+    return new (mem) slice_node(node_alloc, owner, chars, count);
+  }
+
+  alloc_type m_alloc;
+
+ private:
+  static const CharT* _materialize(lazy_rep<CharT, RefCount>* lazy) {
+    const auto rep = static_cast<slice_node*>(lazy);
+    return make_terminated_copy(rep, Allocator{rep->m_alloc});
+  }
+
+  static void _release(rep_base<RefCount>* rep_base) noexcept {
+    const auto rep = static_cast<slice_node*>(rep_base);
+    const auto owner = rep->m_owner;
+    free_terminated_copy<CharT, Allocator>(rep);
+    alloc_type node_alloc{std::move(rep->m_alloc)};
+    rep->~slice_node();
+    alloc_traits::deallocate(node_alloc, rep, 1);
+    stats_freed(sizeof(slice_node));
+    if (owner) release(owner);
+  }
+};
+
+// concatenations of up to this many bytes are copied instead
+const std::size_t concat_copy_bytes = 128;
+// deeper trees of concatenations are rebuilt balanced, so visiting
+// and destroying them recurse to a bounded depth
+const unsigned concat_max_depth = 48;
+
+template <class String>
+struct concat_rep;
+template <class String>
+struct mapped_rep;
+template <class String>
+struct deserializer;
+template <class String>
+struct utf8_flags;
+
+}  // namespace detail
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+class basic_intern_pool;
+template <class CharT, class Traits>
+class basic_searcher;
+template <class CharT, class Traits, class Allocator, class RefCount>
+class basic_string_builder;
+template <class Allocator>
+class basic_arena;
+
 template <class CharT, class Traits = std::char_traits<CharT>,
-          class Allocator = std::allocator<CharT>>
+          class Allocator = std::allocator<CharT>,
+          class RefCount = atomic_refcount>
 class basic_string {
  public:
   using traits_type = Traits;
   using value_type = typename traits_type::char_type;
   using allocator_type = Allocator;
-  using size_type = typename allocator_type::size_type;
-  using difference_type = typename allocator_type::difference_type;
-  using reference = typename allocator_type::reference;
-  using const_reference = typename allocator_type::const_reference;
-  using pointer = typename allocator_type::pointer;
-  using const_pointer = typename allocator_type::const_pointer;
-  using iterator = const char*;
-  using const_iterator = const char*;
+  using refcount_type = RefCount;
+  // allocator_traits: C++20 allocators have no reference and pointer types
+  using size_type = typename std::allocator_traits<allocator_type>::size_type;
+  using difference_type =
+      typename std::allocator_traits<allocator_type>::difference_type;
+  using reference = value_type&;
+  using const_reference = const value_type&;
+  using pointer = typename std::allocator_traits<allocator_type>::pointer;
+  using const_pointer =
+      typename std::allocator_traits<allocator_type>::const_pointer;
+  // pointers to contiguous characters, so algorithms take their memmove
+  // and vectorized paths, and C++20 sees a contiguous range
+  using iterator = const CharT*;
+  using const_iterator = const CharT*;
   using reverse_iterator = std::reverse_iterator<iterator>;
   using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
   static const size_type npos = -1;
+  // strings up to this size are stored inside the object itself,
+  // so they never touch the allocator and are copied by memcpy
+  static const size_type inline_capacity =
+      2 * sizeof(void*) / sizeof(CharT) - 1;
 
-  basic_string();
-  explicit basic_string(const Allocator& alloc);
+  basic_string() noexcept;
+  explicit basic_string(const Allocator& alloc) noexcept;
   basic_string(size_type count, CharT ch, const Allocator& alloc = Allocator());
   basic_string(const CharT* s, const Allocator& alloc = Allocator());
   basic_string(const CharT* s, size_type count,
                const Allocator& alloc = Allocator());
+#if defined(IMMUTABLE_STRING_STRING_VIEW)
+  explicit basic_string(std::basic_string_view<CharT, Traits> sv,
+                        const Allocator& alloc = Allocator())
+      : basic_string(sv.data(), sv.size(), alloc) {}
+#endif
+
+  basic_string(const basic_string& other) noexcept;
+  basic_string(basic_string&& other) noexcept;
+  ~basic_string();
+
+  basic_string& operator=(const basic_string& other) noexcept;
+  basic_string& operator=(basic_string&& other) noexcept;
+
+  // Refers to characters in static storage, e.g. a string literal, without
+  // a copy or a buffer, so copies never touch a refcount. s[count] shall be
+  // a terminating zero and s shall live until the end of the program.
+  static basic_string from_static(const CharT* s, size_type count) noexcept;
+  // the length of a literal is known at compile time
+  template <std::size_t N>
+  static basic_string from_static(const CharT (&s)[N]) noexcept {
+    return from_static(s, N - 1);
+  }
 
-  const_reference operator[](size_type pos) const noexcept;
+  const_reference operator[](size_type pos) const;
   const_reference at(size_type pos) const;
-  const_reference front() const noexcept { return (*this)[0]; }
-  const_reference back() const noexcept { return (*this)[size() - 1]; }
-  const CharT* data() const noexcept { return m_data.get(); }
-  const CharT* c_str() const noexcept { return data(); }
+  const_reference front() const { return (*this)[0]; }
+  const_reference back() const { return (*this)[size() - 1]; }
+  // the characters of a concatenation are copied into one buffer
+  // on the first call, so it may allocate
+  const CharT* data() const {
+    if (_is_inline()) return m_storage.buf;
+    return m_storage.heap.data ? m_storage.heap.data : _lazy_data();
+  }
+  // null-terminated characters: a slice which isn't followed by a zero
+  // makes a terminated copy on the first call, see unterminated_rep
+  const CharT* c_str() const {
+    if (_is_terminated()) return data();
+    return static_cast<detail::unterminated_rep<CharT, RefCount>*>(
+               m_storage.heap.rep)
+        ->data();
+  }
+#if defined(IMMUTABLE_STRING_STRING_VIEW)
+  // the view shares the characters, so it is valid while they live
+  operator std::basic_string_view<CharT, Traits>() const {
+    return {data(), size()};
+  }
+#endif
 
   bool empty() const noexcept { return m_size == 0; }
   size_type size() const noexcept { return m_size; }
   size_type length() const noexcept { return size(); }
 
-  iterator begin() const noexcept;
-  iterator end() const noexcept;
-  reverse_iterator rbegin() const noexcept;
-  reverse_iterator rend() const noexcept;
+  // iterators are over data(), see for_each_piece for a concatenation
+  iterator begin() const;
+  iterator end() const;
+  reverse_iterator rbegin() const;
+  reverse_iterator rend() const;
 
-  iterator cbegin() const noexcept { return begin(); }
-  iterator cend() const noexcept { return end(); }
-  reverse_iterator crbegin() const noexcept { return rbegin(); }
-  reverse_iterator crend() const noexcept { return rend(); }
+  iterator cbegin() const { return begin(); }
+  iterator cend() const { return end(); }
+  reverse_iterator crbegin() const { return rbegin(); }
+  reverse_iterator crend() const { return rend(); }
+
+  // calls f(const CharT* piece, size_type count) for contiguous pieces
+  // of the string in order; a concatenation is visited piece by piece
+  template <class F>
+  void for_each_piece(F f) const;
 
   size_type find(const basic_string& str, size_type pos = 0) const;
   size_type find(const CharT* s, size_type pos, size_type count) const;
   size_type find(const CharT* s, size_type pos = 0) const;
   size_type find(CharT ch, size_type pos = 0) const;
+  // uses the pattern preprocessed by searcher, see searcher.hpp
+  size_type find(const basic_searcher<CharT, Traits>& searcher,
+                 size_type pos = 0) const;
+
+  size_type rfind(const basic_string& str, size_type pos = npos) const {
+    return rfind(str.data(), pos, str.size());
+  }
+  size_type rfind(const CharT* s, size_type pos, size_type count) const;
+  size_type rfind(const CharT* s, size_type pos = npos) const {
+    return rfind(s, pos, Traits::length(s));
+  }
+  size_type rfind(CharT ch, size_type pos = npos) const {
+    return rfind(&ch, pos, 1);
+  }
+
+  // the set of characters is s; for bytes it becomes a lookup table
+  size_type find_first_of(const basic_string& str, size_type pos = 0) const {
+    return find_first_of(str.data(), pos, str.size());
+  }
+  size_type find_first_of(const CharT* s, size_type pos,
+                          size_type count) const;
+  size_type find_first_of(const CharT* s, size_type pos = 0) const {
+    return find_first_of(s, pos, Traits::length(s));
+  }
+  size_type find_first_of(CharT ch, size_type pos = 0) const {
+    return find(ch, pos);
+  }
+  size_type find_last_of(const basic_string& str,
+                         size_type pos = npos) const {
+    return find_last_of(str.data(), pos, str.size());
+  }
+  size_type find_last_of(const CharT* s, size_type pos, size_type count) const;
+  size_type find_last_of(const CharT* s, size_type pos = npos) const {
+    return find_last_of(s, pos, Traits::length(s));
+  }
+  size_type find_last_of(CharT ch, size_type pos = npos) const {
+    return rfind(ch, pos);
+  }
+  size_type find_first_not_of(const basic_string& str,
+                              size_type pos = 0) const {
+    return find_first_not_of(str.data(), pos, str.size());
+  }
+  size_type find_first_not_of(const CharT* s, size_type pos,
+                              size_type count) const;
+  size_type find_first_not_of(const CharT* s, size_type pos = 0) const {
+    return find_first_not_of(s, pos, Traits::length(s));
+  }
+  size_type find_first_not_of(CharT ch, size_type pos = 0) const {
+    return find_first_not_of(&ch, pos, 1);
+  }
+  size_type find_last_not_of(const basic_string& str,
+                             size_type pos = npos) const {
+    return find_last_not_of(str.data(), pos, str.size());
+  }
+  size_type find_last_not_of(const CharT* s, size_type pos,
+                             size_type count) const;
+  size_type find_last_not_of(const CharT* s, size_type pos = npos) const {
+    return find_last_not_of(s, pos, Traits::length(s));
+  }
+  size_type find_last_not_of(CharT ch, size_type pos = npos) const {
+    return find_last_not_of(&ch, pos, 1);
+  }
+
+  // a prefix or suffix which shares the buffer of this string is found
+  // without comparing characters, neither needs data() of a concatenation
+  bool starts_with(const basic_string& str) const noexcept {
+    return str.size() <= size() && _has_at(0, str);
+  }
+  bool starts_with(const CharT* s) const noexcept {
+    const auto count = detail::bounded_length<Traits>(s, size() + 1);
+    return count <= size() && _compare_chars(0, s, count) == 0;
+  }
+  bool starts_with(CharT ch) const noexcept {
+    return !empty() && Traits::eq((*this)[0], ch);
+  }
+  bool ends_with(const basic_string& str) const noexcept {
+    return str.size() <= size() && _has_at(size() - str.size(), str);
+  }
+  bool ends_with(const CharT* s) const noexcept {
+    const auto count = Traits::length(s);
+    return count <= size() && _compare_chars(size() - count, s, count) == 0;
+  }
+  bool ends_with(CharT ch) const noexcept {
+    return !empty() && Traits::eq(back(), ch);
+  }
+  bool contains(const basic_string& str) const { return find(str) != npos; }
+  bool contains(const CharT* s) const { return find(s) != npos; }
+  bool contains(CharT ch) const { return find(ch) != npos; }
+
+#if defined(IMMUTABLE_STRING_STRING_VIEW)
+  size_type find(std::basic_string_view<CharT, Traits> sv,
+                 size_type pos = 0) const {
+    return find(sv.data(), pos, sv.size());
+  }
+  size_type rfind(std::basic_string_view<CharT, Traits> sv,
+                  size_type pos = npos) const {
+    return rfind(sv.data(), pos, sv.size());
+  }
+  size_type find_first_of(std::basic_string_view<CharT, Traits> sv,
+                          size_type pos = 0) const {
+    return find_first_of(sv.data(), pos, sv.size());
+  }
+  size_type find_last_of(std::basic_string_view<CharT, Traits> sv,
+                         size_type pos = npos) const {
+    return find_last_of(sv.data(), pos, sv.size());
+  }
+  size_type find_first_not_of(std::basic_string_view<CharT, Traits> sv,
+                              size_type pos = 0) const {
+    return find_first_not_of(sv.data(), pos, sv.size());
+  }
+  size_type find_last_not_of(std::basic_string_view<CharT, Traits> sv,
+                             size_type pos = npos) const {
+    return find_last_not_of(sv.data(), pos, sv.size());
+  }
+  bool starts_with(std::basic_string_view<CharT, Traits> sv) const noexcept {
+    return sv.size() <= size() && _compare_chars(0, sv.data(), sv.size()) == 0;
+  }
+  bool ends_with(std::basic_string_view<CharT, Traits> sv) const noexcept {
+    return sv.size() <= size() &&
+           _compare_chars(size() - sv.size(), sv.data(), sv.size()) == 0;
+  }
+  bool contains(std::basic_string_view<CharT, Traits> sv) const {
+    return find(sv) != npos;
+  }
+#endif
+
+  // O(1) for long results: the substring shares the characters of this
+  // string. Unless they are followed by a zero, the substring gets a small
+  // node of its own, where c_str() keeps a terminated copy
+  basic_string substr(size_type pos = 0, size_type count = npos) const;
+  // returns a string which owns exactly its characters,
+  // so a short slice doesn't keep a huge buffer alive
+  basic_string compact(const Allocator& alloc = Allocator()) const;
+
+  // O(1) for long results: the result refers to both strings, their
+  // characters are copied into one buffer by the first data() call.
+  // operator[], find, compare and hash don't need that buffer.
+  // Without alloc the allocator of this string's buffer is used, or else
+  // of str's; std::invalid_argument is thrown if neither has one and
+  // Allocator can't be default-constructed
+  basic_string concat(const basic_string& str) const {
+    return _concat(str, nullptr);
+  }
+  basic_string concat(const basic_string& str,
+                      const Allocator& alloc) const {
+    return _concat(str, &alloc);
+  }
+  basic_string& operator+=(const basic_string& str) {
+    return *this = concat(str);
+  }
+
+  // hash of characters; computed once for the whole buffer and cached in it
+  std::size_t hash() const noexcept;
+
+  // true for the canonical strings returned by intern(): two interned
+  // strings are equal only if they share the buffer, unless RefCount
+  // isn't thread-safe and so each thread has a pool of its own
+  bool is_interned() const noexcept;
 
   int compare(const basic_string& str) const noexcept;
   int compare(const CharT* s) const noexcept;
   int compare(size_type pos1, size_type count1, const CharT* s) const noexcept;
   int compare(size_type pos1, size_type count1, const CharT* s,
               size_type count2) const noexcept;
+#if defined(IMMUTABLE_STRING_STRING_VIEW)
+  int compare(std::basic_string_view<CharT, Traits> sv) const noexcept {
+    return compare(0, size(), sv.data(), sv.size());
+  }
+#endif
 
  private:
+  using rep_type = detail::rep_base<RefCount>;
+
+  template <class, class, class, class>
+  friend class basic_intern_pool;
+  template <class, class, class, class>
+  friend class basic_string_builder;
+  template <class>
+  friend class basic_arena;
+  template <class>
+  friend struct detail::concat_rep;
+  template <class>
+  friend struct detail::mapped_rep;
+  template <class>
+  friend struct detail::deserializer;
+  template <class>
+  friend struct detail::utf8_flags;
+  template <class C, class T, class A, class R>
+  friend bool operator==(const basic_string<C, T, A, R>& lhs,
+                         const basic_string<C, T, A, R>& rhs);
+  template <class C, class T, class A, class R>
+  friend basic_string<C, T, A, R> operator+(
+      const basic_string<C, T, A, R>& lhs, const C* rhs);
+  template <class C, class T, class A, class R>
+  friend basic_string<C, T, A, R> operator+(
+      const C* lhs, const basic_string<C, T, A, R>& rhs);
+
   void _throw_out_of_range() const { throw std::out_of_range("basic_string"); }
 
+  bool _is_inline() const noexcept { return m_size <= inline_capacity; }
+  // the characters are made by the buffer on demand, see lazy_rep
+  bool _is_lazy() const noexcept {
+    return !_is_inline() && m_storage.heap.data == nullptr;
+  }
+  // both strings are the same characters of the same buffer
+  bool _shares_chars(const basic_string& other) const noexcept {
+    return !_is_inline() && !other._is_inline() &&
+           m_storage.heap.data == other.m_storage.heap.data &&
+           m_storage.heap.rep == other.m_storage.heap.rep;
+  }
+  // data()[size()] is a terminating zero
+  bool _is_terminated() const noexcept {
+    const auto rep = _is_inline() ? nullptr : m_storage.heap.rep;
+    if (!rep || !rep->has_flag(rep_type::unterminated_flag)) return true;
+    const auto chars =
+        static_cast<detail::unterminated_rep<CharT, RefCount>*>(rep);
+    return m_storage.heap.data != chars->m_chars || size() != chars->m_count;
+  }
+  // slice of count characters at pos which aren't followed by a zero
+  basic_string _unterminated_slice(size_type pos, size_type count) const;
+  // alloc is nullptr to take the allocator of a buffer, see concat
+  basic_string _concat(const basic_string& str, const Allocator* alloc) const;
+  // the buffer of the characters keeps the allocator of the string
+  bool _has_allocator() const noexcept;
+  Allocator _allocator() const;
+  // alloc if set, or else the allocator of this string or of str
+  Allocator _allocator_for(const basic_string& str,
+                           const Allocator* alloc) const;
+  static Allocator _default_allocator(std::true_type) { return Allocator(); }
+  static Allocator _default_allocator(std::false_type) {
+    throw std::invalid_argument("basic_string: no allocator");
+  }
+  // string of count characters at s made by the allocator of this string
+  basic_string _make(const CharT* s, size_type count) const;
+  bool _is_whole() const noexcept {
+    return !_is_inline() && m_storage.heap.rep &&
+           m_storage.heap.rep->m_size == size();
+  }
+  // cached hash or 0 if it isn't computed yet
+  std::uint64_t _cached_hash() const noexcept {
+    return _is_whole()
+               ? m_storage.heap.rep->m_hash.load(std::memory_order_relaxed)
+               : 0;
+  }
+  const CharT* _lazy_data() const;
+  // f(const CharT* piece, size_type count) is called for the pieces of
+  // [pos, pos + count) and returns false to stop; returns false if stopped
+  template <class F>
+  bool _visit(size_type pos, size_type count, const F& f) const;
+  void _copy_chars(CharT* dest, size_type pos, size_type count) const
+      noexcept;
+  int _compare_chars(size_type pos, const CharT* s, size_type count) const
+      noexcept;
+  // str is at pos of this string, which has room for it
+  bool _has_at(size_type pos, const basic_string& str) const noexcept;
+  // search(hay, n) returns the position of a pattern of size count in hay
+  template <class Search>
+  size_type _find_pieces(size_type pos, size_type count,
+                         const Search& search) const;
+  std::uint64_t _compute_hash() const noexcept;
+
+  void _init_empty() noexcept;
+  // m_size shall fit inline
+  CharT* _init_inline() noexcept;
+  CharT* _init_storage(const Allocator& alloc);
+  // refers to characters stored elsewhere, m_size shall be set, long ones
+  // shall be null-terminated and live longer than the string and its copies
+  void _init_unowned(const CharT* s) noexcept;
+  void _init_copy(const basic_string& other) noexcept;
+  void _init_slice(const basic_string& other, size_type pos) noexcept;
+  void _init_move(basic_string& other) noexcept;
+  void _destroy() noexcept;
+
  private:
-  boost::shared_ptr<CharT[]> m_data;
+  struct heap_storage {
+    const CharT* data;
+    rep_type* rep;
+  };
+  union storage {
+    heap_storage heap;
+    CharT buf[inline_capacity + 1];
+  };
+  static_assert(sizeof(heap_storage) == sizeof(CharT) * (inline_capacity + 1),
+                "inline buffer shall reuse the space of heap pointers");
+
+  // the active member of m_storage is chosen by m_size only:
+  // buf if m_size <= inline_capacity, heap otherwise.
+  // heap.rep is null for characters which the string doesn't own,
+  // heap.data is null for lazy buffers
+  storage m_storage;
   size_type m_size;
 };
 
 using string = basic_string<char>;
 using wstring = basic_string<wchar_t>;
 
-template <class CharT, class Traits, class Allocator>
-const typename basic_string<CharT, Traits, Allocator>::size_type
-    basic_string<CharT, Traits, Allocator>::npos;
+template <class CharT, class Traits, class Allocator, class RefCount>
+const typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+    basic_string<CharT, Traits, Allocator, RefCount>::npos;
+template <class CharT, class Traits, class Allocator, class RefCount>
+const typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+    basic_string<CharT, Traits, Allocator, RefCount>::inline_capacity;
+
+namespace detail {
+
+// lazy concatenation of two strings; the flat copy of the characters is
+// made by the first data() call and lives as long as the node
+template <class String>
+struct concat_rep : lazy_rep<typename String::value_type,
+                             typename String::refcount_type> {
+  using CharT = typename String::value_type;
+  using Allocator = typename String::allocator_type;
+  using RefCount = typename String::refcount_type;
+  using base = lazy_rep<CharT, RefCount>;
+  using flat_type = heap_rep<CharT, Allocator, RefCount>;
+  using alloc_type = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<concat_rep>;
+  using alloc_traits = std::allocator_traits<alloc_type>;
+
+  concat_rep(const alloc_type& alloc, const String& left,
+             const String& right, unsigned depth) noexcept
+      : base(&concat_rep::_release, &concat_rep::_materialize,
+             left.size() + right.size()),
+        m_left(left),
+        m_right(right),
+        m_depth(depth),
+        m_alloc(alloc) {
+    this->set_flag(base::concat_flag);
+  }
+
+  static concat_rep* of(const String& str) noexcept {
+    return static_cast<concat_rep*>(str.m_storage.heap.rep);
+  }
+  static bool is_concat(const String& str) noexcept {
+    return !str._is_inline() && str.m_storage.heap.rep &&
+           str.m_storage.heap.rep->has_flag(base::concat_flag);
+  }
+
+  // concatenation of long strings, rebalanced if it gets too deep
+  static String make(const String& left, const String& right,
+                     const Allocator& alloc) {
+    const auto l = _flat_or_self(left);
+    const auto r = _flat_or_self(right);
+    const auto depth = 1 + std::max(_depth(l), _depth(r));
+    if (depth <= concat_max_depth) return _wrap(_create(alloc, l, r, depth));
+    std::vector<String> leaves;
+    _collect_leaves(l, leaves);
+    _collect_leaves(r, leaves);
+    return _build(leaves.data(), leaves.size(), alloc);
+  }
+
+  // the flat string if the characters are made already, str otherwise
+  static String _flat_or_self(const String& str) noexcept {
+    if (!is_concat(str)) return str;
+    const auto chars = of(str)->made_data();
+    if (!chars) return str;
+    String res;
+    res.m_size = str.size();
+    res.m_storage.heap.data = chars;
+    res.m_storage.heap.rep = flat_type::from_chars(chars);
+    acquire(res.m_storage.heap.rep);
+    return res;
+  }
 
-template <class CharT, class Traits, class Allocator>
-basic_string<CharT, Traits, Allocator>::basic_string() : basic_string("") {}
+  static unsigned _depth(const String& str) noexcept {
+    return is_concat(str) ? of(str)->m_depth : 0;
+  }
+
+  static void _collect_leaves(const String& str, std::vector<String>& res) {
+    const auto leaf = _flat_or_self(str);
+    if (!is_concat(leaf)) {
+      res.push_back(leaf);
+      return;
+    }
+    _collect_leaves(of(leaf)->m_left, res);
+    _collect_leaves(of(leaf)->m_right, res);
+  }
+
+  static String _build(const String* leaves, std::size_t count,
+                       const Allocator& alloc) {
+    if (count == 1) return leaves[0];
+    const auto left = _build(leaves, count / 2, alloc);
+    const auto right = _build(leaves + count / 2, count - count / 2, alloc);
+    const auto depth = 1 + std::max(_depth(left), _depth(right));
+    return _wrap(_create(alloc, left, right, depth));
+  }
+
+  static concat_rep* _create(const Allocator& alloc, const String& left,
+                             const String& right, unsigned depth) {
+    alloc_type node_alloc{alloc};
+    const auto mem = alloc_traits::allocate(node_alloc, 1);
+    stats_allocated(sizeof(concat_rep));
+    return new (mem) concat_rep(node_alloc, left, right, depth);
+  }
+
+  static String _wrap(concat_rep* rep) noexcept {
+    String res;
+    res.m_size = rep->m_size;
+    res.m_storage.heap.data = nullptr;
+    res.m_storage.heap.rep = rep;
+    return res;
+  }
 
-template <class CharT, class Traits, class Allocator>
-basic_string<CharT, Traits, Allocator>::basic_string(size_type count, CharT ch,
-                                                     const Allocator& alloc)
-    : m_data(boost::allocate_shared<CharT[]>(alloc, count + 1)), m_size(count) {
-  Traits::assign(m_data.get(), count, ch);
+  static const CharT* _materialize(base* lazy) {
+    const auto rep = static_cast<concat_rep*>(lazy);
+    const auto flat = flat_type::create(Allocator{rep->m_alloc}, rep->m_size);
+    const auto left_size = rep->m_left.size();
+    rep->m_left._copy_chars(flat->chars(), 0, left_size);
+    rep->m_right._copy_chars(flat->chars() + left_size, 0,
+                             rep->m_right.size());
+    const auto res = rep->publish(flat->chars());
+    if (res != flat->chars()) release<RefCount>(flat);
+    return res;
+  }
+
+  static void _release(typename base::base* rep_base) noexcept {
+    auto rep = static_cast<concat_rep*>(rep_base);
+    if (const auto chars = rep->made_data()) {
+      release<RefCount>(flat_type::from_chars(chars));
+    }
+    alloc_type node_alloc{std::move(rep->m_alloc)};
+    rep->~concat_rep();
+    alloc_traits::deallocate(node_alloc, rep, 1);
+    stats_freed(sizeof(concat_rep));
+  }
+
+  String m_left;
+  String m_right;
+  unsigned m_depth;
+  alloc_type m_alloc;
+};
+
+}  // namespace detail
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string() noexcept
+    : m_size(0) {
+  _init_empty();
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string(
+    size_type count, CharT ch, const Allocator& alloc)
+    : m_size(count) {
+  Traits::assign(_init_storage(alloc), count, ch);
 }
 
-template <class CharT, class Traits, class Allocator>
-basic_string<CharT, Traits, Allocator>::basic_string(const Allocator& alloc)
-    : basic_string("", alloc) {}
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string(
+    const Allocator&) noexcept
+    : m_size(0) {
+  _init_empty();
+}
 
-template <class CharT, class Traits, class Allocator>
-basic_string<CharT, Traits, Allocator>::basic_string(const CharT* s,
-                                                     const Allocator& alloc)
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string(
+    const CharT* s, const Allocator& alloc)
     : basic_string(s, Traits::length(s), alloc) {}
 
-template <class CharT, class Traits, class Allocator>
-basic_string<CharT, Traits, Allocator>::basic_string(const CharT* s,
-                                                     size_type count,
-                                                     const Allocator& alloc)
-    : m_data(boost::allocate_shared<CharT[]>(alloc, count + 1)), m_size(count) {
-  // allocate_shared returns value initialized array
-  // so, we don't need to fill last element with zero
-  Traits::copy(m_data.get(), s, count);
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string(
+    const CharT* s, size_type count, const Allocator& alloc)
+    : m_size(count) {
+  Traits::copy(_init_storage(alloc), s, count);
 }
 
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::const_reference
-    basic_string<CharT, Traits, Allocator>::operator[](size_type pos) const
-    noexcept {
-  return data()[pos];
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string(
+    const basic_string& other) noexcept
+    : m_size(other.m_size) {
+  _init_copy(other);
 }
 
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::const_reference
-basic_string<CharT, Traits, Allocator>::at(size_type pos) const {
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::basic_string(
+    basic_string&& other) noexcept
+    : m_size(other.m_size) {
+  _init_move(other);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::~basic_string() {
+  _destroy();
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>&
+basic_string<CharT, Traits, Allocator, RefCount>::operator=(
+    const basic_string& other) noexcept {
+  basic_string tmp{other};
+  return *this = std::move(tmp);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>&
+basic_string<CharT, Traits, Allocator, RefCount>::operator=(
+    basic_string&& other) noexcept {
+  if (this != &other) {
+    _destroy();
+    m_size = other.m_size;
+    _init_move(other);
+  }
+  return *this;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::from_static(
+    const CharT* s, size_type count) noexcept {
+  basic_string res;
+  res.m_size = count;
+  res._init_unowned(s);
+  return res;
+}
+
+// storage management
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string<CharT, Traits, Allocator, RefCount>::_init_empty() noexcept {
+  // empty strings are always inline: no allocation and no refcount,
+  // so default-constructed placeholders cost nothing to copy or destroy.
+  // the whole buffer is zeroed, so copies never read indeterminate values
+  Traits::assign(m_storage.buf, inline_capacity + 1, CharT());
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+CharT*
+basic_string<CharT, Traits, Allocator, RefCount>::_init_inline() noexcept {
+  detail::stats_created(m_size);
+  _init_empty();
+  return m_storage.buf;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+CharT* basic_string<CharT, Traits, Allocator, RefCount>::_init_storage(
+    const Allocator& alloc) {
+  if (_is_inline()) return _init_inline();
+  detail::stats_created(m_size);
+  const auto rep =
+      detail::heap_rep<CharT, Allocator, RefCount>::create(alloc, m_size);
+  m_storage.heap.data = rep->chars();
+  m_storage.heap.rep = rep;
+  return rep->chars();
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string<CharT, Traits, Allocator, RefCount>::_init_copy(
+    const basic_string& other) noexcept {
+  if (_is_inline()) {
+    Traits::copy(m_storage.buf, other.m_storage.buf, inline_capacity + 1);
+  } else {
+    m_storage.heap = other.m_storage.heap;
+    if (m_storage.heap.rep) detail::acquire(m_storage.heap.rep);
+  }
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string<CharT, Traits, Allocator, RefCount>::_init_unowned(
+    const CharT* s) noexcept {
+  detail::stats_created(m_size);
+  if (_is_inline()) {
+    _init_empty();
+    Traits::copy(m_storage.buf, s, m_size);
+  } else {
+    m_storage.heap.data = s;
+    m_storage.heap.rep = nullptr;
+  }
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string<CharT, Traits, Allocator, RefCount>::_init_slice(
+    const basic_string& other, size_type pos) noexcept {
+  if (_is_inline()) {
+    _init_empty();
+    other._copy_chars(m_storage.buf, pos, m_size);
+  } else {
+    m_storage.heap.data = other.m_storage.heap.data + pos;
+    m_storage.heap.rep = other.m_storage.heap.rep;
+    if (m_storage.heap.rep) detail::acquire(m_storage.heap.rep);
+  }
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string<CharT, Traits, Allocator, RefCount>::_init_move(
+    basic_string& other) noexcept {
+  if (_is_inline()) {
+    Traits::copy(m_storage.buf, other.m_storage.buf, inline_capacity + 1);
+  } else {
+    m_storage.heap = other.m_storage.heap;
+  }
+  // moved-from string is left empty
+  other.m_size = 0;
+  other._init_empty();
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string<CharT, Traits, Allocator, RefCount>::_destroy() noexcept {
+  if (!_is_inline() && m_storage.heap.rep) {
+    detail::release(m_storage.heap.rep);
+  }
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+const CharT* basic_string<CharT, Traits, Allocator, RefCount>::_lazy_data()
+    const {
+  return static_cast<detail::lazy_rep<CharT, RefCount>*>(m_storage.heap.rep)
+      ->data();
+}
+
+// pieces
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class F>
+void basic_string<CharT, Traits, Allocator, RefCount>::for_each_piece(
+    F f) const {
+  _visit(0, size(), [&f](const CharT* piece, size_type count) {
+    f(piece, count);
+    return true;
+  });
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class F>
+bool basic_string<CharT, Traits, Allocator, RefCount>::_visit(
+    size_type pos, size_type count, const F& f) const {
+  if (count == 0) return true;
+  if (!_is_lazy()) return f(data() + pos, count);
+  const auto rep = detail::concat_rep<basic_string>::of(*this);
+  if (const auto chars = rep->made_data()) return f(chars + pos, count);
+  const auto left_size = rep->m_left.size();
+  if (pos < left_size) {
+    const auto left_count = std::min(count, left_size - pos);
+    if (!rep->m_left._visit(pos, left_count, f)) return false;
+    pos += left_count;
+    count -= left_count;
+  }
+  return rep->m_right._visit(pos - left_size, count, f);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+void basic_string<CharT, Traits, Allocator, RefCount>::_copy_chars(
+    CharT* dest, size_type pos, size_type count) const noexcept {
+  _visit(pos, count, [&dest](const CharT* piece, size_type n) {
+    Traits::copy(dest, piece, n);
+    dest += n;
+    return true;
+  });
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::const_reference
+    basic_string<CharT, Traits, Allocator, RefCount>::operator[](
+        size_type pos) const {
+  // the terminator of a concatenation is in its flat copy only
+  if (!_is_lazy() || pos >= size()) return data()[pos];
+  const auto rep = detail::concat_rep<basic_string>::of(*this);
+  if (const auto chars = rep->made_data()) return chars[pos];
+  const auto left_size = rep->m_left.size();
+  return pos < left_size ? rep->m_left[pos] : rep->m_right[pos - left_size];
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::const_reference
+basic_string<CharT, Traits, Allocator, RefCount>::at(size_type pos) const {
   if (pos >= size()) _throw_out_of_range();
   return (*this)[pos];
 }
 
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::iterator
-basic_string<CharT, Traits, Allocator>::begin() const noexcept {
-  return m_data.get();
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::iterator
+basic_string<CharT, Traits, Allocator, RefCount>::begin() const {
+  return data();
 }
 
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::iterator
-basic_string<CharT, Traits, Allocator>::end() const noexcept {
-  return m_data.get() + size();
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::iterator
+basic_string<CharT, Traits, Allocator, RefCount>::end() const {
+  return data() + size();
 }
 
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::reverse_iterator
-basic_string<CharT, Traits, Allocator>::rbegin() const noexcept {
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::reverse_iterator
+basic_string<CharT, Traits, Allocator, RefCount>::rbegin() const {
   return reverse_iterator{end()};
 }
 
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::reverse_iterator
-basic_string<CharT, Traits, Allocator>::rend() const noexcept {
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::reverse_iterator
+basic_string<CharT, Traits, Allocator, RefCount>::rend() const {
   return reverse_iterator{begin()};
 }
 
 // find
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::size_type
-basic_string<CharT, Traits, Allocator>::find(const basic_string& str,
-                                             size_type pos) const {
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find(
+    const basic_string& str, size_type pos) const {
   return find(str.data(), pos, str.size());
 }
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::size_type
-basic_string<CharT, Traits, Allocator>::find(const CharT* s,
-                                             size_type pos) const {
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find(const CharT* s,
+                                                       size_type pos) const {
   return find(s, pos, Traits::length(s));
 }
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::size_type
-basic_string<CharT, Traits, Allocator>::find(CharT ch, size_type pos) const {
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find(CharT ch,
+                                                       size_type pos) const {
   return find(&ch, pos, 1);
 }
-template <class CharT, class Traits, class Allocator>
-typename basic_string<CharT, Traits, Allocator>::size_type
-basic_string<CharT, Traits, Allocator>::find(const CharT* s, size_type pos,
-                                             size_type count) const {
-  const auto is_equal = [s, count](const CharT* s2) {
-    for (size_type i = 0; i < count; ++i) {
-      if (s[i] != s2[i]) return false;
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find(
+    const CharT* s, size_type pos, size_type count) const {
+  if (pos > size()) return npos;
+  const auto search = [s, count](const CharT* hay, size_type n) {
+    return detail::search<CharT, Traits>(hay, n, s, count);
+  };
+  if (_is_lazy()) return _find_pieces(pos, count, search);
+  const auto res = search(data() + pos, size() - pos);
+  return res == detail::not_found ? npos : pos + res;
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find(
+    const basic_searcher<CharT, Traits>& searcher, size_type pos) const {
+  if (pos > size()) return npos;
+  const auto search = [&searcher](const CharT* hay, size_type n) {
+    const auto res = searcher.search(hay, n);
+    return res == searcher.npos ? detail::not_found : res;
+  };
+  if (_is_lazy()) return _find_pieces(pos, searcher.pattern().size(), search);
+  const auto res = search(data() + pos, size() - pos);
+  return res == detail::not_found ? npos : pos + res;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::rfind(
+    const CharT* s, size_type pos, size_type count) const {
+  if (count > size()) return npos;
+  const auto res =
+      detail::rsearch<CharT, Traits>(data(), size(), s, count, pos);
+  return res == detail::not_found ? npos : res;
+}
+
+// character sets
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find_first_of(
+    const CharT* s, size_type pos, size_type count) const {
+  if (pos >= size()) return npos;
+  const auto res = detail::find_of<CharT, Traits>(
+      data() + pos, size() - pos, s, count, true,
+      detail::is_byte_traits<CharT, Traits>{});
+  return res == detail::not_found ? npos : pos + res;
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find_last_of(
+    const CharT* s, size_type pos, size_type count) const {
+  if (empty()) return npos;
+  const auto res = detail::rfind_of<CharT, Traits>(
+      data(), std::min(pos, size() - 1) + 1, s, count, true,
+      detail::is_byte_traits<CharT, Traits>{});
+  return res == detail::not_found ? npos : res;
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find_first_not_of(
+    const CharT* s, size_type pos, size_type count) const {
+  if (pos >= size()) return npos;
+  const auto res = detail::find_of<CharT, Traits>(
+      data() + pos, size() - pos, s, count, false,
+      detail::is_byte_traits<CharT, Traits>{});
+  return res == detail::not_found ? npos : pos + res;
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::find_last_not_of(
+    const CharT* s, size_type pos, size_type count) const {
+  if (empty()) return npos;
+  const auto res = detail::rfind_of<CharT, Traits>(
+      data(), std::min(pos, size() - 1) + 1, s, count, false,
+      detail::is_byte_traits<CharT, Traits>{});
+  return res == detail::not_found ? npos : res;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+bool basic_string<CharT, Traits, Allocator, RefCount>::_has_at(
+    size_type pos, const basic_string& str) const noexcept {
+  if (str.size() == size()) return *this == str;
+  // a slice of the same buffer at the same place
+  if (!str._is_inline() && !_is_lazy() && !str._is_lazy() &&
+      m_storage.heap.data + pos == str.m_storage.heap.data) {
+    return true;
+  }
+  if (!str._is_lazy()) return _compare_chars(pos, str.data(), str.size()) == 0;
+  int res = 0;
+  str._visit(0, str.size(),
+             [this, &res, &pos](const CharT* piece, size_type n) {
+               res = _compare_chars(pos, piece, n);
+               pos += n;
+               return res == 0;
+             });
+  return res == 0;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class Search>
+typename basic_string<CharT, Traits, Allocator, RefCount>::size_type
+basic_string<CharT, Traits, Allocator, RefCount>::_find_pieces(
+    size_type pos, size_type count, const Search& search) const {
+  if (count == 0) return pos;
+  // the last count - 1 characters before the current piece: a match
+  // which starts there ends in the current piece or later
+  std::basic_string<CharT, Traits> carry;
+  std::basic_string<CharT, Traits> window;
+  auto res = npos;
+  auto offset = pos;
+  _visit(pos, size() - pos, [&](const CharT* piece, size_type n) {
+    if (!carry.empty()) {
+      window.assign(carry).append(piece, std::min(n, count - 1));
+      const auto found = search(window.data(), window.size());
+      if (found != detail::not_found && found < carry.size()) {
+        res = offset - carry.size() + found;
+        return false;
+      }
     }
+    const auto found = search(piece, n);
+    if (found != detail::not_found) {
+      res = offset + found;
+      return false;
+    }
+    if (n >= count - 1) {
+      carry.assign(piece + n - (count - 1), count - 1);
+    } else {
+      carry.append(piece, n);
+      if (carry.size() > count - 1) carry.erase(0, carry.size() - count + 1);
+    }
+    offset += n;
     return true;
-  };
+  });
+  return res;
+}
 
-  while (pos + count <= size()) {
-    if (is_equal(data() + pos)) return pos;
-    ++pos;
+// substr
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::substr(
+    size_type pos, size_type count) const {
+  if (pos > size()) _throw_out_of_range();
+  count = std::min(count, size() - pos);
+  if (_is_lazy() && count > inline_capacity) {
+    using concat_type = detail::concat_rep<basic_string>;
+    const auto flat = concat_type::_flat_or_self(*this);
+    if (!flat._is_lazy()) return flat.substr(pos, count);
+    if (count == size()) return *this;
+    const auto rep = concat_type::of(*this);
+    const auto left_size = rep->m_left.size();
+    if (pos + count <= left_size) return rep->m_left.substr(pos, count);
+    if (pos >= left_size) return rep->m_right.substr(pos - left_size, count);
+    return rep->m_left.substr(pos).concat(
+        rep->m_right.substr(0, pos + count - left_size),
+        Allocator{rep->m_alloc});
+  }
+  if (pos == 0 && count == size()) return *this;
+  // the character after a slice is readable unless the slice ends where
+  // the characters of a buffer without terminator end
+  const auto end = pos + count;
+  if (count > inline_capacity &&
+      !(end < size() ? data()[end] == CharT() : _is_terminated())) {
+    return _unterminated_slice(pos, count);
   }
-  return npos;
+  basic_string res;
+  res.m_size = count;
+  res._init_slice(*this, pos);
+  return res;
 }
 
-// compare
-template <class CharT, class Traits, class Allocator>
-int basic_string<CharT, Traits, Allocator>::compare(
-    const basic_string<CharT, Traits, Allocator>& str) const noexcept {
-  return compare(0, size(), str.data(), str.size());
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::_unterminated_slice(
+    size_type pos, size_type count) const {
+  using slice_type = detail::slice_rep<CharT, RefCount>;
+  auto owner = m_storage.heap.rep;
+  if (owner && owner->has_flag(rep_type::slice_flag)) {
+    owner = static_cast<slice_type*>(owner)->m_owner;
+  }
+  const auto chars = data() + pos;
+  using default_type = typename detail::default_allocator<Allocator>::type;
+  rep_type* const rep =
+      _has_allocator()
+          ? static_cast<rep_type*>(
+                detail::slice_node<CharT, Allocator, RefCount>::create(
+                    _allocator(), owner, chars, count))
+          : detail::slice_node<CharT, default_type, RefCount>::create(
+                default_type(), owner, chars, count);
+  basic_string res;
+  res.m_size = count;
+  res.m_storage.heap.data = chars;
+  res.m_storage.heap.rep = rep;
+  return res;
 }
-template <class CharT, class Traits, class Allocator>
-int basic_string<CharT, Traits, Allocator>::compare(const CharT* s) const
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::compact(
+    const Allocator& alloc) const {
+  if (_is_inline() || (_is_whole() && !_is_lazy())) return *this;
+  basic_string res;
+  res.m_size = size();
+  _copy_chars(res._init_storage(alloc), 0, size());
+  return res;
+}
+
+// concat
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::_concat(
+    const basic_string& str, const Allocator* alloc) const {
+  using concat_type = detail::concat_rep<basic_string>;
+  if (str.empty()) return *this;
+  if (empty()) return str;
+  const auto count = size() + str.size();
+  if (count * sizeof(CharT) <= detail::concat_copy_bytes) {
+    basic_string res;
+    res.m_size = count;
+    const auto dest = res._is_inline()
+                          ? res._init_inline()
+                          : res._init_storage(_allocator_for(str, alloc));
+    _copy_chars(dest, 0, size());
+    str._copy_chars(dest + size(), 0, str.size());
+    return res;
+  }
+  // a short string appended to a concatenation joins its last piece,
+  // so building a string by small appends doesn't make a node per append
+  if (_is_lazy()) {
+    const auto rep = concat_type::of(*this);
+    const auto& last = rep->m_right;
+    if (!rep->made_data() && !last._is_lazy() &&
+        (last.size() + str.size()) * sizeof(CharT) <=
+            detail::concat_copy_bytes) {
+      return concat_type::make(rep->m_left, last._concat(str, alloc),
+                               _allocator_for(str, alloc));
+    }
+  }
+  return concat_type::make(*this, str, _allocator_for(str, alloc));
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>
+basic_string<CharT, Traits, Allocator, RefCount>::_make(
+    const CharT* s, size_type count) const {
+  basic_string res;
+  res.m_size = count;
+  const auto dest =
+      res._is_inline()
+          ? res._init_inline()
+          : res._init_storage(_allocator_for(basic_string(), nullptr));
+  Traits::copy(dest, s, count);
+  return res;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+bool basic_string<CharT, Traits, Allocator, RefCount>::_has_allocator() const
     noexcept {
-  return compare(0, size(), s);
+  auto rep = _is_inline() ? nullptr : m_storage.heap.rep;
+  if (rep && rep->has_flag(rep_type::slice_flag)) {
+    rep = static_cast<detail::slice_rep<CharT, RefCount>*>(rep)->m_owner;
+  }
+  return rep &&
+         (rep->has_flag(rep_type::concat_flag) ||
+          detail::heap_rep<CharT, Allocator, RefCount>::is_heap(rep) ||
+          detail::growable_rep<CharT, Allocator, RefCount>::is_growable(rep));
 }
-template <class CharT, class Traits, class Allocator>
-int basic_string<CharT, Traits, Allocator>::compare(size_type pos1,
-                                                    size_type count1,
-                                                    const CharT* s) const
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+Allocator basic_string<CharT, Traits, Allocator, RefCount>::_allocator()
+    const {
+  auto rep = m_storage.heap.rep;
+  if (rep->has_flag(rep_type::slice_flag)) {
+    rep = static_cast<detail::slice_rep<CharT, RefCount>*>(rep)->m_owner;
+  }
+  if (rep->has_flag(rep_type::concat_flag)) {
+    return Allocator{
+        static_cast<detail::concat_rep<basic_string>*>(rep)->m_alloc};
+  }
+  using growable_type = detail::growable_rep<CharT, Allocator, RefCount>;
+  if (growable_type::is_growable(rep)) {
+    return Allocator{static_cast<growable_type*>(rep)->m_alloc};
+  }
+  return Allocator{
+      static_cast<detail::heap_rep<CharT, Allocator, RefCount>*>(rep)
+          ->m_alloc};
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+Allocator basic_string<CharT, Traits, Allocator, RefCount>::_allocator_for(
+    const basic_string& str, const Allocator* alloc) const {
+  if (alloc) return *alloc;
+  if (_has_allocator()) return _allocator();
+  if (str._has_allocator()) return str._allocator();
+  return _default_allocator(std::is_default_constructible<Allocator>{});
+}
+
+// hash
+template <class CharT, class Traits, class Allocator, class RefCount>
+std::size_t basic_string<CharT, Traits, Allocator, RefCount>::hash() const
     noexcept {
-  return compare(pos1, count1, s, Traits::length(s));
+  if (!_is_whole()) return _compute_hash();
+  auto res = _cached_hash();
+  if (res == 0) {
+    res = _compute_hash();
+    m_storage.heap.rep->m_hash.store(res, std::memory_order_relaxed);
+  }
+  return res;
 }
-template <class CharT, class Traits, class Allocator>
-int basic_string<CharT, Traits, Allocator>::compare(size_type pos1,
-                                                    size_type count1,
-                                                    const CharT* s,
-                                                    size_type count2) const
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+std::uint64_t
+basic_string<CharT, Traits, Allocator, RefCount>::_compute_hash() const
+    noexcept {
+  if (!_is_lazy()) return detail::hash_chars(data(), size());
+  detail::hash_stream stream{size() * sizeof(CharT)};
+  for_each_piece([&stream](const CharT* piece, size_type count) {
+    stream.update(piece, count * sizeof(CharT));
+  });
+  return detail::nonzero_hash(stream.finish());
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+bool basic_string<CharT, Traits, Allocator, RefCount>::is_interned() const
+    noexcept {
+  return _is_whole() &&
+         m_storage.heap.rep->has_flag(rep_type::interned_flag);
+}
+
+// compare
+template <class CharT, class Traits, class Allocator, class RefCount>
+int basic_string<CharT, Traits, Allocator, RefCount>::compare(
+    const basic_string& str) const noexcept {
+  if (!str._is_lazy()) return compare(0, size(), str.data(), str.size());
+  const auto rlen = std::min(size(), str.size());
+  int res = 0;
+  size_type pos = 0;
+  str._visit(0, rlen, [this, &res, &pos](const CharT* piece, size_type n) {
+    res = _compare_chars(pos, piece, n);
+    pos += n;
+    return res == 0;
+  });
+  if (res == 0) return size() - str.size();
+  return res;
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+int basic_string<CharT, Traits, Allocator, RefCount>::compare(
+    const CharT* s) const noexcept {
+  return compare(0, size(), s);
+}
+// lengths of C strings are only scanned up to count1 + 1 characters:
+// the result is the same for all the longer ones
+template <class CharT, class Traits, class Allocator, class RefCount>
+int basic_string<CharT, Traits, Allocator, RefCount>::compare(
+    size_type pos1, size_type count1, const CharT* s) const noexcept {
+  return compare(pos1, count1, s,
+                 detail::bounded_length<Traits>(s, count1 + 1));
+}
+template <class CharT, class Traits, class Allocator, class RefCount>
+int basic_string<CharT, Traits, Allocator, RefCount>::compare(
+    size_type pos1, size_type count1, const CharT* s, size_type count2) const
     noexcept {
   const auto rlen = std::min(count1, count2);
-  const auto res = Traits::compare(data() + pos1, s, rlen);
+  const auto res = _compare_chars(pos1, s, rlen);
   if (res == 0) return count1 - count2;
   return res;
 }
 
+template <class CharT, class Traits, class Allocator, class RefCount>
+int basic_string<CharT, Traits, Allocator, RefCount>::_compare_chars(
+    size_type pos, const CharT* s, size_type count) const noexcept {
+  int res = 0;
+  _visit(pos, count, [&res, &s](const CharT* piece, size_type n) {
+    res = detail::compare_chars<CharT, Traits>(
+        piece, s, n, detail::is_byte_traits<CharT, Traits>{});
+    s += n;
+    return res == 0;
+  });
+  return res;
+}
+
 // comparators
-template <class CharT, class Traits, class Alloc>
-bool operator==(const basic_string<CharT, Traits, Alloc>& lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
-  return lhs.size() == rhs.size() && lhs.compare(rhs) == 0;
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator==(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
+  if (lhs.size() != rhs.size()) return false;
+  if (lhs._shares_chars(rhs)) return true;
+  // equal strings interned by different threads have different buffers
+  if (RefCount::is_thread_safe && lhs.is_interned() && rhs.is_interned()) {
+    return false;
+  }
+  const auto lhs_hash = lhs._cached_hash();
+  const auto rhs_hash = rhs._cached_hash();
+  if (lhs_hash != 0 && rhs_hash != 0 && lhs_hash != rhs_hash) return false;
+  return lhs.compare(rhs) == 0;
 }
 
-template <class CharT, class Traits, class Alloc>
-bool operator!=(const basic_string<CharT, Traits, Alloc>& lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator!=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return !(lhs == rhs);
 }
 
-template <class CharT, class Traits, class Alloc>
-bool operator<(const basic_string<CharT, Traits, Alloc>& lhs,
-               const basic_string<CharT, Traits, Alloc>& rhs) {
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+               const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return lhs.compare(rhs) < 0;
 }
-template <class CharT, class Traits, class Alloc>
-bool operator<=(const basic_string<CharT, Traits, Alloc>& lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return lhs.compare(rhs) <= 0;
 }
 
-template <class CharT, class Traits, class Alloc>
-bool operator>(const basic_string<CharT, Traits, Alloc>& lhs,
-               const basic_string<CharT, Traits, Alloc>& rhs) {
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+               const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return lhs.compare(rhs) > 0;
 }
 
-template <class CharT, class Traits, class Alloc>
-bool operator>=(const basic_string<CharT, Traits, Alloc>& lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return lhs.compare(rhs) >= 0;
 }
 
-template <class CharT, class Traits, class Alloc>
-bool operator==(const basic_string<CharT, Traits, Alloc>& lhs,
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator==(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
                 const CharT* rhs) {
-  const auto rlen = Traits::length(rhs);
+  const auto rlen = detail::bounded_length<Traits>(rhs, lhs.size() + 1);
   return lhs.size() == rlen && lhs.compare(0, lhs.size(), rhs, rlen) == 0;
 }
-template <class CharT, class Traits, class Alloc>
-bool operator!=(const basic_string<CharT, Traits, Alloc>& lhs,
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator!=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
                 const CharT* rhs) {
   return !(lhs == rhs);
 }
 
-template <class CharT, class Traits, class Alloc>
+template <class CharT, class Traits, class Alloc, class RefCount>
 bool operator==(const CharT* lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return rhs == lhs;
 }
-template <class CharT, class Traits, class Alloc>
+template <class CharT, class Traits, class Alloc, class RefCount>
 bool operator!=(const CharT* lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return !(rhs == lhs);
 }
 
-template <class CharT, class Traits, class Alloc>
-bool operator<(const basic_string<CharT, Traits, Alloc>& lhs,
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
                const CharT* rhs) {
   return lhs.compare(rhs) < 0;
 }
-template <class CharT, class Traits, class Alloc>
-bool operator<=(const basic_string<CharT, Traits, Alloc>& lhs,
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
                 const CharT* rhs) {
   return lhs.compare(rhs) <= 0;
 }
-template <class CharT, class Traits, class Alloc>
-bool operator>(const basic_string<CharT, Traits, Alloc>& lhs,
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
                const CharT* rhs) {
   return lhs.compare(rhs) > 0;
 }
-template <class CharT, class Traits, class Alloc>
-bool operator>=(const basic_string<CharT, Traits, Alloc>& lhs,
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
                 const CharT* rhs) {
   return lhs.compare(rhs) >= 0;
 }
 
-template <class CharT, class Traits, class Alloc>
+template <class CharT, class Traits, class Alloc, class RefCount>
 bool operator<(const CharT* lhs,
-               const basic_string<CharT, Traits, Alloc>& rhs) {
+               const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return rhs > lhs;
 }
-template <class CharT, class Traits, class Alloc>
+template <class CharT, class Traits, class Alloc, class RefCount>
 bool operator<=(const CharT* lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return rhs >= lhs;
 }
-template <class CharT, class Traits, class Alloc>
+template <class CharT, class Traits, class Alloc, class RefCount>
 bool operator>(const CharT* lhs,
-               const basic_string<CharT, Traits, Alloc>& rhs) {
+               const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
   return rhs < lhs;
 }
-template <class CharT, class Traits, class Alloc>
+template <class CharT, class Traits, class Alloc, class RefCount>
 bool operator>=(const CharT* lhs,
-                const basic_string<CharT, Traits, Alloc>& rhs) {
+                const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
+  return rhs <= lhs;
+}
+
+#if defined(IMMUTABLE_STRING_STRING_VIEW)
+// views have their size, so comparing with them needs no strlen
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator==(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                std::basic_string_view<CharT, Traits> rhs) noexcept {
+  return lhs.size() == rhs.size() &&
+         lhs.compare(0, lhs.size(), rhs.data(), rhs.size()) == 0;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator!=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                std::basic_string_view<CharT, Traits> rhs) noexcept {
+  return !(lhs == rhs);
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator==(
+    std::basic_string_view<CharT, Traits> lhs,
+    const basic_string<CharT, Traits, Alloc, RefCount>& rhs) noexcept {
+  return rhs == lhs;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator!=(
+    std::basic_string_view<CharT, Traits> lhs,
+    const basic_string<CharT, Traits, Alloc, RefCount>& rhs) noexcept {
+  return !(rhs == lhs);
+}
+
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+               std::basic_string_view<CharT, Traits> rhs) noexcept {
+  return lhs.compare(rhs) < 0;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                std::basic_string_view<CharT, Traits> rhs) noexcept {
+  return lhs.compare(rhs) <= 0;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+               std::basic_string_view<CharT, Traits> rhs) noexcept {
+  return lhs.compare(rhs) > 0;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>=(const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+                std::basic_string_view<CharT, Traits> rhs) noexcept {
+  return lhs.compare(rhs) >= 0;
+}
+
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<(
+    std::basic_string_view<CharT, Traits> lhs,
+    const basic_string<CharT, Traits, Alloc, RefCount>& rhs) noexcept {
+  return rhs > lhs;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator<=(
+    std::basic_string_view<CharT, Traits> lhs,
+    const basic_string<CharT, Traits, Alloc, RefCount>& rhs) noexcept {
+  return rhs >= lhs;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>(
+    std::basic_string_view<CharT, Traits> lhs,
+    const basic_string<CharT, Traits, Alloc, RefCount>& rhs) noexcept {
+  return rhs < lhs;
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+bool operator>=(
+    std::basic_string_view<CharT, Traits> lhs,
+    const basic_string<CharT, Traits, Alloc, RefCount>& rhs) noexcept {
   return rhs <= lhs;
 }
+#endif
+
+// concatenation, O(1) for long strings, see basic_string::concat
+template <class CharT, class Traits, class Alloc, class RefCount>
+basic_string<CharT, Traits, Alloc, RefCount> operator+(
+    const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+    const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
+  return lhs.concat(rhs);
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+basic_string<CharT, Traits, Alloc, RefCount> operator+(
+    const basic_string<CharT, Traits, Alloc, RefCount>& lhs,
+    const CharT* rhs) {
+  return lhs.concat(lhs._make(rhs, Traits::length(rhs)));
+}
+template <class CharT, class Traits, class Alloc, class RefCount>
+basic_string<CharT, Traits, Alloc, RefCount> operator+(
+    const CharT* lhs,
+    const basic_string<CharT, Traits, Alloc, RefCount>& rhs) {
+  return rhs._make(lhs, Traits::length(lhs)).concat(rhs);
+}
+
+// "literal"_is, see basic_string::from_static
+inline namespace literals {
+
+inline string operator"" _is(const char* s, std::size_t count) noexcept {
+  return string::from_static(s, count);
+}
+inline wstring operator"" _is(const wchar_t* s, std::size_t count) noexcept {
+  return wstring::from_static(s, count);
+}
+inline basic_string<char16_t> operator"" _is(const char16_t* s,
+                                             std::size_t count) noexcept {
+  return basic_string<char16_t>::from_static(s, count);
+}
+inline basic_string<char32_t> operator"" _is(const char32_t* s,
+                                             std::size_t count) noexcept {
+  return basic_string<char32_t>::from_static(s, count);
+}
+
+}  // namespace literals
+
+// boost::hash support, found by ADL
+template <class CharT, class Traits, class Alloc, class RefCount>
+std::size_t hash_value(
+    const basic_string<CharT, Traits, Alloc, RefCount>& str) noexcept {
+  return str.hash();
+}
+
+// Hash and equality which also take C strings and views, so containers
+// with heterogeneous lookup (is_transparent) find string keys without
+// making a temporary string. Ordered containers can use std::less<>.
+template <class CharT, class Traits = std::char_traits<CharT>>
+struct basic_string_hash {
+  using is_transparent = void;
+
+  template <class A, class R>
+  std::size_t operator()(
+      const basic_string<CharT, Traits, A, R>& str) const noexcept {
+    return str.hash();
+  }
+  std::size_t operator()(const CharT* s) const noexcept {
+    return detail::hash_chars(s, Traits::length(s));
+  }
+#if defined(IMMUTABLE_STRING_STRING_VIEW)
+  std::size_t operator()(
+      std::basic_string_view<CharT, Traits> sv) const noexcept {
+    return detail::hash_chars(sv.data(), sv.size());
+  }
+#endif
+};
+
+template <class CharT, class Traits = std::char_traits<CharT>>
+struct basic_string_equal {
+  using is_transparent = void;
+
+  template <class A, class R>
+  bool operator()(const basic_string<CharT, Traits, A, R>& lhs,
+                  const basic_string<CharT, Traits, A, R>& rhs) const {
+    return lhs == rhs;
+  }
+  template <class A, class R>
+  bool operator()(const basic_string<CharT, Traits, A, R>& lhs,
+                  const CharT* rhs) const noexcept {
+    return lhs == rhs;
+  }
+  template <class A, class R>
+  bool operator()(const CharT* lhs,
+                  const basic_string<CharT, Traits, A, R>& rhs) const noexcept {
+    return rhs == lhs;
+  }
+#if defined(IMMUTABLE_STRING_STRING_VIEW)
+  template <class A, class R>
+  bool operator()(const basic_string<CharT, Traits, A, R>& lhs,
+                  std::basic_string_view<CharT, Traits> rhs) const noexcept {
+    return lhs == rhs;
+  }
+  template <class A, class R>
+  bool operator()(std::basic_string_view<CharT, Traits> lhs,
+                  const basic_string<CharT, Traits, A, R>& rhs) const noexcept {
+    return rhs == lhs;
+  }
+#endif
+};
+
+using string_hash = basic_string_hash<char>;
+using wstring_hash = basic_string_hash<wchar_t>;
+using string_equal = basic_string_equal<char>;
+using wstring_equal = basic_string_equal<wchar_t>;
 
 }  // namespace immutable_string
+
+namespace std {
+
+template <class CharT, class Traits, class Alloc, class RefCount>
+struct hash<immutable_string::basic_string<CharT, Traits, Alloc, RefCount>> {
+  std::size_t operator()(
+      const immutable_string::basic_string<CharT, Traits, Alloc, RefCount>& str)
+      const noexcept {
+    return str.hash();
+  }
+};
+
+}  // namespace std
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "immutable_string/builder.hpp"
+#include "immutable_string/string.hpp"
+
+namespace immutable_string {
+
+// Immutable column of strings packed into one buffer: the characters of
+// all the strings follow each other, each with a terminating zero, and an
+// array of offsets marks where they start. Scans over the column read
+// memory sequentially. Strings taken from the table share the buffer and
+// its refcount, so they may outlive the table.
+template <class CharT, class Traits = std::char_traits<CharT>,
+          class Allocator = std::allocator<CharT>,
+          class RefCount = atomic_refcount>
+class basic_string_table {
+ public:
+  using string_type = basic_string<CharT, Traits, Allocator, RefCount>;
+  using traits_type = Traits;
+  using value_type = CharT;
+  using allocator_type = Allocator;
+  using size_type = typename string_type::size_type;
+
+  static const size_type npos = static_cast<size_type>(-1);
+
+  explicit basic_string_table(const Allocator& alloc = Allocator())
+      : basic_string_table(static_cast<const CharT**>(nullptr),
+                           static_cast<const CharT**>(nullptr), alloc) {}
+  basic_string_table(std::initializer_list<string_type> strings,
+                     const Allocator& alloc = Allocator())
+      : basic_string_table(strings.begin(), strings.end(), alloc) {}
+  // elements of the range are const CharT* or have data() and size()
+  template <class InputIt>
+  basic_string_table(InputIt first, InputIt last,
+                     const Allocator& alloc = Allocator());
+
+  bool empty() const noexcept { return size() == 0; }
+  size_type size() const noexcept { return m_offsets.size() - 1; }
+
+  // the i-th string, which shares the buffer of the table
+  string_type operator[](size_type i) const {
+    return m_chars.substr(m_offsets[i], length(i));
+  }
+  string_type at(size_type i) const;
+
+  // characters of the i-th string, null-terminated; short tables keep
+  // them inline, so the pointer is valid while the table isn't moved
+  const CharT* data(size_type i) const {
+    return m_chars.data() + m_offsets[i];
+  }
+  size_type length(size_type i) const noexcept {
+    return m_offsets[i + 1] - m_offsets[i] - 1;
+  }
+  // characters of all the strings, each followed by a zero
+  const string_type& chars() const noexcept { return m_chars; }
+
+  // index of the first string from pos equal to [s, s + count), or npos
+  size_type find(const CharT* s, size_type pos, size_type count) const;
+  size_type find(const CharT* s, size_type pos = 0) const {
+    return find(s, pos, Traits::length(s));
+  }
+  template <class String>
+  size_type find(const String& str, size_type pos = 0) const {
+    return find(str.data(), pos, str.size());
+  }
+
+  // hashes of all the strings in order, equal to basic_string::hash()
+  std::vector<std::size_t> hashes() const;
+
+  // the table with its strings in ascending order; the characters are
+  // copied in that order, so scans of the result stay sequential
+  basic_string_table sorted(const Allocator& alloc = Allocator()) const;
+
+ private:
+  using builder_type =
+      basic_string_builder<CharT, Traits, Allocator, RefCount>;
+
+  static size_type _length(const CharT* s) { return Traits::length(s); }
+  template <class String>
+  static size_type _length(const String& str) {
+    return str.size();
+  }
+
+  static void _append(builder_type& builder, const CharT* s) {
+    builder.append(s);
+  }
+  template <class A, class R>
+  static void _append(builder_type& builder,
+                      const basic_string<CharT, Traits, A, R>& str) {
+    builder.append(str);
+  }
+  template <class String>
+  static void _append(builder_type& builder, const String& str) {
+    builder.append(str.data(), str.size());
+  }
+
+  // reserves the exact size when the range can be traversed twice
+  template <class InputIt>
+  static void _reserve(builder_type&, InputIt, InputIt,
+                       std::input_iterator_tag) {}
+  template <class ForwardIt>
+  static void _reserve(builder_type& builder, ForwardIt first,
+                       ForwardIt last, std::forward_iterator_tag);
+
+  string_type m_chars;
+  std::vector<size_type> m_offsets;
+};
+
+using string_table = basic_string_table<char>;
+using wstring_table = basic_string_table<wchar_t>;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+const typename basic_string_table<CharT, Traits, Allocator,
+                                  RefCount>::size_type
+    basic_string_table<CharT, Traits, Allocator, RefCount>::npos;
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class InputIt>
+basic_string_table<CharT, Traits, Allocator, RefCount>::basic_string_table(
+    InputIt first, InputIt last, const Allocator& alloc) {
+  builder_type builder{alloc};
+  _reserve(builder, first, last,
+           typename std::iterator_traits<InputIt>::iterator_category{});
+  m_offsets.push_back(0);
+  for (; first != last; ++first) {
+    _append(builder, *first);
+    builder.push_back(CharT());
+    m_offsets.push_back(builder.size());
+  }
+  m_chars = builder.freeze();
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+template <class ForwardIt>
+void basic_string_table<CharT, Traits, Allocator, RefCount>::_reserve(
+    builder_type& builder, ForwardIt first, ForwardIt last,
+    std::forward_iterator_tag) {
+  size_type total = 0;
+  for (; first != last; ++first) total += _length(*first) + 1;
+  builder.reserve(total);
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string_table<CharT, Traits, Allocator, RefCount>::string_type
+basic_string_table<CharT, Traits, Allocator, RefCount>::at(size_type i) const {
+  if (i >= size()) throw std::out_of_range("basic_string_table");
+  return (*this)[i];
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+typename basic_string_table<CharT, Traits, Allocator, RefCount>::size_type
+basic_string_table<CharT, Traits, Allocator, RefCount>::find(
+    const CharT* s, size_type pos, size_type count) const {
+  const auto chars = m_chars.data();
+  for (; pos < size(); ++pos) {
+    if (length(pos) == count &&
+        Traits::compare(chars + m_offsets[pos], s, count) == 0) {
+      return pos;
+    }
+  }
+  return npos;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+std::vector<std::size_t>
+basic_string_table<CharT, Traits, Allocator, RefCount>::hashes() const {
+  const auto chars = m_chars.data();
+  std::vector<std::size_t> res(size());
+  for (size_type i = 0; i < size(); ++i) {
+    res[i] = detail::hash_chars(chars + m_offsets[i], length(i));
+  }
+  return res;
+}
+
+template <class CharT, class Traits, class Allocator, class RefCount>
+basic_string_table<CharT, Traits, Allocator, RefCount>
+basic_string_table<CharT, Traits, Allocator, RefCount>::sorted(
+    const Allocator& alloc) const {
+  const auto chars = m_chars.data();
+  std::vector<size_type> order(size());
+  std::iota(order.begin(), order.end(), size_type{0});
+  std::sort(order.begin(), order.end(), [&](size_type lhs, size_type rhs) {
+    const auto lhs_size = length(lhs);
+    const auto rhs_size = length(rhs);
+    const auto res = detail::compare_chars<CharT, Traits>(
+        chars + m_offsets[lhs], chars + m_offsets[rhs],
+        std::min(lhs_size, rhs_size), detail::is_byte_traits<CharT, Traits>{});
+    return res != 0 ? res < 0 : lhs_size < rhs_size;
+  });
+
+  basic_string_table res{alloc};
+  builder_type builder{m_chars.size(), alloc};
+  for (const auto i : order) {
+    builder.append(chars + m_offsets[i], length(i) + 1);
+    res.m_offsets.push_back(builder.size());
+  }
+  res.m_chars = builder.freeze();
+  return res;
+}
+
+}  // namespace immutable_string
@@ -0,0 +1,592 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+
+#include "immutable_string/detail/search.hpp"
+#include "immutable_string/string.hpp"
+
+namespace immutable_string {
+
+// UTF-8 scans of strings of char. Their content never changes, so the
+// results for a whole heap buffer are cached in the flags of its rep and
+// each buffer is scanned at most once; slices of an ASCII buffer are
+// known to be ASCII too. Inline strings and strings over unowned
+// characters have no rep and are scanned every time, which is cheap for
+// the former. Case-insensitive operations fold ASCII letters only and
+// compare other bytes as they are, so they never decode: they are exact
+// for ASCII strings, see utf8::is_ascii.
+
+namespace detail {
+// the kernels depend on the instruction set, see detail/search.hpp
+inline namespace IMMUTABLE_STRING_ISA {
+
+inline unsigned count_bits(std::uint32_t x) noexcept {
+#if defined(_MSC_VER)
+  return __popcnt(x);
+#else
+  return __builtin_popcount(x);
+#endif
+}
+
+// length of the prefix of s made of whole blocks of ASCII bytes
+inline std::size_t ascii_prefix(const unsigned char* s,
+                                std::size_t n) noexcept {
+  std::size_t i = 0;
+#if defined(IMMUTABLE_STRING_AVX2)
+  for (; i + 32 <= n; i += 32) {
+    const auto block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+    if (_mm256_movemask_epi8(block) != 0) return i;
+  }
+#endif
+#if defined(IMMUTABLE_STRING_SSE2)
+  for (; i + 16 <= n; i += 16) {
+    const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    if (_mm_movemask_epi8(block) != 0) return i;
+  }
+#endif
+  for (; i + 8 <= n; i += 8) {
+    std::uint64_t word;
+    std::memcpy(&word, s + i, 8);
+    if ((word & 0x8080808080808080ULL) != 0) return i;
+  }
+  return i;
+}
+
+inline bool is_ascii(const unsigned char* s, std::size_t n) noexcept {
+  for (auto i = ascii_prefix(s, n); i < n; ++i) {
+    if (s[i] >= 0x80) return false;
+  }
+  return true;
+}
+
+// number of bytes which aren't continuation bytes 10xxxxxx
+inline std::size_t count_code_points(const unsigned char* s,
+                                     std::size_t n) noexcept {
+  std::size_t res = 0;
+  std::size_t i = 0;
+#if defined(IMMUTABLE_STRING_AVX2)
+  // as signed bytes continuation bytes are -128..-65, the others greater
+  const auto last_continuation = _mm256_set1_epi8(-65);
+  for (; i + 32 <= n; i += 32) {
+    const auto block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+    res += count_bits(static_cast<std::uint32_t>(_mm256_movemask_epi8(
+        _mm256_cmpgt_epi8(block, last_continuation))));
+  }
+#endif
+#if defined(IMMUTABLE_STRING_SSE2)
+  const auto last_continuation_16 = _mm_set1_epi8(-65);
+  for (; i + 16 <= n; i += 16) {
+    const auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+    res += count_bits(static_cast<std::uint32_t>(
+        _mm_movemask_epi8(_mm_cmpgt_epi8(block, last_continuation_16))));
+  }
+#endif
+  for (; i < n; ++i) res += (s[i] & 0xc0) != 0x80;
+  return res;
+}
+
+#if defined(IMMUTABLE_STRING_AVX2)
+// The lookup algorithm of Keiser and Lemire, "Validating UTF-8 in less
+// than one instruction per byte": the high and low nibbles of each byte
+// and the high nibble of the next one index tables of the errors they may
+// form, and a pair is an error if all three agree on one.
+struct utf8_tables {
+  enum : unsigned char {
+    too_short = 1 << 0,  // lead byte not followed by a continuation
+    too_long = 1 << 1,   // continuation after ASCII
+    overlong_3 = 1 << 2,
+    too_large = 1 << 3,  // above U+10FFFF
+    surrogate = 1 << 4,
+    overlong_2 = 1 << 5,
+    too_large_1000 = 1 << 6,
+    overlong_4 = 1 << 6,
+    two_conts = 1 << 7,  // continuation after continuation, maybe valid
+    carry = too_short | too_long | two_conts,
+  };
+
+  static __m256i _table(std::initializer_list<unsigned char> bytes) noexcept {
+    unsigned char table[16];
+    std::copy(bytes.begin(), bytes.end(), table);
+    return _mm256_broadcastsi128_si256(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(table)));
+  }
+
+  utf8_tables() noexcept
+      : byte_1_high(_table({too_long, too_long, too_long, too_long, too_long,
+                            too_long, too_long, too_long, two_conts,
+                            two_conts, two_conts, two_conts,
+                            too_short | overlong_2, too_short,
+                            too_short | overlong_3 | surrogate,
+                            too_short | too_large | too_large_1000 |
+                                overlong_4})),
+        byte_1_low(_table({carry | overlong_3 | overlong_2 | overlong_4,
+                           carry | overlong_2, carry, carry,
+                           carry | too_large,
+                           carry | too_large | too_large_1000,
+                           carry | too_large | too_large_1000,
+                           carry | too_large | too_large_1000,
+                           carry | too_large | too_large_1000,
+                           carry | too_large | too_large_1000,
+                           carry | too_large | too_large_1000,
+                           carry | too_large | too_large_1000,
+                           carry | too_large | too_large_1000,
+                           carry | too_large | too_large_1000 | surrogate,
+                           carry | too_large | too_large_1000,
+                           carry | too_large | too_large_1000})),
+        byte_2_high(_table(
+            {too_short, too_short, too_short, too_short, too_short, too_short,
+             too_short, too_short,
+             too_long | overlong_2 | two_conts | overlong_3 | too_large_1000 |
+                 overlong_4,
+             too_long | overlong_2 | two_conts | overlong_3 | too_large,
+             too_long | overlong_2 | two_conts | surrogate | too_large,
+             too_long | overlong_2 | two_conts | surrogate | too_large,
+             too_short, too_short, too_short, too_short})) {}
+
+  // errors of the bytes of block, prev is the block before it
+  __m256i errors(__m256i block, __m256i prev) const noexcept {
+    const auto nibble = _mm256_set1_epi8(0x0f);
+    // the 16 bytes in front of each lane of block
+    const auto before = _mm256_permute2x128_si256(prev, block, 0x21);
+    const auto prev1 = _mm256_alignr_epi8(block, before, 15);
+    const auto special = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(
+                byte_1_high,
+                _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+            _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nibble))),
+        _mm256_shuffle_epi8(
+            byte_2_high,
+            _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble)));
+    // the third and the fourth bytes of sequences shall be continuations,
+    // where the tables see two_conts
+    const auto prev2 = _mm256_alignr_epi8(block, before, 14);
+    const auto prev3 = _mm256_alignr_epi8(block, before, 13);
+    const auto third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xe0 - 0x80));
+    const auto fourth =
+        _mm256_subs_epu8(prev3, _mm256_set1_epi8(char(0xf0 - 0x80)));
+    const auto must_be_continuation = _mm256_and_si256(
+        _mm256_or_si256(third, fourth), _mm256_set1_epi8(char(0x80)));
+    return _mm256_xor_si256(must_be_continuation, special);
+  }
+
+  __m256i byte_1_high;
+  __m256i byte_1_low;
+  __m256i byte_2_high;
+};
+#endif
+
+// Validates the prefix of s in whole blocks up to the start of the last
+// sequence which may go on past them; returns its length or not_found if
+// the prefix isn't valid. s shall start at the start of a sequence.
+inline std::size_t utf8_blocks(const unsigned char* s, std::size_t n,
+                               bool& ascii) noexcept {
+#if defined(IMMUTABLE_STRING_AVX2)
+  if (n < 32) return 0;
+  const utf8_tables tables;
+  auto prev = _mm256_setzero_si256();
+  auto error = _mm256_setzero_si256();
+  // bytes of prev which may start a sequence going on past it
+  auto open = _mm256_setzero_si256();
+  const auto open_limits = _mm256_setr_epi8(
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, char(0xf0 - 1),
+      char(0xe0 - 1), char(0xc0 - 1));
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const auto block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+    if (_mm256_movemask_epi8(block) == 0 && _mm256_testz_si256(open, open)) {
+      prev = block;
+      continue;
+    }
+    ascii = false;
+    error = _mm256_or_si256(error, tables.errors(block, prev));
+    open = _mm256_subs_epu8(block, open_limits);
+    prev = block;
+  }
+  if (!_mm256_testz_si256(error, error)) return not_found;
+  // up to 3 continuations may follow the lead byte of the last sequence
+  std::size_t back = 0;
+  while (back < 3 && (s[i - 1 - back] & 0xc0) == 0x80) ++back;
+  const auto lead = s[i - 1 - back];
+  const std::size_t length =
+      lead < 0xc0 ? 1 : lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : 4;
+  return length > back + 1 ? i - 1 - back : i;
+#else
+  (void)ascii;
+  return ascii_prefix(s, n);
+#endif
+}
+
+// UTF-8 validation of input coming in pieces, which may split sequences
+class utf8_validator {
+ public:
+  // false if the input seen so far isn't the start of valid UTF-8
+  bool update(const unsigned char* s, std::size_t n) noexcept;
+  // the input is valid UTF-8
+  bool finish() const noexcept { return m_valid && m_pending == 0; }
+  // all bytes so far are ASCII
+  bool ascii() const noexcept { return m_ascii; }
+
+ private:
+  bool _step(unsigned char c) noexcept;
+
+  // continuation bytes the current sequence still needs
+  unsigned m_pending = 0;
+  // range of the next continuation byte
+  unsigned char m_low = 0x80;
+  unsigned char m_high = 0xbf;
+  bool m_valid = true;
+  bool m_ascii = true;
+};
+
+inline bool utf8_validator::update(const unsigned char* s,
+                                   std::size_t n) noexcept {
+  if (!m_valid) return false;
+  for (std::size_t i = 0; i < n;) {
+    if (m_pending == 0) {
+      const auto done = utf8_blocks(s + i, n - i, m_ascii);
+      if (done == not_found) return m_valid = false;
+      i += done;
+      if (i == n) break;
+    }
+    if (!_step(s[i++])) return m_valid = false;
+  }
+  return true;
+}
+
+inline bool utf8_validator::_step(unsigned char c) noexcept {
+  if (m_pending != 0) {
+    if (c < m_low || c > m_high) return false;
+    --m_pending;
+    m_low = 0x80;
+    m_high = 0xbf;
+    return true;
+  }
+  if (c < 0x80) return true;
+  m_ascii = false;
+  if (c < 0xc2) return false;  // continuation or overlong 2-byte lead
+  if (c < 0xe0) {
+    m_pending = 1;
+  } else if (c < 0xf0) {
+    m_pending = 2;
+    if (c == 0xe0) m_low = 0xa0;   // overlong
+    if (c == 0xed) m_high = 0x9f;  // surrogates
+  } else if (c < 0xf5) {
+    m_pending = 3;
+    if (c == 0xf0) m_low = 0x90;   // overlong
+    if (c == 0xf4) m_high = 0x8f;  // above U+10FFFF
+  } else {
+    return false;
+  }
+  return true;
+}
+
+inline unsigned char fold_ascii(unsigned char c) noexcept {
+  return static_cast<unsigned>(c - 'A') < 26 ? c + ('a' - 'A') : c;
+}
+
+#if defined(IMMUTABLE_STRING_SSE2)
+inline __m128i fold_ascii(__m128i block) noexcept {
+  // signed comparisons, bytes from 0x80 aren't letters either way
+  const auto upper =
+      _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('A' - 1)),
+                    _mm_cmplt_epi8(block, _mm_set1_epi8('Z' + 1)));
+  return _mm_add_epi8(block,
+                      _mm_and_si128(upper, _mm_set1_epi8('a' - 'A')));
+}
+#endif
+
+inline int compare_icase(const unsigned char* a, const unsigned char* b,
+                         std::size_t n) noexcept {
+  std::size_t i = 0;
+#if defined(IMMUTABLE_STRING_SSE2)
+  for (; i + 16 <= n; i += 16) {
+    const auto eq = _mm_cmpeq_epi8(
+        fold_ascii(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i))),
+        fold_ascii(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))));
+    const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(eq));
+    if (mask != 0xffff) {
+      i += count_trailing_zeros(~mask);
+      break;
+    }
+  }
+#endif
+  for (; i < n; ++i) {
+    const auto x = fold_ascii(a[i]);
+    const auto y = fold_ascii(b[i]);
+    if (x != y) return x < y ? -1 : 1;
+  }
+  return 0;
+}
+
+// candidates are the positions of the first byte of the needle in either
+// case, checked by comparing the rest of it
+inline std::size_t find_icase(const unsigned char* hay, std::size_t n,
+                              const unsigned char* needle,
+                              std::size_t m) noexcept {
+  if (m == 0) return 0;
+  if (m > n) return not_found;
+  const auto lower = fold_ascii(needle[0]);
+  const auto upper = static_cast<unsigned>(lower - 'a') < 26
+                         ? static_cast<unsigned char>(lower - ('a' - 'A'))
+                         : lower;
+  const auto last = n - m;
+  std::size_t i = 0;
+#if defined(IMMUTABLE_STRING_SSE2)
+  const auto lower_16 = _mm_set1_epi8(static_cast<char>(lower));
+  const auto upper_16 = _mm_set1_epi8(static_cast<char>(upper));
+  for (; i + 16 <= last + 1; i += 16) {
+    const auto block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(hay + i));
+    auto mask = static_cast<std::uint32_t>(
+        _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, lower_16),
+                                       _mm_cmpeq_epi8(block, upper_16))));
+    while (mask != 0) {
+      const auto pos = i + count_trailing_zeros(mask);
+      if (compare_icase(hay + pos + 1, needle + 1, m - 1) == 0) return pos;
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; i <= last; ++i) {
+    if ((hay[i] == lower || hay[i] == upper) &&
+        compare_icase(hay + i + 1, needle + 1, m - 1) == 0) {
+      return i;
+    }
+  }
+  return not_found;
+}
+
+}  // namespace IMMUTABLE_STRING_ISA
+
+// Access to the cached flags of the buffer of a string
+template <class String>
+struct utf8_flags {
+  using rep_type = rep_base<typename String::refcount_type>;
+
+  // the flags of the buffer, nullptr if the string has none
+  static rep_type* buffer(const String& str) noexcept {
+    return str._is_inline() ? nullptr : str.m_storage.heap.rep;
+  }
+  // the flags of the buffer if they hold for the string too
+  static rep_type* whole(const String& str) noexcept {
+    return str._is_whole() ? str.m_storage.heap.rep : nullptr;
+  }
+
+  // the flags of the buffer loaded at once, 0 if it has none
+  static unsigned load(const String& str) noexcept {
+    const auto rep = buffer(str);
+    return rep ? rep->load_flags() : 0;
+  }
+
+  // the result is set with the flag which marks it as valid
+  static void set_ascii(rep_type* rep, bool ascii) noexcept {
+    unsigned flags = rep_type::ascii_checked_flag;
+    if (ascii) flags |= rep_type::ascii_flag;
+    rep->set_flag(flags);
+  }
+  static void set_utf8(rep_type* rep, bool valid) noexcept {
+    unsigned flags = rep_type::utf8_checked_flag;
+    if (valid) flags |= rep_type::utf8_flag;
+    rep->set_flag(flags);
+  }
+};
+
+template <class Traits, class Allocator, class RefCount>
+using byte_string = basic_string<char, Traits, Allocator, RefCount>;
+
+}  // namespace detail
+
+namespace utf8 {
+
+// all characters are ASCII
+template <class Traits, class Allocator, class RefCount>
+bool is_ascii(
+    const detail::byte_string<Traits, Allocator, RefCount>& str) noexcept {
+  using flags = detail::utf8_flags<
+      detail::byte_string<Traits, Allocator, RefCount>>;
+  using rep_type = typename flags::rep_type;
+  const auto known = flags::load(str);
+  if (known & rep_type::ascii_flag) return true;
+  const auto whole = flags::whole(str);
+  if (whole && (known & rep_type::ascii_checked_flag)) return false;
+  bool res = true;
+  str.for_each_piece([&res](const char* piece, std::size_t count) {
+    res = res && detail::is_ascii(
+                     reinterpret_cast<const unsigned char*>(piece), count);
+  });
+  if (whole) flags::set_ascii(whole, res);
+  return res;
+}
+
+// the characters are valid UTF-8: no overlong forms, surrogates or
+// code points above U+10FFFF
+template <class Traits, class Allocator, class RefCount>
+bool is_valid(
+    const detail::byte_string<Traits, Allocator, RefCount>& str) noexcept {
+  using flags = detail::utf8_flags<
+      detail::byte_string<Traits, Allocator, RefCount>>;
+  using rep_type = typename flags::rep_type;
+  const auto known = flags::load(str);
+  if (known & rep_type::ascii_flag) return true;
+  const auto whole = flags::whole(str);
+  if (whole && (known & rep_type::utf8_checked_flag)) {
+    return (known & rep_type::utf8_flag) != 0;
+  }
+  detail::utf8_validator validator;
+  str.for_each_piece([&validator](const char* piece, std::size_t count) {
+    validator.update(reinterpret_cast<const unsigned char*>(piece), count);
+  });
+  if (whole) {
+    flags::set_utf8(whole, validator.finish());
+    flags::set_ascii(whole, validator.ascii());
+  }
+  return validator.finish();
+}
+
+// number of code points of valid UTF-8, O(1) for ASCII strings known to be
+template <class Traits, class Allocator, class RefCount>
+std::size_t length(
+    const detail::byte_string<Traits, Allocator, RefCount>& str) noexcept {
+  using flags = detail::utf8_flags<
+      detail::byte_string<Traits, Allocator, RefCount>>;
+  if (flags::load(str) & flags::rep_type::ascii_flag) return str.size();
+  std::size_t res = 0;
+  str.for_each_piece([&res](const char* piece, std::size_t count) {
+    res += detail::count_code_points(
+        reinterpret_cast<const unsigned char*>(piece), count);
+  });
+  return res;
+}
+
+// String of count characters at s which are validated first; throws
+// std::invalid_argument if they aren't UTF-8. The result is known to be
+// valid, so is_valid and is_ascii of it are O(1).
+template <class String = string>
+String validated(const char* s, std::size_t count,
+                 const typename String::allocator_type& alloc =
+                     typename String::allocator_type()) {
+  static_assert(sizeof(typename String::value_type) == 1,
+                "UTF-8 is made of bytes");
+  detail::utf8_validator validator;
+  validator.update(reinterpret_cast<const unsigned char*>(s), count);
+  if (!validator.finish()) throw std::invalid_argument("utf8::validated");
+  String res{s, count, alloc};
+  using flags = detail::utf8_flags<String>;
+  if (const auto whole = flags::whole(res)) {
+    flags::set_utf8(whole, true);
+    flags::set_ascii(whole, validator.ascii());
+  }
+  return res;
+}
+template <class String = string>
+String validated(const char* s, const typename String::allocator_type& alloc =
+                                    typename String::allocator_type()) {
+  return validated<String>(s, std::strlen(s), alloc);
+}
+
+// compares as compare() does with ASCII letters folded to lower case;
+// like data(), these flatten concatenations
+template <class Traits, class Allocator, class RefCount>
+int compare_icase(const detail::byte_string<Traits, Allocator, RefCount>& lhs,
+                  const char* s, std::size_t count) {
+  const auto size = lhs.size();
+  const auto res = detail::compare_icase(
+      reinterpret_cast<const unsigned char*>(lhs.data()),
+      reinterpret_cast<const unsigned char*>(s), size < count ? size : count);
+  if (res != 0) return res;
+  return size < count ? -1 : size > count ? 1 : 0;
+}
+template <class Traits, class Allocator, class RefCount>
+int compare_icase(const detail::byte_string<Traits, Allocator, RefCount>& lhs,
+                  const char* s) {
+  return compare_icase(lhs, s, std::strlen(s));
+}
+template <class Traits, class Allocator, class RefCount>
+int compare_icase(
+    const detail::byte_string<Traits, Allocator, RefCount>& lhs,
+    const detail::byte_string<Traits, Allocator, RefCount>& rhs) {
+  return compare_icase(lhs, rhs.data(), rhs.size());
+}
+
+template <class Traits, class Allocator, class RefCount>
+bool equal_icase(
+    const detail::byte_string<Traits, Allocator, RefCount>& lhs,
+    const detail::byte_string<Traits, Allocator, RefCount>& rhs) {
+  return lhs.size() == rhs.size() && compare_icase(lhs, rhs) == 0;
+}
+
+// position of the first occurrence of count characters at s from pos
+// with ASCII letters in any case, npos if there is none
+template <class Traits, class Allocator, class RefCount>
+std::size_t find_icase(
+    const detail::byte_string<Traits, Allocator, RefCount>& str,
+    const char* s, std::size_t pos, std::size_t count) {
+  if (pos > str.size()) return std::string::npos;
+  const auto found = detail::find_icase(
+      reinterpret_cast<const unsigned char*>(str.data()) + pos,
+      str.size() - pos, reinterpret_cast<const unsigned char*>(s), count);
+  return found == detail::not_found ? std::string::npos : pos + found;
+}
+template <class Traits, class Allocator, class RefCount>
+std::size_t find_icase(
+    const detail::byte_string<Traits, Allocator, RefCount>& str,
+    const char* s, std::size_t pos = 0) {
+  return find_icase(str, s, pos, std::strlen(s));
+}
+template <class Traits, class Allocator, class RefCount>
+std::size_t find_icase(
+    const detail::byte_string<Traits, Allocator, RefCount>& str,
+    const detail::byte_string<Traits, Allocator, RefCount>& needle,
+    std::size_t pos = 0) {
+  return find_icase(str, needle.data(), pos, needle.size());
+}
+
+// hash equal for strings which equal_icase says are equal
+template <class Traits, class Allocator, class RefCount>
+std::size_t hash_icase(
+    const detail::byte_string<Traits, Allocator, RefCount>& str) noexcept {
+  detail::hash_stream stream{str.size()};
+  str.for_each_piece([&stream](const char* piece, std::size_t count) {
+    unsigned char folded[64];
+    while (count != 0) {
+      const auto chunk = count < sizeof(folded) ? count : sizeof(folded);
+      for (std::size_t i = 0; i < chunk; ++i) {
+        folded[i] =
+            detail::fold_ascii(static_cast<unsigned char>(piece[i]));
+      }
+      stream.update(folded, chunk);
+      piece += chunk;
+      count -= chunk;
+    }
+  });
+  return static_cast<std::size_t>(detail::nonzero_hash(stream.finish()));
+}
+
+// hasher and key equality of unordered containers ignoring ASCII case
+struct icase_hash {
+  template <class String>
+  std::size_t operator()(const String& str) const noexcept {
+    return hash_icase(str);
+  }
+};
+struct icase_equal {
+  template <class String>
+  bool operator()(const String& lhs, const String& rhs) const {
+    return equal_icase(lhs, rhs);
+  }
+};
+
+}  // namespace utf8
+
+}  // namespace immutable_string
@@ -0,0 +1,137 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/algorithm.hpp"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace immutable_string;
+
+namespace {
+
+// strings with common prefixes of different lengths, many of them equal
+std::vector<std::string> random_values(std::size_t count) {
+  std::mt19937 gen{23};
+  std::uniform_int_distribution<int> prefix_dist{0, 12};
+  std::uniform_int_distribution<int> size_dist{0, 6};
+  std::uniform_int_distribution<int> char_dist{'a', 'c'};
+  std::vector<std::string> res;
+  for (std::size_t i = 0; i < count; ++i) {
+    std::string value(prefix_dist(gen), '/');
+    for (int j = size_dist(gen); j > 0; --j) {
+      value += static_cast<char>(char_dist(gen));
+    }
+    if (i % 7 == 0) value += std::string(20, '\xff');
+    res.push_back(value);
+  }
+  return res;
+}
+
+template <class String>
+std::vector<String> to_strings(const std::vector<std::string>& values) {
+  std::vector<String> res;
+  for (const auto& value : values) {
+    res.push_back(String{value.data(), value.size()});
+  }
+  return res;
+}
+
+bool same_values(const std::vector<string>& strings,
+                 const std::vector<std::string>& values) {
+  if (strings.size() != values.size()) return false;
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    if (strings[i].compare(0, strings[i].size(), values[i].data(),
+                           values[i].size()) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+SCENARIO("sorting many strings", "[algorithm]") {
+  GIVEN("random strings with common prefixes") {
+    auto values = random_values(40000);
+    auto strings = to_strings<string>(values);
+    std::sort(values.begin(), values.end());
+
+    THEN("one thread sorts them as std::sort does") {
+      algorithm::sort(strings.begin(), strings.end(), 1);
+      REQUIRE(same_values(strings, values));
+    }
+    THEN("many threads sort them as std::sort does") {
+      algorithm::sort(strings.begin(), strings.end(), 4);
+      REQUIRE(same_values(strings, values));
+    }
+    THEN("sort_unique leaves distinct strings") {
+      strings.erase(algorithm::sort_unique(strings.begin(), strings.end()),
+                    strings.end());
+      values.erase(std::unique(values.begin(), values.end()), values.end());
+      REQUIRE(same_values(strings, values));
+    }
+  }
+  GIVEN("concatenations") {
+    const string long_str{"long enough string to be concatenated"};
+    std::vector<string> strings{long_str + long_str, string{"b"},
+                                string{"a"} + long_str + long_str,
+                                long_str};
+
+    THEN("they are sorted without being flattened first") {
+      algorithm::sort(strings.begin(), strings.end());
+      REQUIRE(strings[0] == (string{"a"} + long_str + long_str).c_str());
+      REQUIRE(strings[1] == "b");
+      REQUIRE(strings[2] == long_str);
+      REQUIRE(strings[3] == (long_str + long_str).c_str());
+    }
+  }
+  GIVEN("wide strings") {
+    std::vector<wstring> strings{wstring{L"long enough wide string #2"},
+                                 wstring{L"b"},
+                                 wstring{L"long enough wide string #1"}};
+
+    THEN("they are sorted by their comparison") {
+      algorithm::sort(strings.begin(), strings.end());
+      REQUIRE(strings[0].compare(L"b") == 0);
+      REQUIRE(strings[1].compare(L"long enough wide string #1") == 0);
+      REQUIRE(strings[2].compare(L"long enough wide string #2") == 0);
+    }
+  }
+  GIVEN("an empty range") {
+    std::vector<string> strings;
+
+    THEN("nothing happens") {
+      algorithm::sort(strings.begin(), strings.end());
+      REQUIRE(algorithm::sort_unique(strings.begin(), strings.end()) ==
+              strings.end());
+    }
+  }
+}
+
+SCENARIO("duplicates share one buffer", "[algorithm]") {
+  GIVEN("a sorted range with equal strings in separate buffers") {
+    std::vector<string> strings{string{"long enough string #1"},
+                                string{"long enough string #1"},
+                                string{"long enough string #1"},
+                                string{"long enough string #2"},
+                                string{"long enough string #2"}};
+    REQUIRE(strings[0].data() != strings[1].data());
+
+    WHEN("duplicates are shared") {
+      algorithm::share_duplicates(strings.begin(), strings.end());
+
+      THEN("equal strings are copies of the first one") {
+        REQUIRE(strings[1].data() == strings[0].data());
+        REQUIRE(strings[2].data() == strings[0].data());
+        REQUIRE(strings[4].data() == strings[3].data());
+        REQUIRE(strings[3].data() != strings[0].data());
+        REQUIRE(strings[4] == "long enough string #2");
+      }
+      THEN("unique compares them in O(1)") {
+        const auto end = algorithm::unique(strings.begin(), strings.end());
+        REQUIRE(end - strings.begin() == 2);
+      }
+    }
+  }
+}
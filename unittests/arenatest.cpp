@@ -0,0 +1,158 @@
+#include "allocator_with_count.hpp"
+#include "catch2/catch.hpp"
+#include "immutable_string/arena.hpp"
+#include "immutable_string/builder.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace immutable_string;
+
+SCENARIO("strings made by an arena", "[arena]") {
+  int allocated_count = 0;
+  auto allocator = allocator_with_count<char>{allocated_count};
+
+  GIVEN("an arena with blocks from allocator with count") {
+    basic_arena<allocator_with_count<char>> region{1024, allocator};
+    REQUIRE(allocated_count == 0);
+
+    WHEN("many long strings are made") {
+      std::vector<string> strs;
+      for (int i = 0; i < 20; ++i) {
+        const auto value = "arena string number " + std::to_string(i);
+        strs.push_back(region.make(value.c_str(), value.size()));
+      }
+
+      THEN("they share few blocks") {
+        REQUIRE(allocated_count == 1);
+        REQUIRE(region.used_bytes() > 20 * 21);
+        REQUIRE(strs[3] == "arena string number 3");
+        REQUIRE(std::strcmp(strs[19].c_str(), "arena string number 19") == 0);
+        REQUIRE(strs[1].data() + 22 <= strs[2].data());
+      }
+      THEN("copies point to the same characters") {
+        const auto copy = strs[5];
+        REQUIRE(copy.data() == strs[5].data());
+        REQUIRE(copy == strs[5]);
+        REQUIRE(copy.substr(2).data() == strs[5].data() + 2);
+        REQUIRE(copy.hash() == string{"arena string number 5"}.hash());
+      }
+      THEN("compact makes an owning copy") {
+        const auto owned = strs[7].compact();
+        REQUIRE(owned == strs[7]);
+        REQUIRE(owned.data() != strs[7].data());
+      }
+    }
+    WHEN("a short string is made") {
+      const auto str = region.make("short");
+
+      THEN("it is stored inline") {
+        REQUIRE(str == "short");
+        REQUIRE(region.used_bytes() == 0);
+        REQUIRE(allocated_count == 0);
+      }
+    }
+    WHEN("a large string is made") {
+      const auto small = region.make("long enough to be in the arena");
+      const std::string large(1000, 'x');
+      const auto str = region.make(large.c_str(), large.size());
+      const auto next = region.make("long enough to follow the first one");
+
+      THEN("it has its own block and the first one is still in use") {
+        REQUIRE(allocated_count == 2);
+        REQUIRE(str.c_str() == large);
+        REQUIRE(next.data() > small.data());
+        REQUIRE(next.data() < small.data() + 1024);
+      }
+    }
+    WHEN("a wide string is made") {
+      const auto str = region.make(L"long enough wide arena string");
+
+      THEN("its characters are aligned") {
+        REQUIRE(str.compare(L"long enough wide arena string") == 0);
+        REQUIRE(reinterpret_cast<std::uintptr_t>(str.data()) %
+                    alignof(wchar_t) ==
+                0);
+      }
+    }
+    WHEN("the arena is released") {
+      region.make("long enough to be in the arena");
+      region.release();
+
+      THEN("it is empty and reusable") {
+        REQUIRE(region.used_bytes() == 0);
+        REQUIRE(region.make("long enough to be in the arena again") ==
+                "long enough to be in the arena again");
+        REQUIRE(allocated_count == 2);
+      }
+    }
+  }
+  GIVEN("strings with arena allocator") {
+    arena region;
+    using arena_string =
+        basic_string<char, std::char_traits<char>, arena_allocator<char>>;
+
+    WHEN("a long string is constructed") {
+      const arena_string str{"long string with a refcount in the arena",
+                             arena_allocator<char>{region}};
+
+      THEN("its buffer is taken from the arena") {
+        REQUIRE(str == "long string with a refcount in the arena");
+        REQUIRE(region.used_bytes() > str.size());
+      }
+    }
+    WHEN("strings are concatenated") {
+      const arena_string str{"long string with a refcount in the arena",
+                             arena_allocator<char>{region}};
+      const auto used = region.used_bytes();
+      auto sum = str + str;
+      sum += arena_string{"short", arena_allocator<char>{region}};
+      const auto mixed = "a long enough prefix, " + (sum + ", a suffix");
+
+      THEN("their buffers are taken from the arena of the left one") {
+        REQUIRE(sum.size() == 2 * str.size() + 5);
+        REQUIRE(sum.substr(0, str.size()) == str);
+        REQUIRE(sum.substr(str.size(), str.size()) == str);
+        REQUIRE(mixed.size() == sum.size() + 32);
+        REQUIRE(std::strlen(mixed.c_str()) == mixed.size());
+        REQUIRE(region.used_bytes() > used + 2 * str.size());
+      }
+    }
+    WHEN("strings frozen by a builder are concatenated") {
+      basic_string_builder<char, std::char_traits<char>,
+                           arena_allocator<char>>
+          builder{arena_allocator<char>{region}};
+      builder.append("long string frozen by a builder");
+      const auto str = builder.freeze();
+      const auto part = str.substr(5, 20);
+      const auto used = region.used_bytes();
+
+      THEN("their buffers are taken from the same arena") {
+        REQUIRE((str + str).size() == 2 * str.size());
+        REQUIRE((part + part) == "string frozen by a bstring frozen by a b");
+        REQUIRE((str + part + str + str + str).size() == 4 * str.size() + 20);
+        REQUIRE(region.used_bytes() > used);
+      }
+    }
+    WHEN("short strings without a buffer are concatenated") {
+      const auto left = region.make<arena_string>("long enough part", 16);
+      const arena_string right{"short", arena_allocator<char>{region}};
+
+      THEN("short results are inline, long ones need an allocator") {
+        REQUIRE((right + right) == "shortshort");
+        REQUIRE(left.concat(right, arena_allocator<char>{region}) ==
+                "long enough partshort");
+        REQUIRE_THROWS_AS(left + right, std::invalid_argument);
+      }
+      THEN("their slices don't need an allocator") {
+        const auto str =
+            region.make<arena_string>("long enough part, cut", 21);
+        const auto used = region.used_bytes();
+        REQUIRE(std::strcmp(str.substr(0, 16).c_str(), "long enough part") == 0);
+        REQUIRE(region.used_bytes() == used);
+      }
+    }
+  }
+}
@@ -0,0 +1,120 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/atomic.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace immutable_string;
+
+SCENARIO("atomic string slot", "[atomic]") {
+  GIVEN("a slot with a long string") {
+    const string first{"long enough first value of the slot"};
+    atomic_string slot{first};
+
+    THEN("loads share the buffer of the stored string") {
+      REQUIRE(slot.is_lock_free());
+      const auto value = slot.load();
+      REQUIRE(value == first);
+      REQUIRE(value.data() == first.data());
+    }
+    WHEN("a new value is stored") {
+      const auto old = slot.load();
+      slot = string{"long enough second value of the slot"};
+      THEN("loads see it and old values stay valid") {
+        REQUIRE(slot.load() == "long enough second value of the slot");
+        REQUIRE(string(slot) == "long enough second value of the slot");
+        REQUIRE(old == first);
+      }
+    }
+    WHEN("values are exchanged") {
+      const auto old = slot.exchange(string{"short"});
+      THEN("the old one is returned") {
+        REQUIRE(old.data() == first.data());
+        REQUIRE(slot.load() == "short");
+        REQUIRE(slot.exchange(string{}) == "short");
+        REQUIRE(slot.load().empty());
+      }
+    }
+    WHEN("compare_exchange expects an equal value") {
+      auto expected = string{"long enough first value of the slot"};
+      const auto res =
+          slot.compare_exchange_strong(expected, string{"replaced"});
+      THEN("the value is replaced") {
+        REQUIRE(res);
+        REQUIRE(slot.load() == "replaced");
+      }
+    }
+    WHEN("compare_exchange expects another value") {
+      auto expected = string{"other value"};
+      const auto res = slot.compare_exchange_weak(expected, string{"x"});
+      THEN("the current value is loaded into expected") {
+        REQUIRE_FALSE(res);
+        REQUIRE(expected.data() == first.data());
+        REQUIRE(slot.load() == first);
+      }
+    }
+  }
+  GIVEN("an empty slot") {
+    atomic_string slot;
+    THEN("it holds an empty string") {
+      REQUIRE(slot.load().empty());
+      auto expected = string{};
+      REQUIRE(slot.compare_exchange_strong(expected, string{"set"}));
+      REQUIRE(slot.load() == "set");
+    }
+  }
+}
+
+SCENARIO("atomic string slot shared by threads", "[atomic]") {
+  GIVEN("readers and writers of one slot") {
+    const std::size_t value_count = 8;
+    std::vector<string> values;
+    for (std::size_t i = 0; i < value_count; ++i) {
+      values.emplace_back(("long enough published value #" +
+                           std::to_string(i)).c_str());
+    }
+    values.emplace_back();
+    atomic_string slot{values[0]};
+    std::atomic<bool> done{false};
+    std::atomic<std::size_t> unknown{0};
+    std::atomic<std::size_t> swaps{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 3; ++t) {
+      threads.emplace_back([&] {
+        while (!done.load()) {
+          const auto value = slot.load();
+          bool known = false;
+          for (const auto& str : values) known = known || value == str;
+          if (!known) ++unknown;
+        }
+      });
+    }
+    threads.emplace_back([&] {
+      for (std::size_t i = 0; i < 20000; ++i) {
+        slot.store(values[i % values.size()]);
+      }
+    });
+    threads.emplace_back([&] {
+      for (std::size_t i = 0; i < 20000; ++i) {
+        auto expected = values[i % values.size()];
+        if (slot.compare_exchange_strong(expected,
+                                         values[(i + 1) % values.size()])) {
+          ++swaps;
+        }
+      }
+      done.store(true);
+    });
+    for (auto& thread : threads) thread.join();
+
+    THEN("readers only see stored values") {
+      REQUIRE(unknown.load() == 0);
+      const auto value = slot.load();
+      bool known = false;
+      for (const auto& str : values) known = known || value == str;
+      REQUIRE(known);
+    }
+  }
+}
@@ -0,0 +1,25 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/string.hpp"
+#include "immutable_string/utf8.hpp"
+
+#include <string>
+
+// unittests_avx2 builds this file without AVX2, so the kernels of both
+// instruction sets are linked into one program
+using namespace immutable_string;
+
+SCENARIO("kernels without AVX2 next to AVX2 ones", "[search]") {
+  GIVEN("strings longer than an AVX2 block") {
+    const string hay{"a long enough haystack, longer than 32 bytes: needle"};
+    const string text{
+        "long enough text with \xe2\x82\xac, longer than 32 bytes"};
+
+    THEN("they are searched and validated as in other files") {
+      REQUIRE(hay.find("needle") == hay.size() - 6);
+      REQUIRE(hay.find_first_of(":;") == hay.size() - 8);
+      REQUIRE(hay.find_last_not_of("edl") == hay.size() - 6);
+      REQUIRE(utf8::is_valid(text));
+      REQUIRE_FALSE(utf8::is_ascii(text));
+    }
+  }
+}
@@ -0,0 +1,123 @@
+#include "allocator_with_count.hpp"
+#include "catch2/catch.hpp"
+#include "immutable_string/builder.hpp"
+
+#include <cstring>
+#include <string>
+#include <utility>
+
+using namespace immutable_string;
+
+using builder_count_alloc =
+    basic_string_builder<char, std::char_traits<char>,
+                         allocator_with_count<char>>;
+
+SCENARIO("string builder hands its buffer over", "[builder]") {
+  int allocated_count = 0;
+  auto allocator = allocator_with_count<char>{allocated_count};
+
+  GIVEN("a builder with reserved capacity") {
+    builder_count_alloc builder{40, allocator};
+    REQUIRE(builder.capacity() == 40);
+    REQUIRE(allocated_count == 1);
+
+    WHEN("it is filled and frozen") {
+      builder.append("long enough ").append(3, '!');
+      builder += " appended by parts";
+      builder.push_back('.');
+      const auto buffer = builder.data();
+      const auto str = builder.freeze();
+
+      THEN("the string owns the same buffer") {
+        REQUIRE(str == "long enough !!! appended by parts.");
+        REQUIRE(std::strlen(str.c_str()) == str.size());
+        REQUIRE(str.data() == buffer);
+        REQUIRE(allocated_count == 1);
+      }
+      THEN("the builder is left empty") {
+        REQUIRE(builder.empty());
+        REQUIRE(builder.capacity() == 0);
+      }
+      THEN("the string behaves as any other one") {
+        const auto copy = str;
+        REQUIRE(copy.data() == str.data());
+        REQUIRE(str.substr(5).data() == buffer + 5);
+        REQUIRE(str.hash() == string{str.c_str()}.hash());
+      }
+    }
+    WHEN("most of the buffer is unused") {
+      builder.append("not so long string");
+      const auto buffer = builder.data();
+      const auto str = builder.freeze();
+
+      THEN("the characters are copied into a buffer of the exact size") {
+        REQUIRE(str == "not so long string");
+        REQUIRE(str.data() != buffer);
+        REQUIRE(allocated_count == 2);
+      }
+      THEN("the builder keeps its buffer") {
+        REQUIRE(builder.empty());
+        REQUIRE(builder.capacity() == 40);
+        REQUIRE(builder.data() == buffer);
+      }
+    }
+    WHEN("the result is short") {
+      builder.append("short");
+      const auto str = builder.freeze();
+
+      THEN("it is stored inline") {
+        REQUIRE(str == "short");
+        REQUIRE(allocated_count == 1);
+      }
+    }
+  }
+  GIVEN("a builder without reserved capacity") {
+    builder_count_alloc builder{allocator};
+    REQUIRE(builder.capacity() == 0);
+    REQUIRE(allocated_count == 0);
+
+    WHEN("many characters are appended") {
+      std::string expected;
+      for (int i = 0; i < 1000; ++i) {
+        const auto part = std::to_string(i);
+        builder.append(part.c_str(), part.size());
+        expected += part;
+      }
+
+      THEN("the buffer grows geometrically") {
+        REQUIRE(builder.size() == expected.size());
+        REQUIRE(allocated_count <= 8);
+        REQUIRE(builder.freeze().c_str() == expected);
+      }
+    }
+    WHEN("characters are written in place") {
+      const auto dest = builder.extend(20);
+      std::memset(dest, 'x', 20);
+
+      THEN("they are a part of the result") {
+        REQUIRE(builder.size() == 20);
+        REQUIRE(builder.freeze() == "xxxxxxxxxxxxxxxxxxxx");
+      }
+    }
+    WHEN("nothing is appended") {
+      const auto str = builder.freeze();
+
+      THEN("the result is empty and nothing is allocated") {
+        REQUIRE(str.empty());
+        REQUIRE(allocated_count == 0);
+      }
+    }
+  }
+  GIVEN("strings appended to a builder") {
+    string_builder builder;
+    const auto rope = string{"first long enough piece, "} +
+                      string{std::string(150, 'x').c_str()};
+    builder.append(rope).append(string{"!"});
+
+    THEN("their pieces are copied") {
+      REQUIRE(builder.size() == rope.size() + 1);
+      const auto moved = std::move(builder);
+      REQUIRE(builder.empty());
+    }
+  }
+}
@@ -0,0 +1,143 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/compressed.hpp"
+
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace immutable_string;
+
+namespace {
+
+// log lines: much repeated text and a few random numbers
+std::string make_text(std::size_t lines) {
+  std::mt19937 gen(30);
+  std::string res;
+  for (std::size_t i = 0; i < lines; ++i) {
+    res += "2026-10-14 12:00:00 INFO request served in ";
+    res += std::to_string(gen() % 1000) + " ms, status 200\n";
+  }
+  return res;
+}
+
+std::string round_trip(const std::string& input) {
+  std::vector<char> compressed(lz_codec::bound(input.size()));
+  const auto count =
+      lz_codec::compress(input.data(), input.size(), compressed.data());
+  REQUIRE(count <= compressed.size());
+  std::string res(input.size(), '\0');
+  lz_codec::decompress(compressed.data(), count, &res[0], res.size());
+  return res;
+}
+
+}  // namespace
+
+SCENARIO("LZ codec", "[compressed]") {
+  GIVEN("inputs of all kinds") {
+    THEN("they are decompressed as they were") {
+      REQUIRE(round_trip("").empty());
+      REQUIRE(round_trip("abc") == "abc");
+      REQUIRE(round_trip("abcdabcd") == "abcdabcd");
+      // overlapping matches and lengths continued in bytes
+      const std::string run(1000, 'a');
+      REQUIRE(round_trip(run) == run);
+      const auto text = make_text(500);
+      REQUIRE(round_trip(text) == text);
+      std::mt19937 gen(30);
+      for (int round = 0; round < 200; ++round) {
+        std::string input(gen() % 2000, ' ');
+        const auto alphabet = 1 + gen() % 255;
+        for (auto& ch : input) ch = static_cast<char>(gen() % alphabet);
+        REQUIRE(round_trip(input) == input);
+      }
+    }
+  }
+}
+
+SCENARIO("compressed strings", "[compressed]") {
+  GIVEN("a large string of text") {
+    const auto text = make_text(1000);
+    const compressed_string compressed{string{text.c_str()}};
+    trim_compressed_caches();
+
+    THEN("it is kept compressed") {
+      REQUIRE(compressed.is_compressed());
+      REQUIRE(compressed.size() == text.size());
+      REQUIRE(compressed.stored_bytes() < text.size() / 4);
+    }
+    WHEN("it is read") {
+      const auto first = compressed.str();
+      const auto second = compressed.str();
+      THEN("it is decompressed once and cached") {
+        REQUIRE(first == text.c_str());
+        REQUIRE(second.data() == first.data());
+        REQUIRE(compressed_cache_bytes() == text.size());
+        REQUIRE(compressed_string{compressed}.str().data() == first.data());
+      }
+      AND_WHEN("the cache is dropped") {
+        REQUIRE(compressed.drop_cache() == text.size());
+        REQUIRE(compressed.drop_cache() == 0);
+        const auto third = compressed.str();
+        THEN("strings read before stay valid, new ones are decompressed") {
+          REQUIRE(first == text.c_str());
+          REQUIRE(third == first);
+          REQUIRE(third.data() != first.data());
+        }
+      }
+      AND_WHEN("all caches are trimmed") {
+        REQUIRE(trim_compressed_caches() == text.size());
+        THEN("nothing is cached") {
+          REQUIRE(compressed_cache_bytes() == 0);
+          REQUIRE(first == text.c_str());
+          REQUIRE(compressed.str() == first);
+        }
+      }
+    }
+  }
+  GIVEN("strings which aren't worth compressing") {
+    const string small{"short enough string to keep as it is"};
+    std::mt19937 gen(30);
+    std::string noise(1000, ' ');
+    for (auto& ch : noise) ch = static_cast<char>('!' + gen() % 90);
+    const string random{noise.c_str()};
+    THEN("they are kept as they are") {
+      REQUIRE_FALSE(compressed_string{small}.is_compressed());
+      REQUIRE(compressed_string{small}.str().data() == small.data());
+      REQUIRE_FALSE(compressed_string{random}.is_compressed());
+      REQUIRE(compressed_string{random}.str() == random);
+      REQUIRE(compressed_string{}.str().empty());
+    }
+  }
+  GIVEN("a large wide string") {
+    const std::wstring text(2000, L'\x42f');
+    const compressed_wstring compressed{wstring{text.c_str()}};
+    THEN("its bytes are compressed") {
+      REQUIRE(compressed.is_compressed());
+      REQUIRE(compressed.str() == text.c_str());
+    }
+  }
+}
+
+SCENARIO("compressed strings read by threads", "[compressed]") {
+  GIVEN("a compressed string") {
+    const auto text = make_text(200);
+    const compressed_string compressed{string{text.c_str()}};
+    WHEN("threads read it while its cache is trimmed") {
+      std::vector<std::thread> threads;
+      std::vector<int> matches(4, 0);
+      for (std::size_t i = 0; i < matches.size(); ++i) {
+        threads.emplace_back([&compressed, &text, &matches, i] {
+          for (int j = 0; j < 100; ++j) {
+            matches[i] += compressed.str() == text.c_str();
+          }
+        });
+      }
+      for (int j = 0; j < 100; ++j) trim_compressed_caches();
+      for (auto& thread : threads) thread.join();
+      THEN("every read sees the characters") {
+        for (const auto count : matches) REQUIRE(count == 100);
+      }
+    }
+  }
+}
@@ -0,0 +1,74 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/deferred.hpp"
+
+#include <thread>
+#include <vector>
+
+using namespace immutable_string;
+
+SCENARIO("deferred allocator gives blocks back to their thread",
+         "[deferred]") {
+  GIVEN("strings made with the allocator") {
+    deferred_allocator<char>::flush();
+    const deferred_string str{"long enough string of this thread"};
+    const auto copy = str;
+    const auto joined = str + copy;
+
+    THEN("they work as usual") {
+      REQUIRE(copy == "long enough string of this thread");
+      REQUIRE(joined.size() == 2 * str.size());
+      REQUIRE(joined.c_str()[str.size()] == 'l');
+    }
+  }
+  GIVEN("strings dropped by another thread") {
+    deferred_allocator<char>::flush();
+    std::vector<deferred_string> strs;
+    for (int i = 0; i < 10; ++i) {
+      strs.emplace_back("long enough string passed to another thread");
+    }
+    std::thread{[&strs] { strs.clear(); }}.join();
+
+    THEN("this thread frees them on flush") {
+      REQUIRE(deferred_allocator<char>::flush() == 10);
+      REQUIRE(deferred_allocator<char>::flush() == 0);
+    }
+    THEN("this thread frees them on its next allocation") {
+      const deferred_string str{"long enough string which frees the others"};
+      REQUIRE(deferred_allocator<char>::flush() == 0);
+    }
+  }
+  GIVEN("strings made by a thread which is finished") {
+    std::vector<deferred_string> strs;
+    std::thread{[&strs] {
+      for (int i = 0; i < 10; ++i) {
+        strs.emplace_back("long enough string of a finished thread");
+      }
+      // some of them are dropped before the thread finishes
+      std::thread{[&strs] { strs.resize(5); }}.join();
+    }}.join();
+
+    THEN("they outlive it and are freed by their last owners") {
+      REQUIRE(strs.size() == 5);
+      REQUIRE(strs[4] == "long enough string of a finished thread");
+      strs.clear();
+      REQUIRE(deferred_allocator<char>::flush() == 0);
+    }
+  }
+  GIVEN("a producer which hands strings over again and again") {
+    std::size_t left = 0;
+    std::thread{[&left] {
+      for (int round = 0; round < 100; ++round) {
+        std::vector<deferred_string> batch;
+        for (int i = 0; i < 10; ++i) {
+          batch.emplace_back("long enough string moving between threads");
+        }
+        std::thread{[&batch] { batch.clear(); }}.join();
+      }
+      left = deferred_allocator<char>::flush();
+    }}.join();
+
+    THEN("each batch is freed by the next allocation") {
+      REQUIRE(left == 10);
+    }
+  }
+}
@@ -0,0 +1,170 @@
+#include "allocator_with_count.hpp"
+#include "catch2/catch.hpp"
+#include "immutable_string/flat_map.hpp"
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace immutable_string;
+
+SCENARIO("string map finds keys by strings and characters", "[flat_map]") {
+  GIVEN("a map of short and long keys") {
+    const string long_key{"long enough key to be on the heap"};
+    string_map<int> map{{string{"one"}, 1}, {long_key, 2}};
+
+    THEN("keys are found by any kind of probe") {
+      REQUIRE(map.size() == 2);
+      REQUIRE(map.find(string{"one"})->second == 1);
+      REQUIRE(map.find("one")->second == 1);
+      REQUIRE(map.find(long_key.c_str())->second == 2);
+      REQUIRE(map.at(long_key) == 2);
+      REQUIRE(map.count("two") == 0);
+      REQUIRE(map.find("two") == map.end());
+      REQUIRE_THROWS_AS(map.at("two"), std::out_of_range);
+    }
+    THEN("the stored key shares the buffer of the inserted one") {
+      REQUIRE(map.find(long_key)->first.data() == long_key.data());
+    }
+    WHEN("existing keys are inserted") {
+      const auto res = map.try_emplace("one", 10);
+      THEN("the map keeps the old values") {
+        REQUIRE(!res.second);
+        REQUIRE(res.first->second == 1);
+        REQUIRE(map.size() == 2);
+      }
+    }
+    WHEN("values are set by operator[] and insert_or_assign") {
+      map["one"] = 11;
+      map["three"] = 3;
+      map.insert_or_assign(long_key, 12);
+      THEN("they replace the old ones or are added") {
+        REQUIRE(map.size() == 3);
+        REQUIRE(map.at("one") == 11);
+        REQUIRE(map.at("three") == 3);
+        REQUIRE(map.at(long_key) == 12);
+      }
+    }
+    WHEN("keys are erased") {
+      REQUIRE(map.erase("one") == 1);
+      REQUIRE(map.erase("one") == 0);
+      map.erase(map.find(long_key));
+      THEN("the map is empty") {
+        REQUIRE(map.empty());
+        REQUIRE(map.begin() == map.end());
+      }
+    }
+    WHEN("the map is copied and the original is cleared") {
+      const auto copy = map;
+      map.clear();
+      THEN("the copy keeps the elements") {
+        REQUIRE(map.empty());
+        REQUIRE(copy.size() == 2);
+        REQUIRE(copy.at("one") == 1);
+        REQUIRE(copy.at(long_key) == 2);
+      }
+    }
+  }
+  GIVEN("an empty map") {
+    const string_map<int> map;
+    THEN("nothing is found and there are no slots") {
+      REQUIRE(map.find("a") == map.end());
+      REQUIRE(map.capacity() == 0);
+    }
+  }
+}
+
+SCENARIO("string map keeps up with std::map", "[flat_map]") {
+  GIVEN("random inserts and erasures of many keys") {
+    std::mt19937 gen{7};
+    std::uniform_int_distribution<int> key_dist{0, 2000};
+    string_map<int> map;
+    std::map<std::string, int> expected;
+    for (int i = 0; i < 20000; ++i) {
+      const auto key = "key number " + std::to_string(key_dist(gen));
+      if (i % 3 == 0) {
+        REQUIRE(map.erase(key.c_str()) == expected.erase(key));
+      } else {
+        map[string{key.c_str()}] = i;
+        expected[key] = i;
+      }
+    }
+
+    THEN("the maps have the same elements") {
+      REQUIRE(map.size() == expected.size());
+      REQUIRE(map.size() <= map.capacity() / 4 * 3);
+      for (const auto& value : expected) {
+        REQUIRE(map.at(value.first.c_str()) == value.second);
+      }
+      std::size_t count = 0;
+      for (const auto& value : map) {
+        REQUIRE(expected.at(std::string{value.first.c_str()}) ==
+                value.second);
+        ++count;
+      }
+      REQUIRE(count == expected.size());
+    }
+  }
+  GIVEN("a map with reserved room") {
+    string_map<std::vector<int>> map;
+    map.reserve(100);
+    const auto capacity = map.capacity();
+    for (int i = 0; i < 100; ++i) {
+      map.try_emplace(std::to_string(i).c_str(), 3, i);
+    }
+    THEN("it doesn't rehash") {
+      REQUIRE(map.capacity() == capacity);
+      REQUIRE(map.at("42") == std::vector<int>(3, 42));
+    }
+  }
+}
+
+SCENARIO("string set hash-conses strings", "[flat_map]") {
+  int allocated_count = 0;
+  auto allocator = allocator_with_count<char>{allocated_count};
+  using count_string = basic_string<char, std::char_traits<char>,
+                                    allocator_with_count<char>>;
+
+  GIVEN("a set of strings") {
+    string_set<count_string> set;
+    const count_string first{"long enough string to be shared", allocator};
+    REQUIRE(allocated_count == 1);
+    set.insert(first);
+
+    THEN("equal strings are replaced by the stored one") {
+      const count_string second{"long enough string to be shared",
+                                allocator};
+      REQUIRE(second.data() != first.data());
+      REQUIRE(set.intern(second).data() == first.data());
+      REQUIRE(set.size() == 1);
+    }
+    THEN("characters are looked up without making strings") {
+      allocated_count = 0;
+      REQUIRE(set.count("long enough string to be shared") == 1);
+      REQUIRE(set.find("long enough string") == set.end());
+      REQUIRE(allocated_count == 0);
+    }
+    THEN("new strings are stored") {
+      const count_string second{"another long enough string", allocator};
+      REQUIRE(set.intern(second).data() == second.data());
+      REQUIRE(set.size() == 2);
+    }
+    THEN("erased strings are no longer found") {
+      REQUIRE(set.erase("long enough string to be shared") == 1);
+      REQUIRE(set.count(first) == 0);
+      REQUIRE(set.empty());
+    }
+  }
+  GIVEN("a set of strings made of characters") {
+    string_set<> set;
+    const auto& str = set.intern("long enough string made for the set");
+
+    THEN("the same characters give the same string") {
+      REQUIRE(str == "long enough string made for the set");
+      REQUIRE(set.intern("long enough string made for the set").data() ==
+              str.data());
+      REQUIRE(set.size() == 1);
+    }
+  }
+}
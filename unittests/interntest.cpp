@@ -0,0 +1,160 @@
+#include "allocator_with_count.hpp"
+#include "catch2/catch.hpp"
+#include "immutable_string/intern.hpp"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using namespace immutable_string;
+
+SCENARIO("interned strings share one buffer", "[intern]") {
+  GIVEN("two equal long strings with different buffers") {
+    string str1{"interned long test string #1"};
+    string str2{"interned long test string #1"};
+    REQUIRE(str1.data() != str2.data());
+    REQUIRE_FALSE(str1.is_interned());
+
+    WHEN("both are interned") {
+      const auto interned1 = intern(str1);
+      const auto interned2 = intern(str2);
+
+      THEN("they point to the same memory") {
+        REQUIRE(interned1.data() == interned2.data());
+        REQUIRE(interned1.is_interned());
+        REQUIRE(interned2.is_interned());
+      }
+      THEN("interning from characters returns the same buffer") {
+        const char* cstr = "interned long test string #1";
+        REQUIRE(intern(cstr).data() == interned1.data());
+        REQUIRE(intern(cstr, std::strlen(cstr)).data() == interned1.data());
+      }
+      THEN("interned strings are equal to original ones") {
+        REQUIRE(interned1 == str2);
+        REQUIRE(interned2 == interned1);
+      }
+    }
+  }
+  GIVEN("a long string which is not interned yet") {
+    string str{"interned long test string #5"};
+
+    THEN("it becomes canonical without a copy") {
+      REQUIRE(intern(str).data() == str.data());
+      REQUIRE(intern(string{str.c_str()}).data() == str.data());
+    }
+  }
+  GIVEN("two different interned strings") {
+    const auto str1 = intern("interned long test string #2");
+    const auto str2 = intern("interned long test string #3");
+
+    THEN("they are different") {
+      REQUIRE(str1.data() != str2.data());
+      REQUIRE(str1 != str2);
+      REQUIRE_FALSE(str1 == str2);
+    }
+  }
+  GIVEN("a long slice of some string") {
+    string str{"prefix:interned long test string #4"};
+    const auto slice = str.substr(7);
+
+    WHEN("it is interned") {
+      const auto interned = intern(slice);
+
+      THEN("its characters are copied into a canonical buffer") {
+        REQUIRE(interned == "interned long test string #4");
+        REQUIRE(interned.data() != slice.data());
+        REQUIRE(interned.is_interned());
+        REQUIRE_FALSE(slice.is_interned());
+      }
+      THEN("slices of interned strings are not interned") {
+        REQUIRE_FALSE(interned.substr(1).is_interned());
+      }
+    }
+  }
+  GIVEN("a short string") {
+    const auto str = intern("short");
+
+    THEN("it is stored inline, not in the pool") {
+      REQUIRE(str == "short");
+      REQUIRE_FALSE(str.is_interned());
+    }
+  }
+}
+
+SCENARIO("interning strings with custom allocator", "[intern]") {
+  using string_count_alloc =
+      basic_string<char, std::char_traits<char>, allocator_with_count<char>>;
+
+  GIVEN("a long string allocated with allocator with count") {
+    int allocated_count = 0;
+    auto allocator = allocator_with_count<char>{allocated_count};
+    string_count_alloc str{"interned string with custom allocator", allocator};
+
+    WHEN("it is interned twice") {
+      const auto interned1 = intern(str, allocator);
+      const auto interned2 = intern(string_count_alloc{str}, allocator);
+
+      THEN("nothing new is allocated") {
+        REQUIRE(interned1.data() == str.data());
+        REQUIRE(interned2.data() == str.data());
+        REQUIRE(allocated_count == 1);
+      }
+    }
+  }
+}
+
+SCENARIO("interning from many threads", "[intern]") {
+  GIVEN("a few distinct strings interned concurrently") {
+    const std::size_t thread_count = 4;
+    const std::size_t string_count = 200;
+    std::vector<std::vector<string>> results(thread_count);
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < thread_count; ++t) {
+      threads.emplace_back([t, &results] {
+        for (std::size_t i = 0; i < string_count; ++i) {
+          const auto value = "concurrently interned " + std::to_string(i);
+          results[t].push_back(intern(value.c_str()));
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+
+    THEN("every thread got the same buffers") {
+      for (std::size_t i = 0; i < string_count; ++i) {
+        for (std::size_t t = 1; t < thread_count; ++t) {
+          REQUIRE(results[t][i].data() == results[0][i].data());
+        }
+      }
+    }
+    THEN("the pool has an entry for every string") {
+      REQUIRE(intern_pool::global().size() >= string_count);
+    }
+  }
+}
+
+SCENARIO("interning strings with plain refcount", "[intern]") {
+  using plain_string =
+      basic_string<char, std::char_traits<char>, std::allocator<char>,
+                   plain_refcount>;
+  using plain_pool = basic_intern_pool<char, std::char_traits<char>,
+                                       std::allocator<char>, plain_refcount>;
+
+  GIVEN("an equal long string interned by two threads") {
+    const char value[] = "long enough string interned by each thread";
+    plain_string first;
+    plain_string second;
+    std::thread{[&] { first = plain_pool::global().intern(value, 42); }}
+        .join();
+    std::thread{[&] { second = plain_pool::global().intern(value, 42); }}
+        .join();
+
+    THEN("each thread has a buffer of its own, the strings are equal") {
+      REQUIRE(first.is_interned());
+      REQUIRE(second.is_interned());
+      REQUIRE(first.data() != second.data());
+      REQUIRE(first == second);
+      REQUIRE_FALSE(first != second);
+    }
+  }
+}
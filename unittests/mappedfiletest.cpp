@@ -0,0 +1,104 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/mapped_file.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <system_error>
+
+using namespace immutable_string;
+
+namespace {
+
+// file with the given content, removed by the destructor
+struct temp_file {
+  temp_file(const char* path, const std::string& content) : path(path) {
+    std::ofstream{path, std::ios::binary} << content;
+  }
+  ~temp_file() { std::remove(path); }
+
+  const char* path;
+};
+
+}  // namespace
+
+SCENARIO("string backed by a mapped file", "[mapped_file]") {
+  GIVEN("a file larger than a page") {
+    std::string content;
+    for (int i = 0; i < 1000; ++i) {
+      content += "line " + std::to_string(i) + '\n';
+    }
+    const temp_file file{"mapped_file_test_large.txt", content};
+
+    WHEN("it is mapped") {
+      const auto str = map_file(file.path);
+
+      THEN("the string has the content of the file") {
+        REQUIRE(str.size() == content.size());
+        REQUIRE(str.compare(0, str.size(), content.data(), content.size()) ==
+                0);
+        REQUIRE(str.hash() == string{content.c_str()}.hash());
+        REQUIRE(str.find("line 999") == content.find("line 999"));
+      }
+      THEN("slices share the mapping") {
+        const auto slice = str.substr(7, 100);
+        REQUIRE(slice.data() == str.data() + 7);
+        REQUIRE(slice.compare(0, 100, content.data() + 7, 100) == 0);
+      }
+      THEN("slices keep the mapping after the string is gone") {
+        auto whole = str;
+        const auto tail = whole.substr(content.size() - 20);
+        whole = string{};
+        REQUIRE(tail.compare(0, 20, content.data() + content.size() - 20,
+                             20) == 0);
+      }
+      THEN("c_str() is null-terminated") {
+        REQUIRE(std::strlen(str.c_str()) == content.size());
+        REQUIRE(std::strlen(str.substr(0, 40).c_str()) == 40);
+        const auto tail = str.substr(content.size() - 20);
+        REQUIRE(std::strlen(tail.c_str()) == 20);
+        REQUIRE(tail.data() == str.data() + content.size() - 20);
+      }
+      THEN("compact() makes a null-terminated copy") {
+        const auto copy = str.substr(0, 40).compact();
+        REQUIRE(copy.data() != str.data());
+        REQUIRE(std::strlen(copy.c_str()) == 40);
+        REQUIRE(str.compact().data() != str.data());
+      }
+    }
+  }
+  GIVEN("a short file") {
+    const temp_file file{"mapped_file_test_short.txt", "short"};
+
+    THEN("it is copied inline") {
+      const auto str = map_file(file.path);
+      REQUIRE(str == "short");
+    }
+  }
+  GIVEN("an empty file") {
+    const temp_file file{"mapped_file_test_empty.txt", ""};
+
+    THEN("the string is empty") { REQUIRE(map_file(file.path).empty()); }
+  }
+  GIVEN("a file of wide characters") {
+    const std::wstring content(100, L'w');
+    const temp_file file{
+        "mapped_file_test_wide.txt",
+        std::string(reinterpret_cast<const char*>(content.data()),
+                    content.size() * sizeof(wchar_t)) +
+            "x"};
+
+    THEN("its characters are read and the trailing byte is ignored") {
+      const auto str = map_file<wstring>(file.path);
+      REQUIRE(str.size() == 100);
+      REQUIRE(str.compare(0, 100, content.data(), 100) == 0);
+    }
+  }
+  GIVEN("a missing file") {
+    THEN("mapping throws") {
+      REQUIRE_THROWS_AS(map_file("mapped_file_test_missing.txt"),
+                        std::system_error);
+    }
+  }
+}
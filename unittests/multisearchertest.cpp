@@ -0,0 +1,195 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/multi_searcher.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace immutable_string;
+
+namespace {
+
+using match = multi_searcher::match;
+
+// every occurrence of every pattern by std::string::find
+std::vector<match> naive_find_all(const std::string& hay,
+                                  const std::vector<std::string>& patterns) {
+  std::vector<match> res;
+  for (std::size_t pos = 0; pos < hay.size(); ++pos) {
+    for (std::size_t p = 0; p < patterns.size(); ++p) {
+      const auto& pattern = patterns[p];
+      if (!pattern.empty() && hay.compare(pos, pattern.size(), pattern) == 0) {
+        res.push_back(match{p, pos});
+      }
+    }
+  }
+  return res;
+}
+
+bool same_matches(const std::vector<match>& lhs,
+                  const std::vector<match>& rhs) {
+  if (lhs.size() != rhs.size()) return false;
+  for (std::size_t i = 0; i < lhs.size(); ++i) {
+    if (lhs[i].pattern != rhs[i].pattern || lhs[i].pos != rhs[i].pos) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+SCENARIO("multi searcher finds all patterns in one pass", "[multi_searcher]") {
+  GIVEN("a small set of patterns") {
+    const multi_searcher keywords{"he", "she", "his", "hers"};
+    REQUIRE(keywords.is_small_set());
+    REQUIRE(keywords.pattern_count() == 4);
+    REQUIRE(keywords.pattern(1) == "she");
+
+    WHEN("applied to a string") {
+      const string str{"ushers and his friends, she said"};
+      const auto matches = keywords.find_all(str);
+
+      THEN("every match is reported by position") {
+        REQUIRE(matches.size() == 6);
+        REQUIRE(matches[0].pattern == 1);
+        REQUIRE(matches[0].pos == 1);
+        REQUIRE(matches[1].pattern == 0);
+        REQUIRE(matches[1].pos == 2);
+        REQUIRE(matches[2].pattern == 3);
+        REQUIRE(matches[2].pos == 2);
+        REQUIRE(matches[3].pattern == 2);
+        REQUIRE(matches[3].pos == 11);
+        REQUIRE(matches[4].pattern == 1);
+        REQUIRE(matches[4].pos == 24);
+        REQUIRE(matches[5].pattern == 0);
+        REQUIRE(matches[5].pos == 25);
+      }
+      THEN("the first match is the leftmost one") {
+        const auto first = keywords.find_first(str);
+        REQUIRE(first.pattern == 1);
+        REQUIRE(first.pos == 1);
+      }
+    }
+    WHEN("nothing matches") {
+      const auto none = keywords.find_first(string{"nothing to see"});
+
+      THEN("npos is returned") {
+        REQUIRE(none.pattern == multi_searcher::npos);
+        REQUIRE(none.pos == multi_searcher::npos);
+        REQUIRE(keywords.find_all(string{}).empty());
+      }
+    }
+  }
+  GIVEN("a large set of patterns") {
+    std::vector<std::string> words;
+    for (int i = 0; i < 300; ++i) words.push_back("word" + std::to_string(i));
+    const multi_searcher keywords{words.begin(), words.end()};
+    REQUIRE_FALSE(keywords.is_small_set());
+
+    WHEN("applied to a string") {
+      const string str{"text with word42 and word299 in it"};
+
+      THEN("patterns and their prefixes are found") {
+        const auto matches = keywords.find_all(str);
+        REQUIRE(matches.size() == 5);
+        REQUIRE(keywords.pattern(matches[0].pattern) == "word4");
+        REQUIRE(keywords.pattern(matches[1].pattern) == "word42");
+        REQUIRE(matches[1].pos == 10);
+        REQUIRE(keywords.pattern(matches[4].pattern) == "word299");
+      }
+      THEN("the first match is the leftmost one with the lowest index") {
+        const auto first = keywords.find_first(str);
+        REQUIRE(keywords.pattern(first.pattern) == "word4");
+        REQUIRE(first.pos == 10);
+      }
+    }
+  }
+  GIVEN("patterns which overlap and repeat") {
+    const multi_searcher keywords{"abcd", "bc", "", "bc", "c", "f", "g", "h",
+                                  "i"};
+    REQUIRE_FALSE(keywords.is_small_set());
+
+    THEN("equal patterns are reported separately, empty ones never") {
+      const auto matches = keywords.find_all(string{"xabcd"});
+      REQUIRE(matches.size() == 4);
+      REQUIRE(matches[0].pattern == 0);
+      REQUIRE(matches[1].pattern == 1);
+      REQUIRE(matches[2].pattern == 3);
+      REQUIRE(matches[3].pattern == 4);
+    }
+    THEN("a longer pattern which starts earlier wins the first match") {
+      const auto first = keywords.find_first(string{"xabcd"});
+      REQUIRE(first.pattern == 0);
+      REQUIRE(first.pos == 1);
+    }
+  }
+}
+
+SCENARIO("multi searcher over many strings", "[multi_searcher]") {
+  GIVEN("a batch of strings") {
+    const multi_searcher keywords{"error", "fatal"};
+    const std::vector<string> lines{"all good", "fatal error happened",
+                                    "an error", "no"};
+
+    WHEN("first matches are searched") {
+      const auto firsts = keywords.batch_find_first(lines.begin(), lines.end());
+
+      THEN("there is a result for every string") {
+        REQUIRE(firsts.size() == 4);
+        REQUIRE(firsts[0].pos == multi_searcher::npos);
+        REQUIRE(firsts[1].pattern == 1);
+        REQUIRE(firsts[1].pos == 0);
+        REQUIRE(firsts[2].pattern == 0);
+        REQUIRE(firsts[2].pos == 3);
+        REQUIRE(firsts[3].pos == multi_searcher::npos);
+      }
+    }
+    WHEN("all matches are visited") {
+      std::vector<std::size_t> hits(lines.size());
+      keywords.batch_for_each_match(
+          lines.begin(), lines.end(),
+          [&hits](std::size_t i, const match&) { ++hits[i]; });
+
+      THEN("matches are attributed to their strings") {
+        REQUIRE(hits == std::vector<std::size_t>{0, 2, 1, 0});
+      }
+    }
+  }
+}
+
+SCENARIO("multi searcher agrees with std::string::find", "[multi_searcher]") {
+  std::mt19937 gen{11};
+  std::uniform_int_distribution<int> char_dist{'a', 'c'};
+  const auto random_string = [&](std::size_t len) {
+    std::string res(len, ' ');
+    for (auto& ch : res) ch = static_cast<char>(char_dist(gen));
+    return res;
+  };
+
+  std::vector<std::string> haystacks;
+  for (std::size_t len : {0, 5, 17, 64, 1000}) {
+    haystacks.push_back(random_string(len));
+  }
+
+  for (std::size_t pattern_count : {1, 3, 8, 40}) {
+    std::vector<std::string> patterns;
+    for (std::size_t i = 0; i < pattern_count; ++i) {
+      patterns.push_back(random_string(1 + i % 6));
+    }
+    const multi_searcher keywords{patterns.begin(), patterns.end()};
+    for (const auto& hay : haystacks) {
+      const auto expected = naive_find_all(hay, patterns);
+      const auto matches = keywords.find_all(hay);
+      REQUIRE(same_matches(matches, expected));
+
+      const auto first = keywords.find_first(hay);
+      if (expected.empty()) {
+        REQUIRE(first.pos == multi_searcher::npos);
+      } else {
+        REQUIRE(first.pattern == expected[0].pattern);
+        REQUIRE(first.pos == expected[0].pos);
+      }
+    }
+  }
+}
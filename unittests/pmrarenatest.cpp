@@ -0,0 +1,71 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/arena.hpp"
+
+#include <cstddef>
+#include <string>
+
+using namespace immutable_string;
+
+#if defined(IMMUTABLE_STRING_PMR)
+
+namespace {
+
+// resource which counts the bytes it gives out
+class resource_with_count : public std::pmr::memory_resource {
+ public:
+  std::size_t m_allocated_bytes = 0;
+
+ private:
+  void* do_allocate(std::size_t bytes, std::size_t align) override {
+    m_allocated_bytes += bytes;
+    return std::pmr::new_delete_resource()->allocate(bytes, align);
+  }
+  void do_deallocate(void* p, std::size_t bytes,
+                     std::size_t align) override {
+    m_allocated_bytes -= bytes;
+    std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+  }
+  bool do_is_equal(const memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+};
+
+}  // namespace
+
+SCENARIO("arena over a memory resource", "[arena]") {
+  GIVEN("an arena over a memory resource") {
+    resource_with_count resource;
+    pmr::arena region{std::pmr::polymorphic_allocator<char>{&resource}};
+
+    WHEN("strings are made in it") {
+      const auto str = region.make("long enough string in memory resource");
+
+      THEN("its blocks are taken from the resource") {
+        REQUIRE(str == "long enough string in memory resource");
+        REQUIRE(resource.m_allocated_bytes >= pmr::arena::default_block_size);
+      }
+      THEN("release() gives them back") {
+        region.release();
+        REQUIRE(resource.m_allocated_bytes == 0);
+      }
+    }
+    WHEN("strings use an arena allocator over it") {
+      using allocator_type =
+          arena_allocator<char, std::pmr::polymorphic_allocator<char>>;
+      using arena_string =
+          basic_string<char, std::char_traits<char>, allocator_type>;
+      const arena_string str{"long string with a refcount in the arena",
+                             allocator_type{region}};
+      const auto sum = str + str;
+
+      THEN("their buffers are taken from the arena") {
+        REQUIRE(sum.size() == 2 * str.size());
+        REQUIRE(sum.substr(str.size()) == str);
+        REQUIRE(region.used_bytes() > 2 * str.size());
+        REQUIRE(resource.m_allocated_bytes > 0);
+      }
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,111 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/searcher.hpp"
+
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using namespace immutable_string;
+
+SCENARIO("searcher finds its pattern in strings", "[searcher]") {
+  GIVEN("searchers for short and long patterns") {
+    const searcher short_searcher{"cddd"};
+    const searcher long_searcher{"a pattern which is longer than 32 chars"};
+
+    WHEN("applied to strings") {
+      const string str1{"aaabbbcccddd aaabbbcccddd"};
+      const string str2{"xx a pattern which is longer than 32 chars xx"};
+
+      THEN("positions of patterns are found") {
+        REQUIRE(str1.find(short_searcher) == 8);
+        REQUIRE(str1.find(short_searcher, 9) == 21);
+        REQUIRE(str1.find(short_searcher, 22) == string::npos);
+        REQUIRE(str1.find(long_searcher) == string::npos);
+        REQUIRE(str2.find(long_searcher) == 3);
+        REQUIRE(str2.find(long_searcher, 4) == string::npos);
+        REQUIRE(str2.find(short_searcher, str2.size() + 1) == string::npos);
+      }
+    }
+    WHEN("applied to a slice") {
+      const string parent{"prefix:aaabbbcccddd:suffix"};
+      const auto slice = parent.substr(7, 12);
+
+      THEN("position is relative to the slice") {
+        REQUIRE(slice.find(short_searcher) == 8);
+      }
+    }
+    WHEN("used as std::search searcher") {
+      const std::string str{"aaabbbcccddd"};
+      const auto res = short_searcher(str.begin(), str.end());
+
+      THEN("matching range is returned") {
+        REQUIRE(res.first - str.begin() == 8);
+        REQUIRE(res.second == str.end());
+      }
+      THEN("end range is returned if pattern isn't found") {
+        const auto none = long_searcher(str.begin(), str.end());
+        REQUIRE(none.first == str.end());
+        REQUIRE(none.second == str.end());
+      }
+    }
+    WHEN("searcher is copied") {
+      const auto copy = long_searcher;
+
+      THEN("it finds the same pattern") {
+        REQUIRE(copy.pattern() == long_searcher.pattern());
+        REQUIRE(string{"a pattern which is longer than 32 chars"}.find(copy) ==
+                0);
+      }
+    }
+  }
+  GIVEN("empty pattern") {
+    const searcher empty_searcher{""};
+
+    REQUIRE(string{"abc"}.find(empty_searcher) == 0);
+    REQUIRE(string{"abc"}.find(empty_searcher, 3) == 3);
+    REQUIRE(string{}.find(empty_searcher) == 0);
+  }
+  GIVEN("pattern concatenated of long parts") {
+    const string part{"a long enough part of a pattern, "};
+    const auto pattern = part + part + part + part + part;
+    // the flat copy of a concatenation may fail to allocate
+    static_assert(!std::is_nothrow_constructible<searcher, string>::value,
+                  "the searcher makes the flat copy of its pattern");
+    const searcher concat_searcher{pattern};
+
+    REQUIRE(("xx" + pattern).find(concat_searcher) == 2);
+    REQUIRE(pattern.substr(1).find(concat_searcher) == string::npos);
+  }
+  GIVEN("wide pattern") {
+    const wsearcher wide_searcher{L"cddd"};
+
+    REQUIRE(wstring{L"aaabbbcccddd"}.find(wide_searcher) == 8);
+    REQUIRE(wstring{L"aaabbbcccdd"}.find(wide_searcher) == wstring::npos);
+  }
+}
+
+SCENARIO("searcher agrees with std::string::find", "[searcher]") {
+  std::mt19937 gen{7};
+  std::uniform_int_distribution<int> char_dist{'a', 'b'};
+  const auto random_string = [&](std::size_t len) {
+    std::string res(len, ' ');
+    for (auto& ch : res) ch = static_cast<char>(char_dist(gen));
+    return res;
+  };
+
+  std::vector<std::string> haystacks;
+  for (std::size_t len : {0, 7, 40, 200, 3000}) {
+    haystacks.push_back(random_string(len));
+  }
+
+  for (std::size_t needle_len = 1; needle_len <= 48; needle_len += 3) {
+    const auto needle = random_string(needle_len);
+    const searcher needle_searcher{needle.c_str(), needle.size()};
+    for (const auto& hay : haystacks) {
+      const string str{hay.c_str(), hay.size()};
+      REQUIRE(str.find(needle_searcher) == hay.find(needle));
+      REQUIRE(str.find(needle_searcher, 5) == hay.find(needle, 5));
+    }
+  }
+}
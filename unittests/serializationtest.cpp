@@ -0,0 +1,145 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/serialization.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace immutable_string;
+
+SCENARIO("strings are serialized into one buffer", "[serialization]") {
+  const string long_str{"long enough string to be serialized"};
+
+  GIVEN("short, long and empty strings") {
+    const std::vector<string> values{string{"short"}, long_str, string{},
+                                     long_str + long_str};
+    const auto buffer = serialize(values.begin(), values.end());
+
+    THEN("the buffer starts with the header") {
+      REQUIRE(buffer.compare(0, 4, "ISTR") == 0);
+      REQUIRE(buffer[4] == 1);
+      REQUIRE(buffer[5] == 1);
+      REQUIRE(buffer[8] == 4);
+    }
+    WHEN("it is deserialized") {
+      const auto strings = deserialize(buffer);
+
+      THEN("the strings are the same") {
+        REQUIRE(strings.size() == 4);
+        REQUIRE(strings[0] == "short");
+        REQUIRE(strings[1] == long_str);
+        REQUIRE(strings[2].empty());
+        REQUIRE(strings[3] == (long_str + long_str).c_str());
+      }
+      THEN("long strings refer to the buffer and are null-terminated") {
+        REQUIRE(strings[1].data() > buffer.data());
+        REQUIRE(strings[1].data() < buffer.data() + buffer.size());
+        REQUIRE(std::strlen(strings[1].c_str()) == strings[1].size());
+        REQUIRE(strings[1].hash() == long_str.hash());
+      }
+      THEN("they keep the buffer alive") {
+        auto copy = buffer;
+        const auto strings_of_copy = deserialize(copy);
+        copy = string{};
+        REQUIRE(strings_of_copy[3].size() == 2 * long_str.size());
+        REQUIRE(strings_of_copy[1] == long_str);
+      }
+    }
+  }
+  GIVEN("a buffer concatenated of two parts") {
+    const std::vector<string> values{long_str, long_str + long_str,
+                                     long_str};
+    const auto buffer = serialize(values.begin(), values.end());
+    const auto half = buffer.size() / 2;
+    // long enough to be a lazy concatenation instead of a copy
+    const auto parts = buffer.substr(0, half) + buffer.substr(half);
+    REQUIRE(parts.size() > 128);
+
+    WHEN("it is deserialized") {
+      const auto strings = deserialize(parts);
+
+      THEN("the strings refer to its flat copy") {
+        REQUIRE(strings.size() == 3);
+        REQUIRE(strings[0] == long_str);
+        REQUIRE(strings[0].data() > parts.data());
+        REQUIRE(strings[0].data() < parts.data() + parts.size());
+      }
+      THEN("they are concatenated and sliced as other strings") {
+        const auto sum = strings[1] + strings[1];
+        REQUIRE(sum.substr(0, 8) == "long eno");
+        REQUIRE(sum.substr(strings[1].size()) == strings[1]);
+        REQUIRE(sum.c_str() == long_str + long_str + long_str + long_str);
+        REQUIRE(strings[0].substr(5, 20) == long_str.substr(5, 20));
+        REQUIRE((strings[0] + strings[0]) == strings[1]);
+      }
+    }
+  }
+  GIVEN("repeated strings") {
+    const char* const values[] = {"long enough string to be serialized",
+                                  "a", "long enough string to be serialized",
+                                  "a"};
+    const auto plain = serialize(std::begin(values), std::end(values));
+    const auto deduped = serialize(std::begin(values), std::end(values), true);
+
+    THEN("dedup writes them once") {
+      REQUIRE(deduped.size() < plain.size());
+      REQUIRE(deduped.size() == 16 + 1 + 36 + 1 + 2 + 1 + 1);
+    }
+    THEN("references to earlier strings share their characters") {
+      const auto strings = deserialize(deduped);
+      REQUIRE(strings.size() == 4);
+      REQUIRE(strings[2] == "long enough string to be serialized");
+      REQUIRE(strings[2].data() == strings[0].data());
+      REQUIRE(strings[3] == "a");
+      REQUIRE(deserialize(plain)[2] == strings[2]);
+    }
+  }
+  GIVEN("a serializer of wide strings") {
+    wserializer writer{true};
+    writer.write(L"x");
+    writer.write(L"long enough wide string to be serialized");
+    writer.write(wstring{L"long enough wide string to be serialized"});
+    REQUIRE(writer.count() == 3);
+    const auto buffer = writer.finish();
+
+    THEN("the characters are aligned and read back") {
+      const auto strings = deserialize<wstring>(buffer);
+      REQUIRE(strings.size() == 3);
+      REQUIRE(strings[0].compare(L"x") == 0);
+      REQUIRE(strings[1].compare(L"long enough wide string to be serialized") ==
+              0);
+      REQUIRE(reinterpret_cast<std::uintptr_t>(strings[1].data()) %
+                  alignof(wchar_t) ==
+              0);
+      REQUIRE(strings[2].data() == strings[1].data());
+    }
+    THEN("it can't be read as narrow strings") {
+      REQUIRE_THROWS_AS(deserialize(buffer), std::invalid_argument);
+    }
+  }
+  GIVEN("malformed buffers") {
+    const std::vector<string> values{long_str};
+    const auto buffer = serialize(values.begin(), values.end());
+
+    THEN("deserialization throws") {
+      REQUIRE_THROWS_AS(deserialize(string{"ISTR"}), std::invalid_argument);
+      REQUIRE_THROWS_AS(deserialize(buffer.substr(0, buffer.size() - 1)),
+                        std::invalid_argument);
+      REQUIRE_THROWS_AS(deserialize(buffer.concat(string{"x"})),
+                        std::invalid_argument);
+      std::string bad_count{buffer.data(), buffer.size()};
+      bad_count[8] = 2;
+      REQUIRE_THROWS_AS(deserialize(string{bad_count.data(), bad_count.size()}),
+                        std::invalid_argument);
+      std::string bad_ref = bad_count.substr(0, 16) + '\x01';
+      bad_ref[8] = 1;
+      REQUIRE_THROWS_AS(deserialize(string{bad_ref.data(), bad_ref.size()}),
+                        std::invalid_argument);
+    }
+    THEN("the empty sequence is valid") {
+      const std::vector<string> none;
+      REQUIRE(deserialize(serialize(none.begin(), none.end())).empty());
+    }
+  }
+}
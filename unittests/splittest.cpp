@@ -0,0 +1,105 @@
+#include "allocator_with_count.hpp"
+#include "catch2/catch.hpp"
+#include "immutable_string/split.hpp"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace immutable_string;
+
+using string_count_alloc =
+    basic_string<char, std::char_traits<char>, allocator_with_count<char>>;
+
+SCENARIO("strings are split out of a buffer", "[split]") {
+  int allocated_count = 0;
+  auto allocator = allocator_with_count<char>{allocated_count};
+
+  GIVEN("lines of short and long records") {
+    const std::string input =
+        "first long enough line of the input\nshort\n\n"
+        "second long enough line of the input\n";
+    const auto lines = split<string_count_alloc>(input.data(), input.size(),
+                                                 '\n', allocator);
+
+    THEN("there is a string per line and one buffer for all") {
+      REQUIRE(lines.size() == 5);
+      REQUIRE(lines[0] == "first long enough line of the input");
+      REQUIRE(lines[1] == "short");
+      REQUIRE(lines[2].empty());
+      REQUIRE(lines[3] == "second long enough line of the input");
+      REQUIRE(lines[4].empty());
+      REQUIRE(allocated_count == 1);
+      REQUIRE(lines[3].data() == lines[0].data() + 43);
+    }
+    THEN("each string is null-terminated") {
+      for (const auto& line : lines) {
+        REQUIRE(std::strlen(line.c_str()) == line.size());
+      }
+    }
+    THEN("the strings outlive the source") {
+      auto copy = lines[3];
+      std::vector<string_count_alloc>{lines}.clear();
+      REQUIRE(copy == "second long enough line of the input");
+    }
+  }
+  GIVEN("a short input") {
+    const auto fields = split(std::string{"a,b,"}.c_str(), 4, ',');
+    THEN("the fields are inline") {
+      REQUIRE(fields.size() == 3);
+      REQUIRE(fields[0] == "a");
+      REQUIRE(fields[1] == "b");
+      REQUIRE(fields[2].empty());
+    }
+  }
+  GIVEN("a string") {
+    const string str{"one long enough field;two long enough field"};
+    const auto fields = split(str, ';');
+    THEN("the fields share its buffer") {
+      REQUIRE(fields.size() == 2);
+      REQUIRE(fields[0] == "one long enough field");
+      REQUIRE(fields[1] == "two long enough field");
+      REQUIRE(fields[0].data() == str.data());
+      REQUIRE(fields[1].data() == str.data() + 22);
+      REQUIRE(std::strlen(fields[0].c_str()) == fields[0].size());
+      REQUIRE(std::strlen(fields[1].c_str()) == fields[1].size());
+    }
+  }
+}
+
+SCENARIO("strings are made of records at offsets", "[split]") {
+  int allocated_count = 0;
+  auto allocator = allocator_with_count<char>{allocated_count};
+
+  GIVEN("records in any order") {
+    const std::string input =
+        "header,long enough value of a record,x,another long enough value";
+    const std::size_t offsets[] = {39, 7, 37, 0};
+    const std::size_t lengths[] = {25, 29, 1, 6};
+    const auto strs = make_strings<string_count_alloc>(input.data(), offsets,
+                                                       lengths, 4, allocator);
+
+    THEN("long records are copied into one buffer") {
+      REQUIRE(strs.size() == 4);
+      REQUIRE(strs[0] == "another long enough value");
+      REQUIRE(strs[1] == "long enough value of a record");
+      REQUIRE(strs[2] == "x");
+      REQUIRE(strs[3] == "header");
+      REQUIRE(allocated_count == 1);
+      REQUIRE(strs[1].data() == strs[0].data() + 26);
+      REQUIRE(std::strlen(strs[0].c_str()) == strs[0].size());
+    }
+  }
+  GIVEN("no long records") {
+    const char input[] = "ab";
+    const std::size_t offsets[] = {0, 1};
+    const std::size_t lengths[] = {1, 1};
+    const auto strs = make_strings<string_count_alloc>(input, offsets,
+                                                       lengths, 2, allocator);
+    THEN("nothing is allocated") {
+      REQUIRE(strs[0] == "a");
+      REQUIRE(strs[1] == "b");
+      REQUIRE(allocated_count == 0);
+    }
+  }
+}
@@ -0,0 +1,120 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/builder.hpp"
+#include "immutable_string/stats.hpp"
+#include "immutable_string/string.hpp"
+
+#include <thread>
+#include <vector>
+
+using namespace immutable_string;
+
+static_assert(stats::enabled, "the test is built with the stats enabled");
+
+SCENARIO("stats count buffers, copies and lengths", "[stats]") {
+  GIVEN("the stats before making strings") {
+    const auto before = stats::collect();
+
+    WHEN("long and short strings are made and copied") {
+      {
+        const string long_str{"long enough string to be counted"};
+        const string short_str{"short"};
+        const auto copy = long_str;
+        const auto slice = long_str.substr(5);
+        const auto during = stats::collect();
+
+        THEN("live buffers and copies are counted") {
+          REQUIRE(during.buffers_allocated - before.buffers_allocated == 1);
+          REQUIRE(during.live_buffers() - before.live_buffers() == 1);
+          REQUIRE(during.live_bytes() - before.live_bytes() >=
+                  long_str.size());
+          REQUIRE(during.copies - before.copies == 2);
+        }
+        THEN("lengths are counted by powers of 2") {
+          REQUIRE(during.lengths[6] - before.lengths[6] == 1);
+          REQUIRE(during.lengths[3] - before.lengths[3] == 1);
+        }
+      }
+      const auto after = stats::collect();
+
+      THEN("freed buffers are counted") {
+        REQUIRE(after.live_buffers() == before.live_buffers());
+        REQUIRE(after.live_bytes() == before.live_bytes());
+      }
+    }
+    WHEN("a builder and a concatenation make buffers") {
+      {
+        string_builder builder{80};
+        builder.append(80, 'x');
+        const auto str = builder.freeze();
+        const auto twice = str + str;
+        twice.c_str();
+        REQUIRE(stats::collect().live_buffers() - before.live_buffers() == 3);
+      }
+
+      THEN("all of them are freed") {
+        REQUIRE(stats::collect().live_buffers() == before.live_buffers());
+      }
+    }
+    WHEN("a slice isn't followed by a zero") {
+      {
+        const string str{"long enough string, cut before the comma"};
+        const auto slice = str.substr(0, 18);
+        slice.c_str();
+        REQUIRE(stats::collect().live_buffers() - before.live_buffers() == 3);
+      }
+
+      THEN("its node and terminated copy are counted and freed") {
+        REQUIRE(stats::collect().live_buffers() == before.live_buffers());
+        REQUIRE(stats::collect().live_bytes() == before.live_bytes());
+      }
+    }
+    WHEN("other threads make strings") {
+      std::thread thread{[] {
+        for (int i = 0; i < 100; ++i) {
+          const string str{"long enough string of another thread"};
+          const auto copy = str;
+        }
+      }};
+      thread.join();
+      const auto after = stats::collect();
+
+      THEN("their counters are kept after they finish") {
+        REQUIRE(after.buffers_allocated - before.buffers_allocated == 100);
+        REQUIRE(after.copies - before.copies == 100);
+        REQUIRE(after.live_buffers() == before.live_buffers());
+      }
+    }
+    WHEN("a buffer is freed after the stats of its thread") {
+      std::thread thread{[] {
+        // constructed before the stats of the thread, so destroyed after
+        // them, as static objects are after the thread locals of main()
+        thread_local string late;
+        late = string{"long enough string freed after the thread stats"};
+      }};
+      thread.join();
+      const auto after = stats::collect();
+
+      THEN("the free is counted anyway") {
+        REQUIRE(after.buffers_freed - before.buffers_freed == 1);
+        REQUIRE(after.live_buffers() == before.live_buffers());
+        REQUIRE(after.live_bytes() == before.live_bytes());
+      }
+    }
+    WHEN("threads start and finish while the stats are collected") {
+      std::vector<std::thread> threads;
+      for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([] {
+          const string str{"long enough string of another thread"};
+          stats::collect();
+        });
+      }
+      for (auto& thread : threads) thread.join();
+      const auto after = stats::collect();
+
+      THEN("every thread is counted once") {
+        REQUIRE(after.buffers_allocated - before.buffers_allocated == 8);
+        REQUIRE(after.live_buffers() == before.live_buffers());
+      }
+    }
+  }
+}
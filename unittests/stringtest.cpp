@@ -2,14 +2,27 @@
 #include "catch2/catch.hpp"
 #include "immutable_string/string.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <cstring>
+#include <cwchar>
+#include <random>
+#include <string>
+#include <thread>
 #include <type_traits>
+#include <unordered_set>
+#include <vector>
 
 using namespace immutable_string;
 
 using string_count_alloc =
     basic_string<char, std::char_traits<char>, allocator_with_count<char>>;
 
+static_assert(std::is_nothrow_default_constructible<string>::value,
+              "string shall be nothrow default-constructible");
+static_assert(std::is_nothrow_constructible<string_count_alloc,
+                                            allocator_with_count<char>&>::value,
+              "string shall be nothrow constructible from allocator");
 static_assert(std::is_nothrow_copy_constructible<string>::value,
               "string shall be nothrow copy-constructible");
 static_assert(std::is_nothrow_copy_assignable<string>::value,
@@ -44,6 +57,34 @@ SCENARIO("empty string construction", "[string]") {
   }
 }
 
+SCENARIO("empty string construction does not allocate", "[string]") {
+  int allocated_count = 0;
+  auto allocator = allocator_with_count<char>{allocated_count};
+
+  GIVEN("string constructed with allocator only") {
+    string_count_alloc str{allocator};
+    REQUIRE_EMPTY(str);
+    REQUIRE(allocated_count == 0);
+  }
+  GIVEN("string constructed from empty cstr with allocator") {
+    string_count_alloc str{"", allocator};
+    REQUIRE_EMPTY(str);
+    REQUIRE(allocated_count == 0);
+  }
+  GIVEN("string constructed with same character repeated 0 times") {
+    string_count_alloc str{0, '1', allocator};
+    REQUIRE_EMPTY(str);
+    REQUIRE(allocated_count == 0);
+  }
+  GIVEN("many default-constructed strings") {
+    std::vector<string_count_alloc> strs(1000, string_count_alloc{allocator});
+    auto copy = strs;
+
+    REQUIRE_EMPTY(copy.back());
+    REQUIRE(allocated_count == 0);
+  }
+}
+
 SCENARIO("non-empty string construction", "[string]") {
   GIVEN("string constructed from test cstr") {
     string str{"test"};
@@ -66,10 +107,10 @@ SCENARIO("non-empty string construction", "[string]") {
 }
 
 SCENARIO("string is copyable without new allocations", "[string]") {
-  GIVEN("some test string constructed with allocator with count") {
+  GIVEN("some long test string constructed with allocator with count") {
     int allocated_count = 0;
     auto allocator = allocator_with_count<char>{allocated_count};
-    string_count_alloc test_str{"test", allocator};
+    string_count_alloc test_str{"long enough test string", allocator};
 
     REQUIRE(allocated_count == 1);
 
@@ -85,7 +126,7 @@ SCENARIO("string is copyable without new allocations", "[string]") {
       THEN("allocated count is 1") { REQUIRE(allocated_count == 1); }
     }
     WHEN("new string is created and test string is assigned to it") {
-      string_count_alloc new_str{allocator};
+      string_count_alloc new_str{"another long test string", allocator};
       REQUIRE(allocated_count == 2);
 
       new_str = test_str;
@@ -101,38 +142,138 @@ SCENARIO("string is copyable without new allocations", "[string]") {
   }
 }
 
-SCENARIO("string is movable", "[string]") {
-  GIVEN("some test string") {
+SCENARIO("short string is stored inline", "[string]") {
+  static_assert(string::inline_capacity >= 7,
+                "inline buffer shall fit at least a pointer-sized string");
+
+  GIVEN("some short test string constructed with allocator with count") {
     int allocated_count = 0;
     auto allocator = allocator_with_count<char>{allocated_count};
     string_count_alloc test_str{"test", allocator};
 
+    THEN("nothing is allocated") { REQUIRE(allocated_count == 0); }
+    THEN("data points inside the string object") {
+      const auto obj = reinterpret_cast<const char*>(&test_str);
+      REQUIRE(test_str.data() >= obj);
+      REQUIRE(test_str.data() < obj + sizeof(test_str));
+    }
+
+    WHEN("new string is copy-constructed") {
+      string_count_alloc new_str{test_str};
+
+      THEN("it has its own copy of characters") {
+        REQUIRE(test_str.data() != new_str.data());
+        REQUIRE(std::strcmp(new_str.c_str(), "test") == 0);
+      }
+      THEN("nothing is allocated") { REQUIRE(allocated_count == 0); }
+    }
+  }
+  GIVEN("string of exactly inline_capacity characters") {
+    int allocated_count = 0;
+    auto allocator = allocator_with_count<char>{allocated_count};
+    string_count_alloc test_str{string::inline_capacity, 'x', allocator};
+
+    REQUIRE(allocated_count == 0);
+    REQUIRE(test_str.size() == string::inline_capacity);
+    REQUIRE(test_str[string::inline_capacity] == 0);
+
+    WHEN("string is one character longer") {
+      string_count_alloc long_str{string::inline_capacity + 1, 'x', allocator};
+
+      THEN("it is allocated on heap") { REQUIRE(allocated_count == 1); }
+    }
+  }
+}
+
+SCENARIO("long string keeps header and characters in one block", "[string]") {
+  static_assert(sizeof(string) == 3 * sizeof(void*),
+                "string shall be data pointer, buffer pointer and size");
+
+  GIVEN("long strings of different character types") {
+    int allocated_count = 0;
+    auto allocator = allocator_with_count<wchar_t>{allocated_count};
+    basic_string<wchar_t, std::char_traits<wchar_t>,
+                 allocator_with_count<wchar_t>>
+        wide_str{L"long enough wide test string", allocator};
+
+    THEN("string has one allocation") { REQUIRE(allocated_count == 1); }
+    THEN("characters are null-terminated") {
+      REQUIRE(wide_str.size() == 28);
+      REQUIRE(std::wcscmp(wide_str.c_str(), L"long enough wide test string") ==
+              0);
+    }
+  }
+}
+
+SCENARIO("string with plain refcount", "[string]") {
+  using plain_string = basic_string<char, std::char_traits<char>,
+                                    allocator_with_count<char>, plain_refcount>;
+  static_assert(!std::is_same<plain_string::refcount_type,
+                              string::refcount_type>::value,
+                "refcount policy shall be a part of string type");
+
+  GIVEN("some long test string") {
+    int allocated_count = 0;
+    auto allocator = allocator_with_count<char>{allocated_count};
+    plain_string test_str{"long enough test string", allocator};
+
+    WHEN("it is copied many times") {
+      std::vector<plain_string> copies(100, test_str);
+      copies.erase(copies.begin(), copies.begin() + 50);
+
+      THEN("all copies share the buffer") {
+        REQUIRE(copies.front().data() == test_str.data());
+        REQUIRE(copies.back().data() == test_str.data());
+        REQUIRE(allocated_count == 1);
+      }
+      THEN("buffer outlives the original string") {
+        test_str = plain_string{allocator};
+        REQUIRE(copies.back() == "long enough test string");
+      }
+    }
+  }
+}
+
+SCENARIO("string is movable", "[string]") {
+  GIVEN("some long test string") {
+    int allocated_count = 0;
+    auto allocator = allocator_with_count<char>{allocated_count};
+    string_count_alloc test_str{"long enough test string", allocator};
+
     WHEN("new string is move-constructed") {
       string_count_alloc new_str{std::move(test_str)};
 
       THEN("new string has test string") {
-        REQUIRE(std::strcmp(new_str.data(), "test") == 0);
-      }
-      THEN("test string is unusable and point to nullptr") {
-        REQUIRE(test_str.data() == nullptr);
+        REQUIRE(std::strcmp(new_str.data(), "long enough test string") == 0);
       }
+      THEN("test string is left empty") { REQUIRE_EMPTY(test_str); }
       THEN("allocated count is 1") { REQUIRE(allocated_count == 1); }
     }
     WHEN("new string is creeated and test string is move-assigned to it") {
-      string_count_alloc new_str{allocator};
+      string_count_alloc new_str{"another long test string", allocator};
       REQUIRE(allocated_count == 2);
 
       new_str = std::move(test_str);
 
       THEN("new string has test string") {
-        REQUIRE(std::strcmp(new_str.data(), "test") == 0);
-      }
-      THEN("test string is unusable and point to nullptr") {
-        REQUIRE(test_str.data() == nullptr);
+        REQUIRE(std::strcmp(new_str.data(), "long enough test string") == 0);
       }
+      THEN("test string is left empty") { REQUIRE_EMPTY(test_str); }
       THEN("allocated count is 2") { REQUIRE(allocated_count == 2); }
     }
   }
+  GIVEN("some short test string") {
+    string test_str{"test"};
+
+    WHEN("new string is move-constructed") {
+      string new_str{std::move(test_str)};
+
+      THEN("new string has test string") {
+        REQUIRE(std::strcmp(new_str.data(), "test") == 0);
+      }
+      THEN("test string is left empty") { REQUIRE_EMPTY(test_str); }
+    }
+  }
 }
 
 SCENARIO("string's element access", "[string]") {
@@ -189,6 +330,24 @@ SCENARIO("iterators usage") {
       }
     }
   }
+  GIVEN("a wide string") {
+    const wstring wide_str{L"long enough wide string to iterate"};
+
+    THEN("its iterators are pointers to its characters") {
+      static_assert(std::is_same<wstring::iterator, const wchar_t*>::value,
+                    "iterators shall point to CharT");
+      REQUIRE(wide_str.begin() == wide_str.data());
+      REQUIRE(wide_str.end() == wide_str.data() + wide_str.size());
+      REQUIRE(*wide_str.rbegin() == L'e');
+    }
+    THEN("standard algorithms work over them") {
+      const std::wstring copy(wide_str.begin(), wide_str.end());
+      REQUIRE(copy == L"long enough wide string to iterate");
+      REQUIRE(std::count(wide_str.begin(), wide_str.end(), L'e') == 4);
+      REQUIRE(std::find(wide_str.begin(), wide_str.end(), L'w') ==
+              wide_str.begin() + 12);
+    }
+  }
 }
 
 SCENARIO("string comparison") {
@@ -248,7 +407,7 @@ SCENARIO("string vs const char* comparison") {
     REQUIRE_FALSE("abcd" > str);
     REQUIRE_FALSE("abcd" != str);
 
-    REQUIRE(allocated_count == 1);
+    REQUIRE(allocated_count == 0);
   }
   GIVEN("str < abcde") {
     int allocated_count = 0;
@@ -270,7 +429,7 @@ SCENARIO("string vs const char* comparison") {
     REQUIRE_FALSE("abcde" <= str);
     REQUIRE_FALSE("abcde" == str);
 
-    REQUIRE(allocated_count == 1);
+    REQUIRE(allocated_count == 0);
   }
   GIVEN("str > abcc") {
     int allocated_count = 0;
@@ -292,7 +451,48 @@ SCENARIO("string vs const char* comparison") {
     REQUIRE_FALSE("abcc" >= str);
     REQUIRE_FALSE("abcc" == str);
 
-    REQUIRE(allocated_count == 1);
+    REQUIRE(allocated_count == 0);
+  }
+}
+
+SCENARIO("string ordering agrees with std::string") {
+  GIVEN("strings which differ at every position around the prefix word") {
+    std::vector<std::string> values;
+    const std::string base(40, 'k');
+    for (std::size_t pos : {0, 1, 6, 7, 8, 9, 15, 16, 17, 39}) {
+      for (char ch : {'\x01', 'a', 'k', 'z', '\x80', '\xff'}) {
+        auto value = base;
+        value[pos] = ch;
+        values.push_back(value);
+        values.push_back(value.substr(0, pos + 1));
+      }
+    }
+    const auto sign = [](int x) { return (x > 0) - (x < 0); };
+
+    THEN("comparisons of all the pairs give the same results") {
+      for (const auto& lhs : values) {
+        for (const auto& rhs : values) {
+          const string str1{lhs.c_str(), lhs.size()};
+          const string str2{rhs.c_str(), rhs.size()};
+          REQUIRE(sign(str1.compare(str2)) == sign(lhs.compare(rhs)));
+          REQUIRE(sign(str1.compare(rhs.c_str())) == sign(lhs.compare(rhs)));
+          REQUIRE((str1 < str2) == (lhs < rhs));
+          REQUIRE((str1 == str2) == (lhs == rhs));
+          REQUIRE((str1 == rhs.c_str()) == (lhs == rhs));
+        }
+      }
+    }
+  }
+  GIVEN("a C string much longer than the string") {
+    const std::string long_value(100000, 'x');
+    const string str{"xxxx"};
+
+    THEN("it is ordered after the string") {
+      REQUIRE(str.compare(long_value.c_str()) < 0);
+      REQUIRE(str != long_value.c_str());
+      REQUIRE(str < long_value.c_str());
+      REQUIRE(str.compare(0, 4, long_value.c_str()) < 0);
+    }
   }
 }
 
@@ -318,3 +518,547 @@ SCENARIO("find substring in a string") {
     }
   }
 }
+
+namespace {
+
+// compares characters case-insensitively, so it can't be searched bytewise
+struct ci_char_traits : std::char_traits<char> {
+  static char lower(char ch) { return static_cast<char>(std::tolower(ch)); }
+  static bool eq(char lhs, char rhs) { return lower(lhs) == lower(rhs); }
+  static bool lt(char lhs, char rhs) { return lower(lhs) < lower(rhs); }
+  static int compare(const char* lhs, const char* rhs, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      if (!eq(lhs[i], rhs[i])) return lt(lhs[i], rhs[i]) ? -1 : 1;
+    }
+    return 0;
+  }
+  static const char* find(const char* s, std::size_t count, char ch) {
+    for (std::size_t i = 0; i < count; ++i) {
+      if (eq(s[i], ch)) return s + i;
+    }
+    return nullptr;
+  }
+};
+
+}  // namespace
+
+SCENARIO("find substring in a long string") {
+  GIVEN("long strings made of few distinct characters") {
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> char_dist{'a', 'c'};
+    const auto random_string = [&](std::size_t len) {
+      std::string res(len, ' ');
+      for (auto& ch : res) ch = static_cast<char>(char_dist(gen));
+      return res;
+    };
+
+    THEN("find agrees with std::string for short and long needles") {
+      for (std::size_t hay_len : {0, 5, 16, 31, 33, 64, 100, 1000}) {
+        const auto hay = random_string(hay_len);
+        const string test_str{hay.c_str(), hay.size()};
+        for (std::size_t needle_len = 0; needle_len <= 40; ++needle_len) {
+          // needles which exist in the haystack and random ones
+          const auto random = random_string(needle_len);
+          const auto existing = needle_len <= hay_len
+                                    ? hay.substr(hay_len - needle_len)
+                                    : random;
+          for (const auto& needle : {random, existing}) {
+            for (std::size_t pos : {std::size_t(0), std::size_t(3), hay_len}) {
+              REQUIRE(test_str.find(needle.c_str(), pos, needle.size()) ==
+                      hay.find(needle, pos));
+            }
+          }
+        }
+      }
+    }
+  }
+  GIVEN("string with a marker at the end") {
+    std::string hay(5000, 'x');
+    hay += "<marker-which-is-longer-than-32-characters>";
+    const string test_str{hay.c_str(), hay.size()};
+
+    REQUIRE(test_str.find("<marker-which-is-longer-than-32-characters>") ==
+            5000);
+    REQUIRE(test_str.find("<marker") == 5000);
+    REQUIRE(test_str.find("characters>>") == string::npos);
+    REQUIRE(test_str.find('<', 10) == 5000);
+    REQUIRE(test_str.find("", 10) == 10);
+    REQUIRE(test_str.find("", test_str.size() + 1) == string::npos);
+  }
+  GIVEN("wide string") {
+    const wstring test_str{L"aaabbbcccddd aaabbbcccddd"};
+
+    REQUIRE(test_str.find(L"cddd") == 8);
+    REQUIRE(test_str.find(L"cddd", 9) == 21);
+    REQUIRE(test_str.find(L'b', 7) == 16);
+    REQUIRE(test_str.find(L"dc") == string::npos);
+  }
+  GIVEN("string with case-insensitive traits") {
+    using ci_string = basic_string<char, ci_char_traits>;
+    const ci_string test_str{"Some Long Haystack With Mixed Case Characters"};
+
+    REQUIRE(test_str.find("haystack") == 10);
+    REQUIRE(test_str.find("WITH MIXED CASE") == 19);
+    REQUIRE(test_str.find('l') == 5);
+    REQUIRE(test_str.find("needle") == ci_string::npos);
+  }
+}
+
+SCENARIO("reverse and character set searches") {
+  GIVEN("random strings of few distinct characters") {
+    std::mt19937 gen{43};
+    std::uniform_int_distribution<int> char_dist{'a', 'e'};
+    const auto random_string = [&](std::size_t len) {
+      std::string res(len, ' ');
+      for (auto& ch : res) ch = static_cast<char>(char_dist(gen));
+      return res;
+    };
+
+    THEN("they agree with std::string") {
+      for (std::size_t hay_len : {0, 1, 5, 31, 32, 33, 64, 100, 300}) {
+        const auto hay = random_string(hay_len);
+        const string test_str{hay.c_str(), hay.size()};
+        // sets of the characters of the string and of others
+        for (const std::string set : {"", "a", "ab", "abcd", "abcde", "xyz",
+                                      "e\xff\x80"}) {
+          for (std::size_t pos : {std::size_t(0), std::size_t(3),
+                                  std::size_t(40), hay_len, string::npos}) {
+            REQUIRE(test_str.find_first_of(set.c_str(), pos, set.size()) ==
+                    hay.find_first_of(set, pos));
+            REQUIRE(test_str.find_last_of(set.c_str(), pos, set.size()) ==
+                    hay.find_last_of(set, pos));
+            REQUIRE(test_str.find_first_not_of(set.c_str(), pos,
+                                               set.size()) ==
+                    hay.find_first_not_of(set, pos));
+            REQUIRE(test_str.find_last_not_of(set.c_str(), pos,
+                                              set.size()) ==
+                    hay.find_last_not_of(set, pos));
+          }
+        }
+        for (std::size_t needle_len = 0; needle_len <= 4; ++needle_len) {
+          const auto needle = random_string(needle_len);
+          for (std::size_t pos : {std::size_t(0), std::size_t(3),
+                                  std::size_t(40), string::npos}) {
+            REQUIRE(test_str.rfind(needle.c_str(), pos, needle.size()) ==
+                    hay.rfind(needle, pos));
+          }
+        }
+      }
+    }
+  }
+  GIVEN("a string of all the byte values") {
+    std::string hay;
+    for (int ch = 0; ch < 256; ++ch) hay += static_cast<char>(ch);
+    const string test_str{hay.data(), hay.size()};
+
+    THEN("every byte is found as a set of one and of two") {
+      for (int ch = 0; ch < 256; ++ch) {
+        const char set[] = {static_cast<char>(ch), '\x7f'};
+        REQUIRE(test_str.find_first_of(set, 0, 1) ==
+                static_cast<std::size_t>(ch));
+        REQUIRE(test_str.find_last_of(set, string::npos, 1) ==
+                static_cast<std::size_t>(ch));
+        REQUIRE(test_str.find_first_of(set, 0, 2) ==
+                static_cast<std::size_t>(std::min(ch, 0x7f)));
+        REQUIRE(test_str.find_last_of(set, string::npos, 2) ==
+                static_cast<std::size_t>(std::max(ch, 0x7f)));
+      }
+    }
+  }
+  GIVEN("a concatenation") {
+    const string left{"long enough left part, "};
+    const auto test_str = left + string{"and long enough right part"};
+
+    THEN("it is searched as a whole") {
+      REQUIRE(test_str.rfind("part") == 45);
+      REQUIRE(test_str.rfind("part", 44) == 17);
+      REQUIRE(test_str.rfind('l') == 27);
+      REQUIRE(test_str.find_first_of(",;") == 21);
+      REQUIRE(test_str.find_last_not_of("part ") == 42);
+      REQUIRE(test_str.contains("part, and"));
+    }
+  }
+  GIVEN("wide strings") {
+    const wstring test_str{L"aaabbbcccddd aaabbbcccddd"};
+
+    REQUIRE(test_str.rfind(L"cddd") == 21);
+    REQUIRE(test_str.rfind(L"cddd", 20) == 8);
+    REQUIRE(test_str.find_first_of(L"dc") == 6);
+    REQUIRE(test_str.find_last_of(L"ab", 20) == 18);
+    REQUIRE(test_str.find_first_not_of(L"ab") == 6);
+    REQUIRE(test_str.find_last_not_of(L'd') == 21);
+    REQUIRE(test_str.find_first_of(L"xyz") == wstring::npos);
+  }
+}
+
+SCENARIO("prefix, suffix and containment") {
+  GIVEN("a long string") {
+    const string test_str{"some long enough string with a suffix"};
+
+    THEN("prefixes and suffixes of any kind are found") {
+      REQUIRE(test_str.starts_with("some long"));
+      REQUIRE(test_str.starts_with(string{"some"}));
+      REQUIRE(test_str.starts_with('s'));
+      REQUIRE(test_str.starts_with(""));
+      REQUIRE_FALSE(test_str.starts_with("some short"));
+      REQUIRE_FALSE(test_str.starts_with('x'));
+      REQUIRE_FALSE(
+          test_str.starts_with("some long enough string with a suffix!"));
+      REQUIRE(test_str.ends_with("a suffix"));
+      REQUIRE(test_str.ends_with(string{"with a suffix"}));
+      REQUIRE(test_str.ends_with('x'));
+      REQUIRE(test_str.ends_with(test_str));
+      REQUIRE_FALSE(test_str.ends_with("a prefix"));
+      REQUIRE_FALSE(string{}.ends_with('x'));
+      REQUIRE(test_str.contains("string"));
+      REQUIRE(test_str.contains('w'));
+      REQUIRE_FALSE(test_str.contains("strings"));
+    }
+    THEN("slices of its buffer are found at their places") {
+      const auto prefix = test_str.substr(0, 20);
+      const auto suffix = test_str.substr(17);
+      REQUIRE(test_str.starts_with(prefix));
+      REQUIRE(test_str.ends_with(suffix));
+      REQUIRE_FALSE(test_str.ends_with(prefix));
+      REQUIRE_FALSE(test_str.starts_with(suffix));
+    }
+    THEN("concatenations are compared piece by piece") {
+      const auto prefix = string{"some long enough "} + string{"string with"};
+      REQUIRE(test_str.starts_with(prefix));
+      REQUIRE((prefix + string{" a suffix"}).ends_with("with a suffix"));
+      REQUIRE_FALSE(test_str.ends_with(prefix));
+    }
+  }
+}
+
+SCENARIO("substring of a string") {
+  GIVEN("long test string constructed with allocator with count") {
+    int allocated_count = 0;
+    auto allocator = allocator_with_count<char>{allocated_count};
+    string_count_alloc test_str{"field1,long enough field2,field3", allocator};
+    REQUIRE(allocated_count == 1);
+
+    WHEN("long substring is taken") {
+      const auto sub = test_str.substr(7, 18);
+
+      THEN("it has the given characters") {
+        REQUIRE(sub == "long enough field2");
+        REQUIRE(sub.size() == 18);
+      }
+      THEN("it shares the buffer of the parent") {
+        REQUIRE(sub.data() == test_str.data() + 7);
+        // only the slice node, as "field2" isn't followed by a zero
+        REQUIRE(allocated_count == 2);
+      }
+      THEN("it outlives the parent") {
+        test_str = string_count_alloc{allocator};
+        REQUIRE(sub == "long enough field2");
+      }
+      THEN("compacted substring has its own buffer") {
+        const auto compacted = sub.compact(allocator);
+        REQUIRE(compacted == "long enough field2");
+        REQUIRE(compacted.data() != sub.data());
+        REQUIRE(compacted[compacted.size()] == 0);
+        REQUIRE(allocated_count == 3);
+      }
+      THEN("its c_str() is null-terminated") {
+        REQUIRE(std::strlen(sub.c_str()) == 18);
+        REQUIRE(std::strcmp(sub.c_str(), "long enough field2") == 0);
+        REQUIRE(sub.c_str() == sub.c_str());
+        REQUIRE(std::strlen(test_str.c_str()) == test_str.size());
+        // the terminated copy is made by the allocator too, once
+        REQUIRE(allocated_count == 3);
+      }
+    }
+    WHEN("long prefixes are taken") {
+      THEN("their c_str() are null-terminated") {
+        for (std::size_t n = 16; n <= test_str.size(); ++n) {
+          const auto sub = test_str.substr(0, n);
+          REQUIRE(std::strlen(sub.c_str()) == n);
+          REQUIRE(std::strlen(sub.substr(1).c_str()) == n - 1);
+        }
+        // only the allocator of the parent buffer is used: the prefixes
+        // but the whole string and their suffixes longer than
+        // inline_capacity make a slice node and a terminated copy each
+        REQUIRE(allocated_count == 1 + 2 + 15 * 4);
+      }
+    }
+    WHEN("short substring is taken") {
+      const auto sub = test_str.substr(0, 6);
+
+      THEN("it is copied inline") {
+        REQUIRE(sub == "field1");
+        REQUIRE(sub.data() != test_str.data());
+        REQUIRE(allocated_count == 1);
+      }
+    }
+    WHEN("substring till the end is taken") {
+      REQUIRE(test_str.substr(26) == "field3");
+      REQUIRE(test_str.substr(26, string::npos) == "field3");
+      REQUIRE(test_str.substr(test_str.size()).empty());
+    }
+    WHEN("whole string is taken") {
+      const auto sub = test_str.substr();
+
+      THEN("compacting it doesn't copy") {
+        REQUIRE(sub.compact(allocator).data() == test_str.data());
+        REQUIRE(allocated_count == 1);
+      }
+    }
+    WHEN("pos > size()") {
+      THEN("substr throws") {
+        REQUIRE_THROWS_AS(test_str.substr(test_str.size() + 1),
+                          std::out_of_range);
+      }
+    }
+  }
+}
+
+SCENARIO("string hash") {
+  GIVEN("equal strings with different representations") {
+    const string long_str{"long enough string to be hashed"};
+    const string other_long_str{"long enough string to be hashed"};
+    const string parent{"prefix:long enough string to be hashed"};
+    const auto slice = parent.substr(7);
+    const string short_str{"short"};
+
+    THEN("they have equal hashes") {
+      REQUIRE(long_str.hash() == other_long_str.hash());
+      REQUIRE(long_str.hash() == slice.hash());
+      REQUIRE(short_str.hash() == string{"short"}.hash());
+    }
+    THEN("cached hash doesn't change") {
+      const auto hash = long_str.hash();
+      REQUIRE(long_str.hash() == hash);
+      REQUIRE(string{long_str}.hash() == hash);
+    }
+    THEN("std::hash and hash_value use it") {
+      REQUIRE(std::hash<string>{}(long_str) == long_str.hash());
+      REQUIRE(hash_value(short_str) == short_str.hash());
+    }
+  }
+  GIVEN("different strings") {
+    const string str1{"long enough string to be hashed #1"};
+    const string str2{"long enough string to be hashed #2"};
+
+    THEN("they have different hashes") {
+      REQUIRE(str1.hash() != str2.hash());
+      REQUIRE(string{"a"}.hash() != string{"b"}.hash());
+    }
+    THEN("they are not equal when both hashes are cached") {
+      str1.hash();
+      str2.hash();
+      REQUIRE(str1 != str2);
+    }
+  }
+  GIVEN("unordered set of strings") {
+    std::unordered_set<string> set{"a", "b", "long enough string to be hashed"};
+
+    THEN("equal strings are found") {
+      REQUIRE(set.count("a") == 1);
+      REQUIRE(set.count(string{"long enough string to be hashed"}) == 1);
+      REQUIRE(set.count("c") == 0);
+    }
+  }
+  GIVEN("transparent hash and equality") {
+    const string long_str{"long enough string to be hashed"};
+    const string_hash hash;
+    const string_equal equal;
+
+    THEN("C strings hash and compare like strings") {
+      REQUIRE(hash("long enough string to be hashed") == long_str.hash());
+      REQUIRE(hash("short") == string{"short"}.hash());
+      const auto twice = long_str + long_str;
+      REQUIRE(hash(twice.c_str()) == twice.hash());
+      REQUIRE(equal(long_str, "long enough string to be hashed"));
+      REQUIRE(equal("long enough string to be hashed", long_str));
+      REQUIRE_FALSE(equal(long_str, "long enough"));
+      REQUIRE(equal(long_str, string{"long enough string to be hashed"}));
+    }
+    THEN("they work as the functors of an unordered set") {
+      std::unordered_set<string, string_hash, string_equal> set{"a",
+                                                                long_str};
+      REQUIRE(set.count(string{"long enough string to be hashed"}) == 1);
+      REQUIRE(set.count("a") == 1);
+    }
+  }
+}
+
+SCENARIO("string concatenation") {
+  const std::string long1(40, 'a');
+  const std::string long2(200, 'b');
+
+  GIVEN("short strings") {
+    const string str = string{"short"} + " one";
+
+    THEN("the result is a plain inline string") {
+      REQUIRE(str == "short one");
+      REQUIRE(std::strcmp(str.c_str(), "short one") == 0);
+      REQUIRE(str.size() == 9);
+    }
+  }
+  GIVEN("long strings constructed with allocator with count") {
+    int allocated_count = 0;
+    auto allocator = allocator_with_count<char>{allocated_count};
+    const string_count_alloc str1{long1.c_str(), allocator};
+    const string_count_alloc str2{long2.c_str(), allocator};
+    REQUIRE(allocated_count == 2);
+
+    WHEN("they are concatenated") {
+      const auto str = str1.concat(str2, allocator);
+      const auto expected = long1 + long2;
+
+      THEN("only the node is allocated") {
+        REQUIRE(allocated_count == 3);
+        REQUIRE(str.size() == expected.size());
+      }
+      THEN("characters are read without a flat copy") {
+        REQUIRE(str[0] == 'a');
+        REQUIRE(str[40] == 'b');
+        REQUIRE(str.at(239) == 'b');
+        REQUIRE(str.find("ab") == 39);
+        REQUIRE(str.find('b') == 40);
+        REQUIRE(str.compare(expected.c_str()) == 0);
+        REQUIRE(str > str1);
+        REQUIRE(str.hash() == string{expected.c_str()}.hash());
+        std::string pieces;
+        str.for_each_piece([&pieces](const char* piece, std::size_t count) {
+          pieces.append(piece, count);
+        });
+        REQUIRE(pieces == expected);
+        REQUIRE(allocated_count == 3);
+      }
+      THEN("c_str makes one flat copy and keeps it") {
+        const auto cstr = str.c_str();
+        REQUIRE(cstr == expected);
+        REQUIRE(allocated_count == 4);
+        REQUIRE(str.c_str() == cstr);
+        REQUIRE(string_count_alloc{str}.data() == cstr);
+        REQUIRE(allocated_count == 4);
+      }
+      THEN("substrings of one piece share its buffer") {
+        REQUIRE(str.substr(50, 100).data() == str2.data() + 10);
+        REQUIRE(str.substr(30, 20) == expected.substr(30, 20).c_str());
+        const auto middle = str.substr(10, 100);
+        REQUIRE(middle == expected.substr(10, 100).c_str());
+        REQUIRE(allocated_count <= 7);
+      }
+      THEN("compact makes a plain copy") {
+        const auto compacted = str.compact(allocator);
+        REQUIRE(compacted == str);
+        REQUIRE(compacted.c_str() == expected);
+        REQUIRE(allocated_count == 4);
+      }
+    }
+  }
+  GIVEN("a string built by many appends") {
+    string str;
+    std::string expected;
+    for (int i = 0; i < 2000; ++i) {
+      const auto piece = std::to_string(i) + (i % 7 == 0 ? long1 : "-");
+      str += string{piece.c_str()};
+      expected += piece;
+    }
+
+    THEN("it has all the pieces") {
+      REQUIRE(str.size() == expected.size());
+      REQUIRE(str == string{expected.c_str()});
+      REQUIRE(str.find("1999-") == expected.find("1999-"));
+      REQUIRE(std::strcmp(str.c_str(), expected.c_str()) == 0);
+    }
+  }
+  GIVEN("a concatenation of random pieces") {
+    std::mt19937 gen{5};
+    std::uniform_int_distribution<int> char_dist{'a', 'b'};
+    std::uniform_int_distribution<int> len_dist{0, 60};
+    std::string expected;
+    string str;
+    for (int i = 0; i < 50; ++i) {
+      std::string piece(len_dist(gen), ' ');
+      for (auto& ch : piece) ch = static_cast<char>(char_dist(gen));
+      str = str + string{piece.c_str(), piece.size()};
+      expected += piece;
+    }
+
+    THEN("hash over the pieces is the hash of the characters") {
+      REQUIRE(str.hash() == string{expected.c_str(), expected.size()}.hash());
+    }
+    THEN("find agrees with std::string across pieces") {
+      for (std::size_t len = 0; len <= 40; ++len) {
+        for (std::size_t pos : {0, 17, 500}) {
+          const auto needle = expected.substr(expected.size() / 2, len);
+          REQUIRE(str.find(needle.c_str(), pos, len) ==
+                  expected.find(needle, pos));
+          const auto other = needle + "a";
+          REQUIRE(str.find(other.c_str(), pos, other.size()) ==
+                  expected.find(other, pos));
+        }
+      }
+    }
+  }
+  GIVEN("a concatenation shared by many threads") {
+    const auto str = string{long1.c_str()} + string{long2.c_str()};
+    std::vector<const char*> results(4);
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < results.size(); ++t) {
+      threads.emplace_back([t, str, &results] { results[t] = str.c_str(); });
+    }
+    for (auto& thread : threads) thread.join();
+
+    THEN("all of them get the same flat copy") {
+      for (const auto result : results) REQUIRE(result == str.c_str());
+      REQUIRE(str.c_str() == long1 + long2);
+    }
+  }
+}
+
+SCENARIO("strings in static storage") {
+  GIVEN("a long string literal") {
+    static const char literal[] = "long string literal in static storage";
+    int allocated_count = 0;
+    auto allocator = allocator_with_count<char>{allocated_count};
+
+    WHEN("a string is made from it") {
+      const auto str = string_count_alloc::from_static(literal);
+
+      THEN("it refers to the literal itself") {
+        REQUIRE(str.data() == literal);
+        REQUIRE(str.size() == sizeof(literal) - 1);
+        REQUIRE(str == literal);
+      }
+      THEN("neither it nor its copies allocate") {
+        const auto copy = str;
+        std::vector<string_count_alloc> copies(100, copy);
+        REQUIRE(copies.back().data() == literal);
+        REQUIRE(copy.substr(5).data() == literal + 5);
+        REQUIRE(allocated_count == 0);
+      }
+      THEN("it is equal to the same characters in a buffer") {
+        const string_count_alloc heap_str{literal, allocator};
+        REQUIRE(str == heap_str);
+        REQUIRE(str.hash() == heap_str.hash());
+        REQUIRE(str.compact(allocator).data() != literal);
+      }
+    }
+  }
+  GIVEN("user-defined literals") {
+    const auto str = "long enough user-defined literal"_is;
+    const auto short_str = "short"_is;
+    const auto wide_str = L"long enough wide literal"_is;
+
+    THEN("they have the length of the literal") {
+      REQUIRE(str.size() == 32);
+      REQUIRE(str == "long enough user-defined literal");
+      REQUIRE(short_str == "short");
+      REQUIRE(wide_str.size() == 24);
+      REQUIRE(wide_str.compare(L"long enough wide literal") == 0);
+      REQUIRE(u"utf-16 literal of some length"_is.size() == 29);
+      REQUIRE(U"utf-32 literal"_is.size() == 14);
+    }
+    THEN("equal literals are equal strings") {
+      REQUIRE(str == string{"long enough user-defined literal"});
+      REQUIRE(str == "long enough user-defined literal"_is);
+    }
+  }
+}
@@ -0,0 +1,191 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/flat_map.hpp"
+#include "immutable_string/string.hpp"
+
+#include <iterator>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#if defined(__has_include)
+#if __has_include(<span>) && __cplusplus >= 202002L
+#include <span>
+#endif
+#endif
+
+using namespace immutable_string;
+
+#if defined(IMMUTABLE_STRING_STRING_VIEW)
+
+SCENARIO("string vs string_view comparison", "[string_view]") {
+  GIVEN("a string") {
+    const string str{"abcd"};
+
+    THEN("it compares with views by their sizes") {
+      REQUIRE(str.compare(std::string_view{"abcd"}) == 0);
+      REQUIRE(str.compare(std::string_view{"abcde"}) < 0);
+      REQUIRE(str.compare(std::string_view{"abc"}) > 0);
+      REQUIRE(str == std::string_view{"abcd"});
+      REQUIRE(std::string_view{"abcd"} == str);
+      REQUIRE(str != std::string_view{"abcd", 3});
+      REQUIRE(std::string_view{"abcc"} != str);
+    }
+    THEN("views need not be null-terminated") {
+      const char chars[] = {'a', 'b', 'c', 'd', 'e'};
+      REQUIRE(str == std::string_view(chars, 4));
+      REQUIRE(str < std::string_view(chars, 5));
+      REQUIRE(std::string_view(chars, 5) > str);
+    }
+    THEN("ordering is the same as for strings") {
+      REQUIRE(str < std::string_view{"abce"});
+      REQUIRE(str <= std::string_view{"abcd"});
+      REQUIRE(str > std::string_view{"abcc"});
+      REQUIRE(str >= std::string_view{"abcd"});
+      REQUIRE(std::string_view{"abcc"} < str);
+      REQUIRE(std::string_view{"abcd"} <= str);
+      REQUIRE(std::string_view{"abce"} > str);
+      REQUIRE(std::string_view{"abcd"} >= str);
+    }
+  }
+  GIVEN("a string with embedded zeros") {
+    const string str{"ab\0cd", 5};
+
+    THEN("all its characters are compared") {
+      REQUIRE(str == std::string_view("ab\0cd", 5));
+      REQUIRE(str != std::string_view("ab\0ce", 5));
+      REQUIRE(str > std::string_view("ab\0c", 4));
+    }
+  }
+}
+
+SCENARIO("string and string_view conversions", "[string_view]") {
+  GIVEN("a long string") {
+    const string str{"long enough string to be viewed"};
+
+    THEN("it converts to a view of its characters") {
+      const std::string_view sv = str;
+      REQUIRE(sv == "long enough string to be viewed");
+      REQUIRE(sv.data() == str.data());
+    }
+    THEN("a view of a substring doesn't need a terminator") {
+      const auto word = str.substr(5, 6);
+      const std::string_view sv = word;
+      REQUIRE(sv == "enough");
+    }
+    THEN("a view of a concatenation sees all its pieces") {
+      const auto twice = str + str;
+      const std::string_view sv = twice;
+      REQUIRE(sv.size() == 2 * str.size());
+      REQUIRE(sv.substr(str.size()) == "long enough string to be viewed");
+    }
+  }
+  GIVEN("a view") {
+    const std::string source{"characters of a view, not a C string"};
+    const std::string_view sv{source.data(), 10};
+
+    THEN("a string can be made of it") {
+      const string str{sv};
+      REQUIRE(str == "characters");
+      REQUIRE(str.size() == 10);
+      REQUIRE(string{std::string_view{source}} == source.c_str());
+    }
+  }
+}
+
+SCENARIO("string searches take string_views", "[string_view]") {
+  const string str{"some long enough string for the searches"};
+  const std::string_view some{"some"};
+  const std::string_view searches{"searches"};
+
+  REQUIRE(str.find(searches) == 32);
+  REQUIRE(str.rfind(std::string_view{"s"}) == 39);
+  REQUIRE(str.find_first_of(std::string_view{"gh"}) == 8);
+  REQUIRE(str.find_last_of(std::string_view{"gh"}) == 37);
+  REQUIRE(str.find_first_not_of(some) == 4);
+  REQUIRE(str.find_last_not_of(searches) == 31);
+  REQUIRE(str.starts_with(some));
+  REQUIRE(str.ends_with(searches));
+  REQUIRE_FALSE(str.ends_with(some));
+  REQUIRE(str.contains(std::string_view{"enough"}));
+  REQUIRE(str.contains(std::string{"for"}));
+}
+
+#if defined(__cpp_lib_span) && defined(__cpp_lib_ranges)
+static_assert(std::contiguous_iterator<wstring::iterator>,
+              "iterators shall be contiguous");
+static_assert(std::ranges::contiguous_range<const wstring>,
+              "strings shall be contiguous ranges");
+
+SCENARIO("string as a contiguous range", "[string_view]") {
+  const string str{"long enough string to be spanned"};
+  const std::span<const char> span{str};
+
+  REQUIRE(span.data() == str.data());
+  REQUIRE(span.size() == str.size());
+}
+#endif
+
+SCENARIO("heterogeneous lookup of strings", "[string_view]") {
+  const string long_key{"long enough key for the heap"};
+
+  GIVEN("transparent hash and equality") {
+    const string_hash hash;
+    const string_equal equal;
+
+    THEN("views hash and compare like strings") {
+      REQUIRE(hash(std::string_view{"long enough key for the heap"}) ==
+              long_key.hash());
+      REQUIRE(hash(std::string{"short"}) == string{"short"}.hash());
+      REQUIRE(
+          equal(long_key, std::string_view{"long enough key for the heap"}));
+      REQUIRE(equal(std::string{"long enough key for the heap"}, long_key));
+      REQUIRE_FALSE(equal(long_key, std::string_view{"long enough"}));
+    }
+  }
+  GIVEN("an unordered map with transparent functors") {
+    std::unordered_map<string, int, string_hash, string_equal> map{
+        {long_key, 1}, {string{"short"}, 2}};
+
+#if defined(__cpp_lib_generic_unordered_lookup)
+    THEN("keys are found by views and C strings") {
+      REQUIRE(map.find(std::string_view{"long enough key for the heap"})
+                  ->second == 1);
+      REQUIRE(map.count("short") == 1);
+      REQUIRE(map.count(std::string_view{"missing"}) == 0);
+    }
+#endif
+    THEN("keys are found by strings") {
+      REQUIRE(map.at(string{"short"}) == 2);
+    }
+  }
+  GIVEN("an ordered map with std::less<>") {
+    std::map<string, int, std::less<>> map{{long_key, 1}, {string{"b"}, 2}};
+
+    THEN("keys are found by views and C strings") {
+      REQUIRE(map.find(std::string_view{"long enough key for the heap"})
+                  ->second == 1);
+      REQUIRE(map.count("b") == 1);
+      REQUIRE(map.count(std::string_view{"c"}) == 0);
+    }
+  }
+  GIVEN("a string map and a string set") {
+    string_map<int> map{{long_key, 1}, {string{"short"}, 2}};
+    string_set<> set{long_key};
+
+    THEN("keys are found by views") {
+      REQUIRE(map.at(std::string_view{"long enough key for the heap"}) == 1);
+      REQUIRE(map.count(std::string{"short"}) == 1);
+      REQUIRE(set.count(std::string_view{"long enough key for the heap"}));
+      REQUIRE(set.find(std::string_view{"short"}) == set.end());
+    }
+    THEN("views are inserted as strings") {
+      map[std::string_view{"view key"}] = 3;
+      REQUIRE(map.at("view key") == 3);
+      REQUIRE(set.intern(std::string_view{"long enough key for the heap"})
+                  .data() == long_key.data());
+    }
+  }
+}
+
+#endif
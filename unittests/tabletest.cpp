@@ -0,0 +1,139 @@
+#include "allocator_with_count.hpp"
+#include "catch2/catch.hpp"
+#include "immutable_string/table.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace immutable_string;
+
+using table_count_alloc =
+    basic_string_table<char, std::char_traits<char>,
+                       allocator_with_count<char>>;
+
+SCENARIO("string table packs strings into one buffer", "[table]") {
+  int allocated_count = 0;
+  auto allocator = allocator_with_count<char>{allocated_count};
+
+  GIVEN("a table of short and long strings") {
+    const std::vector<std::string> values{
+        "a", "", "long enough string of the table", "short",
+        "another long string of the table"};
+    const table_count_alloc table{values.begin(), values.end(), allocator};
+
+    THEN("all the characters are in one buffer of the exact size") {
+      REQUIRE(allocated_count == 1);
+      REQUIRE(table.size() == 5);
+      REQUIRE(table.chars().size() == 74);
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        REQUIRE(table.length(i) == values[i].size());
+        REQUIRE(std::strcmp(table.data(i), values[i].c_str()) == 0);
+      }
+      REQUIRE(table.data(2) == table.data(1) + 1);
+    }
+    THEN("strings taken from it share the buffer") {
+      const auto str = table[2];
+      REQUIRE(str == "long enough string of the table");
+      REQUIRE(str.data() == table.data(2));
+      REQUIRE(std::strlen(str.c_str()) == str.size());
+      REQUIRE(table[3] == "short");
+      REQUIRE(table.at(1).empty());
+      REQUIRE(allocated_count == 1);
+    }
+    THEN("strings taken from it outlive it") {
+      auto copy = table;
+      const auto str = copy[4];
+      copy = table_count_alloc{allocator};
+      REQUIRE(str == "another long string of the table");
+    }
+    THEN("out of range access throws") {
+      REQUIRE_THROWS_AS(table.at(5), std::out_of_range);
+    }
+  }
+  GIVEN("strings of any kind") {
+    const string long_str{"long enough string to be concatenated"};
+    const string_table table{long_str + long_str, string{"b"}, string{}};
+    const char* const c_strings[] = {"x", "long enough C string"};
+    const string_table from_c_strings{std::begin(c_strings),
+                                      std::end(c_strings)};
+    std::istringstream words{"words read one by one"};
+    const string_table from_input{std::istream_iterator<std::string>{words},
+                                  std::istream_iterator<std::string>{}};
+
+    THEN("they are copied into the table") {
+      REQUIRE(table[0] == (long_str + long_str).c_str());
+      REQUIRE(table[1] == "b");
+      REQUIRE(table[2].empty());
+      REQUIRE(from_c_strings[1] == "long enough C string");
+      REQUIRE(from_input.size() == 5);
+      REQUIRE(from_input[4] == "one");
+    }
+  }
+  GIVEN("an empty table") {
+    const string_table table;
+
+    THEN("it has no strings") {
+      REQUIRE(table.empty());
+      REQUIRE(table.find("") == string_table::npos);
+      REQUIRE(table.hashes().empty());
+      REQUIRE(table.sorted().empty());
+    }
+  }
+}
+
+SCENARIO("string table scans the whole column", "[table]") {
+  GIVEN("a table with repeated strings") {
+    const string_table table{string{"b"}, string{"long enough string #2"},
+                             string{"a"}, string{"long enough string #1"},
+                             string{"b"}};
+
+    THEN("find returns the first equal string from the position") {
+      REQUIRE(table.find("b") == 0);
+      REQUIRE(table.find("b", 1) == 4);
+      REQUIRE(table.find(string{"long enough string #1"}) == 3);
+      REQUIRE(table.find(std::string{"long enough"}) == string_table::npos);
+      REQUIRE(table.find("c") == string_table::npos);
+    }
+    THEN("hashes are the same as the strings have") {
+      const auto hashes = table.hashes();
+      REQUIRE(hashes.size() == table.size());
+      for (std::size_t i = 0; i < table.size(); ++i) {
+        REQUIRE(hashes[i] == string{table.data(i)}.hash());
+      }
+    }
+    THEN("sorted table has the strings in ascending order") {
+      const auto sorted = table.sorted();
+      REQUIRE(sorted.size() == 5);
+      REQUIRE(sorted[0] == "a");
+      REQUIRE(sorted[1] == "b");
+      REQUIRE(sorted[2] == "b");
+      REQUIRE(sorted[3] == "long enough string #1");
+      REQUIRE(sorted[4] == "long enough string #2");
+      REQUIRE(sorted.chars().size() == table.chars().size());
+    }
+  }
+  GIVEN("random strings") {
+    std::mt19937 gen{17};
+    std::uniform_int_distribution<int> len_dist{0, 40};
+    std::uniform_int_distribution<int> char_dist{'a', 'd'};
+    std::vector<std::string> values(200);
+    for (auto& value : values) {
+      value.resize(len_dist(gen));
+      for (auto& ch : value) ch = static_cast<char>(char_dist(gen));
+    }
+    const string_table table{values.begin(), values.end()};
+
+    THEN("sorting agrees with std::sort") {
+      std::sort(values.begin(), values.end());
+      const auto sorted = table.sorted();
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        REQUIRE(sorted[i] == values[i].c_str());
+      }
+    }
+  }
+}
@@ -0,0 +1,224 @@
+#include "catch2/catch.hpp"
+#include "immutable_string/utf8.hpp"
+
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
+using namespace immutable_string;
+
+namespace {
+
+// decodes code point by code point
+bool reference_valid(const std::string& s) {
+  for (std::size_t i = 0; i < s.size();) {
+    const auto c = static_cast<unsigned char>(s[i]);
+    std::size_t length;
+    std::uint32_t cp;
+    if (c < 0x80) {
+      length = 1;
+      cp = c;
+    } else if ((c & 0xe0) == 0xc0) {
+      length = 2;
+      cp = c & 0x1f;
+    } else if ((c & 0xf0) == 0xe0) {
+      length = 3;
+      cp = c & 0x0f;
+    } else if ((c & 0xf8) == 0xf0) {
+      length = 4;
+      cp = c & 0x07;
+    } else {
+      return false;
+    }
+    if (i + length > s.size()) return false;
+    for (std::size_t j = 1; j < length; ++j) {
+      const auto next = static_cast<unsigned char>(s[i + j]);
+      if ((next & 0xc0) != 0x80) return false;
+      cp = (cp << 6) | (next & 0x3f);
+    }
+    const std::uint32_t min[] = {0, 0, 0x80, 0x800, 0x10000};
+    if (cp < min[length] || cp > 0x10ffff) return false;
+    if (cp >= 0xd800 && cp <= 0xdfff) return false;
+    i += length;
+  }
+  return true;
+}
+
+void append_code_point(std::string& s, std::uint32_t cp) {
+  if (cp < 0x80) {
+    s += char(cp);
+  } else if (cp < 0x800) {
+    s += char(0xc0 | (cp >> 6));
+    s += char(0x80 | (cp & 0x3f));
+  } else if (cp < 0x10000) {
+    s += char(0xe0 | (cp >> 12));
+    s += char(0x80 | ((cp >> 6) & 0x3f));
+    s += char(0x80 | (cp & 0x3f));
+  } else {
+    s += char(0xf0 | (cp >> 18));
+    s += char(0x80 | ((cp >> 12) & 0x3f));
+    s += char(0x80 | ((cp >> 6) & 0x3f));
+    s += char(0x80 | (cp & 0x3f));
+  }
+}
+
+bool validate_in_pieces(const std::string& s, std::size_t piece) {
+  detail::utf8_validator validator;
+  for (std::size_t i = 0; i < s.size(); i += piece) {
+    validator.update(reinterpret_cast<const unsigned char*>(s.data()) + i,
+                     std::min(piece, s.size() - i));
+  }
+  return validator.finish();
+}
+
+}  // namespace
+
+SCENARIO("UTF-8 validation", "[utf8]") {
+  GIVEN("valid and invalid sequences") {
+    const std::string long_ascii(100, 'a');
+    THEN("they are told apart") {
+      REQUIRE(utf8::is_valid(string{"plain ascii"}));
+      REQUIRE(utf8::is_valid(string{"\xd0\x9f\xd1\x80\xd0\xb8 \xe2\x82\xac "
+                                    "\xf0\x9f\x98\x80"}));
+      REQUIRE(utf8::is_valid(string{"\xf4\x8f\xbf\xbf"}));
+      REQUIRE_FALSE(utf8::is_valid(string{"\xc0\xaf"}));  // overlong
+      REQUIRE_FALSE(utf8::is_valid(string{"\xe0\x80\xaf"}));
+      REQUIRE_FALSE(utf8::is_valid(string{"\xf0\x80\x80\xaf"}));
+      REQUIRE_FALSE(utf8::is_valid(string{"\xed\xa0\x80"}));  // surrogate
+      REQUIRE_FALSE(utf8::is_valid(string{"\xf4\x90\x80\x80"}));
+      REQUIRE_FALSE(utf8::is_valid(string{"\xf5\x80\x80\x80"}));
+      REQUIRE_FALSE(utf8::is_valid(string{"\x80"}));
+      REQUIRE_FALSE(utf8::is_valid(string{"\xe2\x82"}));  // truncated
+      const auto truncated = long_ascii + "\xe2\x82";
+      REQUIRE_FALSE(utf8::is_valid(string{truncated.c_str()}));
+      REQUIRE_FALSE(utf8::is_valid(string{(truncated + long_ascii).c_str()}));
+    }
+  }
+  GIVEN("random inputs") {
+    std::mt19937 gen(29);
+    THEN("the validator agrees with decoding, whatever the pieces are") {
+      for (int round = 0; round < 3000; ++round) {
+        std::string s;
+        const auto length = gen() % 200;
+        while (s.size() < length) {
+          switch (gen() % 4) {
+            case 0: s += char('a' + gen() % 26); break;
+            case 1: s += char(gen()); break;
+            default:
+              append_code_point(s, gen() % (gen() % 2 ? 0x800 : 0x110000));
+          }
+        }
+        // mostly valid inputs with a broken byte
+        if (round % 3 == 0 && !s.empty()) s[gen() % s.size()] = char(gen());
+        const auto expected = reference_valid(s);
+        REQUIRE(validate_in_pieces(s, s.size() + 1) == expected);
+        REQUIRE(validate_in_pieces(s, 1 + gen() % 40) == expected);
+        REQUIRE(utf8::is_valid(string{s.data(), s.size()}) == expected);
+      }
+    }
+  }
+}
+
+SCENARIO("UTF-8 properties are cached in the buffer", "[utf8]") {
+  GIVEN("a long ASCII string and its slices") {
+    const string str{"long enough string of ASCII characters only"};
+    const auto slice = str.substr(5, 20);
+    THEN("the slices are ASCII once the string is known to be") {
+      REQUIRE(utf8::is_ascii(str));
+      REQUIRE(utf8::is_ascii(slice));
+      REQUIRE(utf8::is_valid(slice));
+      REQUIRE(utf8::length(slice) == 20);
+    }
+  }
+  GIVEN("a long string which isn't ASCII") {
+    const string str{"long enough string with \xe2\x82\xac after ASCII"};
+    THEN("the cached answers are the same") {
+      REQUIRE_FALSE(utf8::is_ascii(str));
+      REQUIRE_FALSE(utf8::is_ascii(str));
+      REQUIRE(utf8::is_valid(str));
+      REQUIRE(utf8::is_valid(str));
+      REQUIRE(utf8::length(str) == str.size() - 2);
+      REQUIRE(utf8::is_ascii(str.substr(0, 20)));
+      REQUIRE_FALSE(utf8::is_valid(str.substr(0, 25)));
+    }
+  }
+  GIVEN("a concatenation") {
+    const string left{"long enough left part with \xd0\x9f and more text"};
+    const string right{"long enough right part with \xd1\x80 and more text"};
+    const auto str = left.concat(right).concat(left).concat(right);
+    THEN("it is scanned piece by piece") {
+      REQUIRE(utf8::is_valid(str));
+      REQUIRE_FALSE(utf8::is_ascii(str));
+      REQUIRE(utf8::length(str) == str.size() - 4);
+    }
+  }
+  GIVEN("a sequence split between the parts of a concatenation") {
+    const string left{"long enough left part ending with a lead \xd0"};
+    const string right{"\x9f and a long enough right part of the string"};
+    const auto str = left.concat(right);
+    THEN("it is still valid") {
+      REQUIRE_FALSE(utf8::is_valid(left));
+      REQUIRE_FALSE(utf8::is_valid(right));
+      REQUIRE(utf8::is_valid(str));
+    }
+  }
+}
+
+SCENARIO("strings validated at construction", "[utf8]") {
+  GIVEN("valid UTF-8") {
+    const auto str = utf8::validated(
+        "long enough string with \xe2\x82\xac after ASCII");
+    THEN("it is a plain string known to be valid") {
+      REQUIRE(str == "long enough string with \xe2\x82\xac after ASCII");
+      REQUIRE(utf8::is_valid(str));
+      REQUIRE_FALSE(utf8::is_ascii(str));
+      REQUIRE(utf8::is_ascii(utf8::validated("short")));
+    }
+  }
+  GIVEN("invalid UTF-8") {
+    THEN("it is rejected") {
+      REQUIRE_THROWS_AS(utf8::validated("long enough string \xed\xa0\x80"),
+                        std::invalid_argument);
+      REQUIRE_THROWS_AS(utf8::validated("\xff", 1), std::invalid_argument);
+    }
+  }
+}
+
+SCENARIO("ASCII case-insensitive operations", "[utf8]") {
+  GIVEN("strings differing in case") {
+    const string lower{"long enough string in lower case, \xd0\x9f"};
+    const string mixed{"Long Enough STRING in lower CASE, \xd0\x9f"};
+    THEN("they compare equal ignoring case") {
+      REQUIRE(utf8::compare_icase(lower, mixed) == 0);
+      REQUIRE(utf8::equal_icase(lower, mixed));
+      REQUIRE(utf8::hash_icase(lower) == utf8::hash_icase(mixed));
+      REQUIRE(utf8::compare_icase(string{"Apple"}, "apricot") < 0);
+      REQUIRE(utf8::compare_icase(string{"ZEBRA"}, "apple") > 0);
+      REQUIRE(utf8::compare_icase(string{"abc"}, "ABCD") < 0);
+      REQUIRE_FALSE(utf8::equal_icase(lower, mixed.substr(1)));
+      REQUIRE_FALSE(utf8::equal_icase(string{"[@]"}, string{"{`}"}));
+      // other bytes aren't folded
+      REQUIRE_FALSE(utf8::equal_icase(string{"\xd0\x9f"}, string{"\xd0\xbf"}));
+    }
+    THEN("they are found ignoring case") {
+      REQUIRE(utf8::find_icase(mixed, "string") == 12);
+      REQUIRE(utf8::find_icase(mixed, string{"CASE, \xd0\x9f"}) == 28);
+      REQUIRE(utf8::find_icase(mixed, "l", 1) == 22);
+      REQUIRE(utf8::find_icase(mixed, "strings") == string::npos);
+      REQUIRE(utf8::find_icase(mixed, "", 5) == 5);
+      REQUIRE(utf8::find_icase(mixed, "x", 100) == string::npos);
+    }
+  }
+  GIVEN("an unordered set ignoring case") {
+    std::unordered_set<string, utf8::icase_hash, utf8::icase_equal> set;
+    set.insert(string{"Content-Type"});
+    set.insert(string{"content-type"});
+    set.insert(string{"Accept"});
+    THEN("keys differing in case are the same") {
+      REQUIRE(set.size() == 2);
+      REQUIRE(set.count(string{"CONTENT-TYPE"}) == 1);
+    }
+  }
+}